@@ -0,0 +1,328 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./analysis.h"
+#include "./cache.h"
+#include "./launcher.h"
+#include "./probe.h"
+
+#define ANALYSIS_VERSION 1
+#define ANALYSIS_LINE_SIZE 512
+
+typedef struct {
+    Analysis *analysis;
+    char line[ANALYSIS_LINE_SIZE];
+    size_t len;
+    bool in_silence;
+    double silence_start;
+    bool summary; // inside the summary ebur128 prints at the end
+} Analysis_Parser;
+
+
+// The number after `key` in `line`, e.g. 2.04 of "black_end:2.04". False when there is none.
+static bool analysis_number(const char *line, const char *key, double *value) {
+    const char *at = strstr(line, key);
+    if (at == NULL) return false;
+    at += strlen(key);
+    char *end;
+    double number = strtod(at, &end);
+    if (end == at) return false;
+    *value = number;
+    return true;
+}
+
+
+// The lines we care about, everything else ffmpeg says is skipped:
+//   [Parsed_cropdetect_1 @ 0x...] x1:0 x2:1919 y1:138 y2:941 w:1920 h:800 x:0 y:140 pts:... t:... crop=1920:800:0:140
+//   [Parsed_blackdetect_2 @ 0x...] black_start:0 black_end:2.04 black_duration:2.04
+//   [Parsed_metadata_4 @ 0x...] frame:3 pts:300 pts_time:12.012
+//   [Parsed_silencedetect_8 @ 0x...] silence_start: 61.5
+//   [Parsed_silencedetect_8 @ 0x...] silence_end: 64.25 | silence_duration: 2.75
+//   [Parsed_ebur128_7 @ 0x...] Summary:
+//       I:         -23.1 LUFS
+//       LRA:         6.2 LU
+//       Peak:       -1.3 dBFS
+static void analysis_parse_line(Analysis_Parser *parser, const char *line) {
+    Analysis *analysis = parser->analysis;
+    double start, end;
+    if (strstr(line, "cropdetect") != NULL) {
+        const char *crop = strstr(line, "crop=");
+        int w, h, x, y;
+        if (crop != NULL && sscanf(crop, "crop=%d:%d:%d:%d", &w, &h, &x, &y) == 4 && w > 0 && h > 0) {
+            analysis->crop_width = w;
+            analysis->crop_height = h;
+            analysis->crop_x = x;
+            analysis->crop_y = y;
+        }
+    } else if (analysis_number(line, "black_start:", &start) && analysis_number(line, "black_end:", &end)) {
+        nob_da_append(&analysis->black, ((Analysis_Interval){start, end}));
+    } else if (strstr(line, "Parsed_metadata") != NULL && analysis_number(line, "pts_time:", &start)) {
+        nob_da_append(&analysis->scenes, start);
+    } else if (analysis_number(line, "silence_start:", &start)) {
+        parser->in_silence = true;
+        parser->silence_start = start;
+    } else if (analysis_number(line, "silence_end:", &end)) {
+        if (parser->in_silence) nob_da_append(&analysis->silence, ((Analysis_Interval){parser->silence_start, end}));
+        parser->in_silence = false;
+    } else if (strstr(line, "Summary:") != NULL) {
+        parser->summary = true;
+    } else if (parser->summary) {
+        while (*line == ' ') line += 1;
+        if (strncmp(line, "I:", 2) == 0) analysis_number(line, "I:", &analysis->loudness);
+        if (strncmp(line, "LRA:", 4) == 0) analysis_number(line, "LRA:", &analysis->loudness_range);
+        if (strncmp(line, "Peak:", 5) == 0) analysis_number(line, "Peak:", &analysis->true_peak);
+    }
+}
+
+
+static bool analysis_sink(const char *data, size_t size, void *arg) {
+    Analysis_Parser *parser = arg;
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == '\n' || data[i] == '\r') {
+            parser->line[parser->len] = '\0';
+            if (parser->len > 0) analysis_parse_line(parser, parser->line);
+            parser->len = 0;
+        } else if (parser->len + 1 < sizeof(parser->line)) {
+            // The ends of longer lines are dropped, nothing we parse is that far out.
+            parser->line[parser->len++] = data[i];
+        }
+    }
+    return true;
+}
+
+
+//   ffmpeg -i in.mp4 -filter_complex
+//     [0:v:0]split=3[crop][black][scene];
+//     [crop]cropdetect=round=2:reset=0,nullsink;
+//     [black]blackdetect=d=0.5,nullsink;
+//     [scene]select='gt(scene,0.4)',metadata=print[v];
+//     [0:a:0]asplit[loudness][silence];
+//     [loudness]ebur128=framelog=verbose:peak=true,anullsink;
+//     [silence]silencedetect=n=-50dB:d=1[a]
+//   -map [v] -map [a] -f null -
+bool analysis_run(const char *path, Analysis *analysis, const atomic_bool *cancel) {
+    memset(analysis, 0, sizeof(*analysis));
+    Probe probe = {0};
+    if (!probe_file(path, &probe)) return false;
+    analysis->video = probe.width > 0;
+    analysis->audio = probe.audio_codec[0] != '\0';
+    if (!analysis->video && !analysis->audio) return false;
+
+    char graph[1024] = "";
+    char video[512];
+    char audio[512];
+    snprintf(video, sizeof(video),
+             "[0:v:0]split=3[crop][black][scene];"
+             "[crop]cropdetect=round=2:reset=0,nullsink;"
+             "[black]blackdetect=d=%g,nullsink;"
+             "[scene]select='gt(scene,%g)',metadata=print[v]",
+             ANALYSIS_BLACK_MIN, ANALYSIS_SCENE_THRESHOLD);
+    snprintf(audio, sizeof(audio),
+             "[0:a:0]asplit[loudness][silence];"
+             "[loudness]ebur128=framelog=verbose:peak=true,anullsink;"
+             "[silence]silencedetect=n=%s:d=%g[a]",
+             ANALYSIS_SILENCE_NOISE, ANALYSIS_SILENCE_MIN);
+    snprintf(graph, sizeof(graph), "%s%s%s",
+             analysis->video ? video : "",
+             analysis->video && analysis->audio ? ";" : "",
+             analysis->audio ? audio : "");
+
+    Nob_Cmd cmd = {0};
+    nob_cmd_append(&cmd, "ffmpeg", "-hide_banner", "-nostdin", "-nostats", "-v", "info", "-i", path);
+    nob_cmd_append(&cmd, "-filter_complex", graph);
+    if (analysis->video) nob_cmd_append(&cmd, "-map", "[v]");
+    if (analysis->audio) nob_cmd_append(&cmd, "-map", "[a]");
+    nob_cmd_append(&cmd, "-f", "null", "-");
+    Analysis_Parser parser = {.analysis = analysis};
+    bool ok = launcher_run_sync_streaming(cmd, STDERR_FILENO, analysis_sink, &parser, cancel);
+    nob_cmd_free(cmd);
+    if (!ok) {
+        if (cancel == NULL || !atomic_load(cancel)) nob_log(NOB_ERROR, "could not analyze %s", path);
+        analysis_free(analysis);
+        return false;
+    }
+    // Older ffmpegs don't end the silence that runs into the end of the input.
+    if (parser.in_silence) nob_da_append(&analysis->silence, ((Analysis_Interval){parser.silence_start, probe.duration}));
+    return true;
+}
+
+
+// The file repeats the path, size and mtime, to catch collisions.
+static bool analysis_cache_path(char *cache, size_t size, const char *path, const struct stat *st) {
+    char name[64];
+    snprintf(name, sizeof(name), "analysis-%016" PRIx64 ".txt", cache_input_key(path, st));
+    return cache_path(cache, size, name);
+}
+
+
+// One `key values...` line each, in the order analysis_write() puts them:
+//   analysis 1
+//   size 104857600
+//   mtime 1700000000123456789
+//   path /home/user/Videos/capture.mp4
+//   streams 1 1
+//   crop 1920 800 0 140
+//   loudness -23.1 6.2 -1.3
+//   black 0 2.04
+//   silence 61.5 64.25
+//   scene 12.012
+static bool analysis_read(const char *cache, const char *path, const struct stat *st, Analysis *analysis) {
+    if (access(cache, R_OK) < 0) return false; // not analyzed yet
+    Nob_String_Builder sb = {0};
+    if (!nob_read_entire_file(cache, &sb)) return false;
+    nob_sb_append_null(&sb);
+
+    bool result = true;
+    memset(analysis, 0, sizeof(*analysis));
+    char *line = sb.items;
+    size_t number = 0;
+    while (line != NULL && *line != '\0') {
+        char *next = strchr(line, '\n');
+        if (next != NULL) *next++ = '\0';
+        unsigned long long u;
+        int a, b;
+        double x, y, z;
+        switch (number++) {
+        case 0: if (sscanf(line, "analysis %d", &a) != 1 || a != ANALYSIS_VERSION) nob_return_defer(false); break;
+        case 1: if (sscanf(line, "size %llu", &u) != 1 || u != (unsigned long long) st->st_size) nob_return_defer(false); break;
+        case 2: if (sscanf(line, "mtime %llu", &u) != 1 || u != cache_mtime(st)) nob_return_defer(false); break;
+        case 3: if (strncmp(line, "path ", 5) != 0 || strcmp(line + 5, path) != 0) nob_return_defer(false); break;
+        case 4:
+            if (sscanf(line, "streams %d %d", &a, &b) != 2) nob_return_defer(false);
+            analysis->video = a;
+            analysis->audio = b;
+            break;
+        default:
+            if (sscanf(line, "crop %d %d %d %d", &analysis->crop_width, &analysis->crop_height, &analysis->crop_x, &analysis->crop_y) == 4) break;
+            if (sscanf(line, "loudness %lf %lf %lf", &x, &y, &z) == 3) {
+                analysis->loudness = x;
+                analysis->loudness_range = y;
+                analysis->true_peak = z;
+                break;
+            }
+            if (sscanf(line, "black %lf %lf", &x, &y) == 2) {
+                nob_da_append(&analysis->black, ((Analysis_Interval){x, y}));
+                break;
+            }
+            if (sscanf(line, "silence %lf %lf", &x, &y) == 2) {
+                nob_da_append(&analysis->silence, ((Analysis_Interval){x, y}));
+                break;
+            }
+            if (sscanf(line, "scene %lf", &x) == 1) {
+                nob_da_append(&analysis->scenes, x);
+                break;
+            }
+            nob_return_defer(false);
+        }
+        line = next;
+    }
+    if (number < 5) nob_return_defer(false);
+
+defer:
+    if (!result) analysis_free(analysis);
+    nob_sb_free(sb);
+    return result;
+}
+
+
+static bool analysis_write(const char *cache, const char *path, const struct stat *st, const Analysis *analysis) {
+    Nob_String_Builder sb = {0};
+    nob_sb_appendf(&sb, "analysis %d\n", ANALYSIS_VERSION);
+    nob_sb_appendf(&sb, "size %llu\n", (unsigned long long) st->st_size);
+    nob_sb_appendf(&sb, "mtime %llu\n", (unsigned long long) cache_mtime(st));
+    nob_sb_appendf(&sb, "path %s\n", path);
+    nob_sb_appendf(&sb, "streams %d %d\n", analysis->video, analysis->audio);
+    if (analysis->crop_width > 0) {
+        nob_sb_appendf(&sb, "crop %d %d %d %d\n", analysis->crop_width, analysis->crop_height, analysis->crop_x, analysis->crop_y);
+    }
+    if (analysis->audio) {
+        nob_sb_appendf(&sb, "loudness %.17g %.17g %.17g\n", analysis->loudness, analysis->loudness_range, analysis->true_peak);
+    }
+    for (size_t i = 0; i < analysis->black.count; ++i) {
+        nob_sb_appendf(&sb, "black %.17g %.17g\n", analysis->black.items[i].start, analysis->black.items[i].end);
+    }
+    for (size_t i = 0; i < analysis->silence.count; ++i) {
+        nob_sb_appendf(&sb, "silence %.17g %.17g\n", analysis->silence.items[i].start, analysis->silence.items[i].end);
+    }
+    for (size_t i = 0; i < analysis->scenes.count; ++i) {
+        nob_sb_appendf(&sb, "scene %.17g\n", analysis->scenes.items[i]);
+    }
+
+    bool result = cache_write_atomic(cache, sb.items, sb.count);
+    nob_sb_free(sb);
+    return result;
+}
+
+
+bool analysis_load(const char *path, Analysis *analysis, const atomic_bool *cancel) {
+    memset(analysis, 0, sizeof(*analysis));
+    struct stat st;
+    if (stat(path, &st) < 0) {
+        nob_log(NOB_ERROR, "could not stat %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    char cache[1024];
+    bool cached = analysis_cache_path(cache, sizeof(cache), path, &st);
+    if (cached && analysis_read(cache, path, &st, analysis)) return true;
+
+    if (!analysis_run(path, analysis, cancel)) return false;
+    if (cached) analysis_write(cache, path, &st, analysis);
+    return true;
+}
+
+
+static int compare_intervals(const void *a, const void *b) {
+    double x = ((const Analysis_Interval*) a)->start;
+    double y = ((const Analysis_Interval*) b)->start;
+    return (x > y) - (x < y);
+}
+
+
+bool analysis_dead_air(const Analysis *analysis, double duration, double *in, double *out) {
+    *in = 0;
+    *out = 0;
+    if (duration <= 0) return false;
+
+    // Black or silent, whichever the input has. Overlapping and touching stretches are one.
+    Analysis_Intervals dead = {0};
+    nob_da_append_many(&dead, analysis->black.items, analysis->black.count);
+    nob_da_append_many(&dead, analysis->silence.items, analysis->silence.count);
+    if (dead.count == 0) return false;
+    qsort(dead.items, dead.count, sizeof(*dead.items), compare_intervals);
+    size_t merged = 0;
+    for (size_t i = 1; i < dead.count; ++i) {
+        if (dead.items[i].start <= dead.items[merged].end + ANALYSIS_DEAD_AIR_EDGE) {
+            if (dead.items[i].end > dead.items[merged].end) dead.items[merged].end = dead.items[i].end;
+        } else {
+            dead.items[++merged] = dead.items[i];
+        }
+    }
+    dead.count = merged + 1;
+
+    const Analysis_Interval *first = &dead.items[0];
+    const Analysis_Interval *last = &dead.items[dead.count - 1];
+    if (first->start <= ANALYSIS_DEAD_AIR_EDGE) *in = first->end;
+    if (last->end >= duration - ANALYSIS_DEAD_AIR_EDGE && last->start > *in) *out = last->start;
+    nob_da_free(dead);
+
+    double end = *out > 0 ? *out : duration;
+    if ((*in == 0 && *out == 0) || end - *in < ANALYSIS_DEAD_AIR_MIN_KEEP) {
+        *in = *out = 0;
+        return false;
+    }
+    return true;
+}
+
+
+void analysis_free(Analysis *analysis) {
+    nob_da_free(analysis->black);
+    nob_da_free(analysis->silence);
+    nob_da_free(analysis->scenes);
+    memset(analysis, 0, sizeof(*analysis));
+}
@@ -0,0 +1,76 @@
+#ifndef ANALYSIS_H_
+#define ANALYSIS_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// What we want to know about the content of an input, from a single decode: the video goes through
+// cropdetect, blackdetect and a scene change select, the audio through ebur128 and silencedetect,
+// all branches of one filter graph. The filters report on stderr, which is parsed line by line
+// while ffmpeg runs.
+//
+// A pass takes about as long as decoding the whole input, so the results are kept in the cache
+// directory keyed by the path, size and mtime of the input, like the keyframe index.
+
+#define ANALYSIS_BLACK_MIN 0.5 // seconds of black before it counts
+#define ANALYSIS_SILENCE_MIN 1.0 // seconds of silence before it counts
+#define ANALYSIS_SILENCE_NOISE "-50dB"
+#define ANALYSIS_SCENE_THRESHOLD 0.4 // of select's scene score
+#define ANALYSIS_DEAD_AIR_EDGE 0.25 // seconds from the start or the end a stretch may begin or end
+#define ANALYSIS_DEAD_AIR_MIN_KEEP 1.0 // seconds, otherwise the whole input counts as content
+
+typedef struct {
+    double start; // seconds
+    double end;
+} Analysis_Interval;
+
+typedef struct {
+    Analysis_Interval *items;
+    size_t count;
+    size_t capacity;
+} Analysis_Intervals;
+
+typedef struct {
+    double *items; // seconds
+    size_t count;
+    size_t capacity;
+} Analysis_Times;
+
+typedef struct {
+    bool video;
+    bool audio;
+
+    // cropdetect over the whole input: the smallest crop that keeps every frame. Zero width
+    // when it never reported.
+    int crop_width;
+    int crop_height;
+    int crop_x;
+    int crop_y;
+
+    // ebur128 summary.
+    double loudness; // integrated, LUFS
+    double loudness_range; // LU
+    double true_peak; // dBFS
+
+    Analysis_Intervals black;
+    Analysis_Intervals silence;
+    Analysis_Times scenes;
+} Analysis;
+
+// Loads the analysis of `path` from the cache, or runs the pass and stores it. Doesn't use the
+// temporary allocator, so it's safe to call from any thread. The pass is killed and false is
+// returned as soon as `cancel` is set, which may be NULL.
+bool analysis_load(const char *path, Analysis *analysis, const atomic_bool *cancel);
+
+// Runs the pass without touching the cache.
+bool analysis_run(const char *path, Analysis *analysis, const atomic_bool *cancel);
+
+// The part of the input between the black or silent stretch it starts with and the one it ends
+// with, as trim points. `*out` is 0 when the input doesn't end in dead air. False when there is
+// none at either end, or when hardly anything would be left.
+bool analysis_dead_air(const Analysis *analysis, double duration, double *in, double *out);
+
+void analysis_free(Analysis *analysis);
+
+#endif // ANALYSIS_H_
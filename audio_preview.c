@@ -0,0 +1,271 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "./audio_preview.h"
+#include "./launcher.h"
+#include "./thirdparty/raylib/src/raylib.h"
+
+#define AUDIO_PREVIEW_PERIOD 1024 // frames the audio thread asks for at once, ~21ms
+#define AUDIO_PREVIEW_FRAME_SIZE (2*sizeof(float))
+
+// Two stereo frames, so the mixing kernel does four samples per instruction.
+typedef float Audio_Preview_Vec __attribute__((vector_size(16)));
+
+static struct {
+    bool device; // the audio device is open and `stream` is playing
+    AudioStream stream;
+
+    bool decoder_running; // the decoder thread has to be joined
+    pthread_t decoder;
+    char *path;
+    double time;
+    int channels; // of the input
+    // The decoder keeps the front left and right channels of a surround input, like the pan of
+    // the encode does, instead of downmixing it.
+    bool front;
+    size_t first; // `tail` when the decoder started, the frame at `time`
+    atomic_bool stop;
+    atomic_bool decoding; // cleared by the decoder when ffmpeg is done
+    float pending[2]; // a frame split between two reads of the pipe
+    size_t pending_size; // in bytes
+
+    float ring[AUDIO_PREVIEW_RING*2]; // interleaved stereo
+    atomic_size_t head; // advanced by the consumer (audio thread)
+    atomic_size_t tail; // advanced by the producer (decoder thread)
+    // Frames before it were decoded for an earlier start and are skipped. Only moved while there
+    // is no decoder, so it never passes `tail`.
+    atomic_size_t start;
+
+    atomic_int volume;
+    atomic_int audio_channels;
+} audio_preview = {
+    .volume = 100,
+};
+
+
+// out = a*in + b*(in with left and right swapped), which covers gain and every pan we have.
+static void audio_preview_mix(float *out, const float *in, size_t frames, const float a[2], const float b[2]) {
+    Audio_Preview_Vec va = {a[0], a[1], a[0], a[1]};
+    Audio_Preview_Vec vb = {b[0], b[1], b[0], b[1]};
+    size_t i = 0;
+    for (; i + 2 <= frames; i += 2) {
+        Audio_Preview_Vec v;
+        memcpy(&v, in + i*2, sizeof(v));
+        Audio_Preview_Vec swapped = {v[1], v[0], v[3], v[2]};
+        v = va*v + vb*swapped;
+        memcpy(out + i*2, &v, sizeof(v));
+    }
+    for (; i < frames; ++i) {
+        float left = in[i*2];
+        float right = in[i*2 + 1];
+        out[i*2] = a[0]*left + b[0]*right;
+        out[i*2 + 1] = a[1]*right + b[1]*left;
+    }
+}
+
+
+// Runs on raylib's audio thread, must never block.
+static void audio_preview_callback(void *buffer, unsigned int frames) {
+    float *out = buffer;
+    // `start` before `tail`, so the tail we see is never behind the start we see.
+    size_t start = atomic_load_explicit(&audio_preview.start, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&audio_preview.tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&audio_preview.head, memory_order_relaxed);
+    if (head < start) head = start;
+    size_t count = tail - head < frames ? tail - head : frames;
+
+    float gain = atomic_load_explicit(&audio_preview.volume, memory_order_relaxed)/100.0f;
+    float a[2] = {gain, gain};
+    float b[2] = {0, 0};
+    switch ((AudioChannels) atomic_load_explicit(&audio_preview.audio_channels, memory_order_relaxed)) {
+    case CLONE_LEFT:
+        a[1] = 0;
+        b[1] = gain;
+        break;
+    case CLONE_RIGHT:
+        a[0] = 0;
+        b[0] = gain;
+        break;
+    default:
+        break;
+    }
+
+    size_t offset = head & (AUDIO_PREVIEW_RING - 1);
+    size_t first = AUDIO_PREVIEW_RING - offset < count ? AUDIO_PREVIEW_RING - offset : count;
+    audio_preview_mix(out, audio_preview.ring + offset*2, first, a, b);
+    audio_preview_mix(out + first*2, audio_preview.ring, count - first, a, b);
+    memset(out + count*2, 0, (frames - count)*AUDIO_PREVIEW_FRAME_SIZE);
+
+    atomic_store_explicit(&audio_preview.head, head + count, memory_order_release);
+}
+
+
+// Waits for room in the ring like launcher_push(), because dropping samples would be audible.
+// The wait is what paces ffmpeg to the playback.
+static bool audio_preview_push(const char *data, size_t frames) {
+    size_t tail = atomic_load_explicit(&audio_preview.tail, memory_order_relaxed);
+    while (frames > 0) {
+        size_t head = atomic_load_explicit(&audio_preview.head, memory_order_acquire);
+        size_t start = atomic_load_explicit(&audio_preview.start, memory_order_relaxed);
+        if (head < start) head = start;
+        size_t room = AUDIO_PREVIEW_RING - (tail - head);
+        if (room == 0) {
+            if (atomic_load(&audio_preview.stop)) return false;
+            nanosleep(&(struct timespec){.tv_nsec = 5*1000*1000}, NULL);
+            continue;
+        }
+        size_t count = room < frames ? room : frames;
+        size_t offset = tail & (AUDIO_PREVIEW_RING - 1);
+        size_t first = AUDIO_PREVIEW_RING - offset < count ? AUDIO_PREVIEW_RING - offset : count;
+        memcpy(audio_preview.ring + offset*2, data, first*AUDIO_PREVIEW_FRAME_SIZE);
+        memcpy(audio_preview.ring, data + first*AUDIO_PREVIEW_FRAME_SIZE, (count - first)*AUDIO_PREVIEW_FRAME_SIZE);
+        tail += count;
+        atomic_store_explicit(&audio_preview.tail, tail, memory_order_release);
+        data += count*AUDIO_PREVIEW_FRAME_SIZE;
+        frames -= count;
+    }
+    return true;
+}
+
+
+// The pipe hands out whatever it has, which doesn't have to end on a frame.
+static bool audio_preview_sink(const char *data, size_t size, void *arg) {
+    (void) arg;
+    char *pending = (char*) audio_preview.pending;
+    while (size > 0) {
+        if (audio_preview.pending_size > 0 || size < AUDIO_PREVIEW_FRAME_SIZE) {
+            size_t n = AUDIO_PREVIEW_FRAME_SIZE - audio_preview.pending_size;
+            if (n > size) n = size;
+            memcpy(pending + audio_preview.pending_size, data, n);
+            audio_preview.pending_size += n;
+            data += n;
+            size -= n;
+            if (audio_preview.pending_size < AUDIO_PREVIEW_FRAME_SIZE) break;
+            if (!audio_preview_push(pending, 1)) return false;
+            audio_preview.pending_size = 0;
+            continue;
+        }
+        size_t frames = size/AUDIO_PREVIEW_FRAME_SIZE;
+        if (!audio_preview_push(data, frames)) return false;
+        data += frames*AUDIO_PREVIEW_FRAME_SIZE;
+        size -= frames*AUDIO_PREVIEW_FRAME_SIZE;
+    }
+    return true;
+}
+
+
+//   ffmpeg -ss 12.000 -i in.mp4 -vn -sn -dn -ac 2 -ar 48000 -f f32le pipe:1
+//   ffmpeg -ss 12.000 -i in.mp4 -vn -sn -dn -af pan=stereo|FL=FL|FR=FR -ar 48000 -f f32le pipe:1
+static void *audio_preview_decode(void *arg) {
+    (void) arg;
+    char seek[32];
+    char rate[16];
+    snprintf(seek, sizeof(seek), "%.3f", audio_preview.time);
+    snprintf(rate, sizeof(rate), "%d", AUDIO_PREVIEW_RATE);
+    Nob_Cmd cmd = {0};
+    nob_cmd_append(&cmd, "ffmpeg", "-v", "error", "-nostdin", "-ss", seek, "-i", audio_preview.path);
+    nob_cmd_append(&cmd, "-vn", "-sn", "-dn");
+    if (audio_preview.front) {
+        nob_cmd_append(&cmd, "-af", "pan=stereo|FL=FL|FR=FR");
+    } else {
+        nob_cmd_append(&cmd, "-ac", "2");
+    }
+    nob_cmd_append(&cmd, "-ar", rate, "-f", "f32le", "pipe:1");
+    if (!launcher_run_sync_streaming(cmd, STDOUT_FILENO, audio_preview_sink, NULL, &audio_preview.stop) && !atomic_load(&audio_preview.stop)) {
+        nob_log(NOB_WARNING, "could not decode the audio of %s", audio_preview.path);
+    }
+    nob_cmd_free(cmd);
+    atomic_store(&audio_preview.decoding, false);
+    return NULL;
+}
+
+
+static bool audio_preview_clones(AudioChannels audio_channels) {
+    return audio_channels == CLONE_LEFT || audio_channels == CLONE_RIGHT;
+}
+
+
+bool audio_preview_start(const char *path, double time, int channels) {
+    audio_preview_stop();
+    if (!audio_preview.device) {
+        InitAudioDevice();
+        if (!IsAudioDeviceReady()) {
+            nob_log(NOB_ERROR, "could not open the audio device");
+            return false;
+        }
+        SetAudioStreamBufferSizeDefault(AUDIO_PREVIEW_PERIOD);
+        audio_preview.stream = LoadAudioStream(AUDIO_PREVIEW_RATE, 32, 2);
+        SetAudioStreamCallback(audio_preview.stream, audio_preview_callback);
+        PlayAudioStream(audio_preview.stream);
+        audio_preview.device = true;
+    }
+
+    audio_preview.path = strdup(path);
+    audio_preview.time = time;
+    audio_preview.channels = channels;
+    audio_preview.front = channels > 2 && audio_preview_clones(atomic_load(&audio_preview.audio_channels));
+    audio_preview.first = atomic_load(&audio_preview.tail);
+    audio_preview.pending_size = 0;
+    atomic_store(&audio_preview.stop, false);
+    atomic_store(&audio_preview.decoding, true);
+    int ret = pthread_create(&audio_preview.decoder, NULL, audio_preview_decode, NULL);
+    if (ret != 0) {
+        nob_log(NOB_ERROR, "could not start the audio decoder: %s", strerror(ret));
+        atomic_store(&audio_preview.decoding, false);
+        free(audio_preview.path);
+        audio_preview.path = NULL;
+        return false;
+    }
+    audio_preview.decoder_running = true;
+    return true;
+}
+
+
+void audio_preview_stop(void) {
+    if (!audio_preview.decoder_running) return;
+    atomic_store(&audio_preview.stop, true);
+    pthread_join(audio_preview.decoder, NULL);
+    audio_preview.decoder_running = false;
+    free(audio_preview.path);
+    audio_preview.path = NULL;
+    // Whatever hasn't been played yet is silenced right away.
+    atomic_store(&audio_preview.start, atomic_load(&audio_preview.tail));
+}
+
+
+bool audio_preview_playing(void) {
+    if (!audio_preview.decoder_running) return false;
+    if (atomic_load(&audio_preview.decoding)) return true;
+    size_t head = atomic_load(&audio_preview.head);
+    size_t start = atomic_load(&audio_preview.start);
+    return (head > start ? head : start) < atomic_load(&audio_preview.tail);
+}
+
+
+void audio_preview_set(FfmpegParams params) {
+    atomic_store_explicit(&audio_preview.volume, params.volume, memory_order_relaxed);
+    atomic_store_explicit(&audio_preview.audio_channels, params.audio_channels, memory_order_relaxed);
+    // Switching between the downmix and the front channels of a surround input takes another
+    // decode, from where the playback is.
+    if (!audio_preview_playing() || audio_preview.front == (audio_preview.channels > 2 && audio_preview_clones(params.audio_channels))) return;
+    size_t head = atomic_load(&audio_preview.head);
+    if (head < audio_preview.first) head = audio_preview.first;
+    double time = audio_preview.time + (double)(head - audio_preview.first)/AUDIO_PREVIEW_RATE;
+    char *path = strdup(audio_preview.path);
+    audio_preview_start(path, time, audio_preview.channels);
+    free(path);
+}
+
+
+void audio_preview_shutdown(void) {
+    audio_preview_stop();
+    if (!audio_preview.device) return;
+    UnloadAudioStream(audio_preview.stream);
+    CloseAudioDevice();
+    audio_preview.device = false;
+}
@@ -0,0 +1,34 @@
+#ifndef AUDIO_PREVIEW_H_
+#define AUDIO_PREVIEW_H_
+
+#include <stdbool.h>
+
+#include "./ffmpeg.h"
+
+// Plays the input from the scrub position with the volume and channel settings applied live, so
+// they can be judged without an encode.
+//
+// A decoder thread pipes `ffmpeg -f f32le` into a single-producer/single-consumer lock-free ring,
+// and raylib's audio thread pulls from it. The gain and pan are applied in the audio callback as
+// the samples leave the ring, so a slider change is heard within one buffer period no matter how
+// much is buffered.
+
+#define AUDIO_PREVIEW_RATE 48000
+#define AUDIO_PREVIEW_RING (1 << 15) // frames, must be a power of two
+
+// Starts playing `path` from `time` seconds, replacing whatever was playing. Opens the audio
+// device the first time. `channels` of the input: more than two are downmixed, except when a
+// channel is cloned, which takes the front left and right ones like the encode.
+bool audio_preview_start(const char *path, double time, int channels);
+void audio_preview_stop(void);
+
+// True until the decoder is done and everything it decoded has been played.
+bool audio_preview_playing(void);
+
+// Takes the volume and audio channels of `params`. Cheap, call it every frame.
+void audio_preview_set(FfmpegParams params);
+
+// Call before CloseWindow().
+void audio_preview_shutdown(void);
+
+#endif // AUDIO_PREVIEW_H_
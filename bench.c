@@ -0,0 +1,256 @@
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "./bench.h"
+#include "./container.h"
+#include "./jobs.h"
+
+typedef struct {
+    double wall; // seconds
+    double cpu; // user+sys seconds of the children
+    long involuntary_switches; // of the children, a good measure of thrashing
+    double frame_reduction; // average over the jobs, see job_frame_reduction()
+} Bench_Result;
+
+
+static FfmpegParams bench_default_params(void) {
+    // Same as the defaults of the UI sliders.
+    return (FfmpegParams) {
+        .crf = 28,
+        .volume = 100,
+        .audio_channels = NO_MODIFICATION,
+    };
+}
+
+
+// Encodes every input with `base` into `out_dir` and waits for the whole batch.
+static bool bench_run_batch(Nob_File_Paths inputs, const char *out_dir, FfmpegParams base, Thread_Budget thread_budget, size_t max_running, Bench_Result *result) {
+    bool ok = true;
+    Jobs jobs = {
+        .max_running = max_running,
+        .thread_budget = thread_budget,
+        .results_disabled = true, // reused results would time nothing
+    };
+    for (size_t i = 0; i < inputs.count; ++i) {
+        FfmpegParams params = base;
+        params.input_path = (char*) inputs.items[i];
+        params.output_path = nob_temp_sprintf("%s/%zu_%s", out_dir, i, nob_path_name(inputs.items[i]));
+        jobs_submit(&jobs, params);
+    }
+
+    struct rusage before, after;
+    getrusage(RUSAGE_CHILDREN, &before);
+    uint64_t start = nob_nanos_since_unspecified_epoch();
+    while (!jobs_finished(&jobs)) {
+        jobs_update(&jobs);
+        nanosleep(&(struct timespec){.tv_nsec = 10*1000*1000}, NULL);
+    }
+    result->wall = (double)(nob_nanos_since_unspecified_epoch() - start) / NOB_NANOS_PER_SEC;
+    getrusage(RUSAGE_CHILDREN, &after);
+
+    result->cpu = (after.ru_utime.tv_sec - before.ru_utime.tv_sec) + (after.ru_utime.tv_usec - before.ru_utime.tv_usec) / 1e6
+                + (after.ru_stime.tv_sec - before.ru_stime.tv_sec) + (after.ru_stime.tv_usec - before.ru_stime.tv_usec) / 1e6;
+    result->involuntary_switches = after.ru_nivcsw - before.ru_nivcsw;
+
+    result->frame_reduction = 0;
+    for (size_t i = 0; i < jobs.count; ++i) {
+        if (jobs.items[i].state != JOB_DONE) ok = false;
+        result->frame_reduction += job_frame_reduction(&jobs.items[i]) / jobs.count;
+        unlink(jobs.items[i].params.output_path);
+    }
+    jobs_free(&jobs);
+    return ok;
+}
+
+
+static void bench_print(const char *label, Bench_Result r) {
+    printf("%-10s wall %8.2fs  cpu %8.2fs  involuntary switches %ld\n", label, r.wall, r.cpu, r.involuntary_switches);
+}
+
+
+// Runs the same batch with every ffmpeg picking its own thread count and with the thread budget.
+static int bench_threads(int argc, char **argv) {
+    if (argc < 1) {
+        fprintf(stderr, "usage: vp bench threads <input>...\n");
+        return 1;
+    }
+
+    int result = 0;
+    Nob_File_Paths inputs = {0};
+    for (int i = 0; i < argc; ++i) nob_da_append(&inputs, argv[i]);
+
+    char out_dir[] = "/tmp/vp-bench-XXXXXX";
+    if (mkdtemp(out_dir) == NULL) {
+        nob_log(NOB_ERROR, "could not create a temporary directory: %s", strerror(errno));
+        nob_return_defer(1);
+    }
+
+    Thread_Budget budgeted = {0};
+    Thread_Budget naive = {.unlimited = true};
+    size_t max_running = thread_budget_default_concurrency(&budgeted);
+    printf("%zu inputs, %zu jobs at once, %zu threads\n", inputs.count, max_running, thread_budget_total(&budgeted));
+
+    Bench_Result r_naive, r_budgeted;
+    if (!bench_run_batch(inputs, out_dir, bench_default_params(), naive, max_running, &r_naive)) nob_return_defer(1);
+    bench_print("naive", r_naive);
+    if (!bench_run_batch(inputs, out_dir, bench_default_params(), budgeted, max_running, &r_budgeted)) nob_return_defer(1);
+    bench_print("budgeted", r_budgeted);
+    printf("speedup    %.2fx\n", r_naive.wall / r_budgeted.wall);
+
+defer:
+    rmdir(out_dir);
+    nob_da_free(inputs);
+    return result;
+}
+
+
+static double bench_seconds_since(uint64_t start) {
+    return (double)(nob_nanos_since_unspecified_epoch() - start) / NOB_NANOS_PER_SEC;
+}
+
+
+// Reads the metadata and keyframes of every input natively and with ffprobe, and checks that both agree.
+static int bench_probe(int argc, char **argv) {
+    if (argc < 1) {
+        fprintf(stderr, "usage: vp bench probe <input>...\n");
+        return 1;
+    }
+
+    int result = 0;
+    double native_total = 0, ffprobe_total = 0;
+    for (int i = 0; i < argc; ++i) {
+        const char *path = argv[i];
+        Container_Info info;
+        uint64_t start = nob_nanos_since_unspecified_epoch();
+        bool native = container_parse(path, &info, true);
+        double native_time = bench_seconds_since(start);
+
+        Probe probe;
+        Keyframe_Index keyframes = {0};
+        start = nob_nanos_since_unspecified_epoch();
+        bool ok = probe_file_ffprobe(path, &probe) && keyframe_index_ffprobe(path, &keyframes);
+        double ffprobe_time = bench_seconds_since(start);
+
+        printf("%s\n", path);
+        if (!native) {
+            printf("  native     not supported\n");
+        } else {
+            printf("  native     %8.2fms  %zu keyframes, %zu video / %zu audio samples\n",
+                   native_time*1000, info.keyframes.count, info.video_samples, info.audio_samples);
+        }
+        if (!ok) {
+            printf("  ffprobe    failed\n");
+            result = 1;
+        } else {
+            printf("  ffprobe    %8.2fms  %zu keyframes\n", ffprobe_time*1000, keyframes.count);
+        }
+        if (native && ok) {
+            native_total += native_time;
+            ffprobe_total += ffprobe_time;
+            const char *mismatch = NULL;
+            if (fabs(info.probe.duration - probe.duration) > 0.05) mismatch = "duration";
+            else if (info.probe.width != probe.width || info.probe.height != probe.height) mismatch = "resolution";
+            else if (info.probe.rotation != probe.rotation) mismatch = "rotation";
+            else if (strcmp(info.probe.video_codec, probe.video_codec)) mismatch = "video codec";
+            else if (strcmp(info.probe.video_profile, probe.video_profile)) mismatch = "video profile";
+            else if (strcmp(info.probe.pix_fmt, probe.pix_fmt)) mismatch = "pixel format";
+            else if (strcmp(info.probe.audio_codec, probe.audio_codec)) mismatch = "audio codec";
+            else if (info.probe.sample_rate != probe.sample_rate || info.probe.channels != probe.channels) mismatch = "audio format";
+            else if (info.keyframes.count != keyframes.count) mismatch = "keyframes";
+            if (mismatch != NULL) {
+                printf("  MISMATCH   %s\n", mismatch);
+                result = 1;
+            }
+        }
+        container_info_free(&info);
+        keyframe_index_free(&keyframes);
+    }
+    if (native_total > 0) printf("speedup    %.1fx\n", ffprobe_total / native_total);
+    return result;
+}
+
+
+// A capture of a slide deck: the same frame for a second at a time with a box that jumps around.
+//   ffmpeg -f lavfi -i smptebars=size=1280x720:rate=30:duration=60,drawbox=... -pix_fmt yuv420p out.mp4
+static bool bench_screen_source(const char *path, int seconds) {
+    Nob_Cmd cmd = {0};
+    nob_cmd_append(&cmd, "ffmpeg", "-y", "-v", "error", "-nostdin", "-f", "lavfi", "-i",
+                   nob_temp_sprintf("smptebars=size=1280x720:rate=30:duration=%d,"
+                                    "drawbox=x='mod(floor(t),10)*100':y=100:w=80:h=80:color=red:t=fill", seconds));
+    nob_cmd_append(&cmd, "-pix_fmt", "yuv420p", "-crf", "18", path);
+    bool ok = nob_cmd_run_sync(cmd);
+    nob_cmd_free(cmd);
+    return ok;
+}
+
+
+// Encodes a synthetic, mostly static input with and without the screen recording profile.
+static int bench_screen(int argc, char **argv) {
+    int seconds = argc >= 1 ? atoi(argv[0]) : 60;
+    if (seconds <= 0) {
+        fprintf(stderr, "usage: vp bench screen [seconds]\n");
+        return 1;
+    }
+
+    int result = 0;
+    Nob_File_Paths inputs = {0};
+    char dir[] = "/tmp/vp-bench-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        nob_log(NOB_ERROR, "could not create a temporary directory: %s", strerror(errno));
+        return 1;
+    }
+    const char *source = nob_temp_sprintf("%s/screen.mp4", dir);
+    if (!bench_screen_source(source, seconds)) nob_return_defer(1);
+    nob_da_append(&inputs, source);
+
+    // One job at a time with every thread, like encoding a single recording from the UI.
+    Thread_Budget budget = {0};
+    FfmpegParams plain = bench_default_params();
+    FfmpegParams screen = plain;
+    screen.screen_recording = true;
+    printf("%ds of 1280x720 at 30fps, %zu threads\n", seconds, thread_budget_total(&budget));
+
+    Bench_Result r_plain, r_screen;
+    if (!bench_run_batch(inputs, dir, plain, budget, 1, &r_plain)) nob_return_defer(1);
+    bench_print("plain", r_plain);
+    if (!bench_run_batch(inputs, dir, screen, budget, 1, &r_screen)) nob_return_defer(1);
+    bench_print("screen", r_screen);
+    printf("frames     -%.0f%%\n", r_screen.frame_reduction*100);
+    printf("speedup    %.2fx\n", r_plain.wall / r_screen.wall);
+
+defer:
+    unlink(source);
+    rmdir(dir);
+    nob_da_free(inputs);
+    return result;
+}
+
+
+int bench_main(int argc, char **argv) {
+    if (argc < 1) {
+        fprintf(stderr, "usage: vp bench <threads|probe|screen> [args...]\n");
+        return 1;
+    }
+    if (!launcher_init()) return 1;
+
+    const char *name = argv[0];
+    int result = 1;
+    if (strcmp(name, "threads") == 0) {
+        result = bench_threads(argc - 1, argv + 1);
+    } else if (strcmp(name, "probe") == 0) {
+        result = bench_probe(argc - 1, argv + 1);
+    } else if (strcmp(name, "screen") == 0) {
+        result = bench_screen(argc - 1, argv + 1);
+    } else {
+        fprintf(stderr, "unknown benchmark: %s\n", name);
+    }
+
+    launcher_shutdown();
+    return result;
+}
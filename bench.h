@@ -0,0 +1,7 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+// Headless benchmarks, run as `./vp bench <name> [args...]`.
+int bench_main(int argc, char **argv);
+
+#endif // BENCH_H_
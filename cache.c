@@ -0,0 +1,95 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./cache.h"
+#include "./thirdparty/nob.h"
+
+static bool cache_mkdir(const char *path) {
+    if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+        nob_log(NOB_ERROR, "could not create directory %s: %s", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+
+bool cache_path(char *path, size_t size, const char *name) {
+    char dir[1024];
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg != NULL && *xdg != '\0') {
+        snprintf(dir, sizeof(dir), "%s", xdg);
+    } else if (home != NULL) {
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+    } else {
+        nob_log(NOB_ERROR, "could not find the cache directory: neither XDG_CACHE_HOME nor HOME is set");
+        return false;
+    }
+    if (!cache_mkdir(dir)) return false;
+
+    size_t n = strlen(dir);
+    snprintf(dir + n, sizeof(dir) - n, "/video-processor");
+    if (!cache_mkdir(dir)) return false;
+
+    int written = snprintf(path, size, "%s/%s", dir, name);
+    return written > 0 && (size_t) written < size;
+}
+
+
+uint64_t cache_hash_bytes(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; ++i) hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+
+uint64_t cache_hash_u64(uint64_t hash, uint64_t value) {
+    return (hash ^ value) * 0x100000001b3ull;
+}
+
+
+uint64_t cache_input_key(const char *path, const struct stat *st) {
+    uint64_t hash = cache_hash_bytes(CACHE_HASH_INIT, path, strlen(path));
+    hash = cache_hash_u64(hash, (uint64_t) st->st_size);
+    hash = cache_hash_u64(hash, (uint64_t) st->st_mtim.tv_sec);
+    return cache_hash_u64(hash, (uint64_t) st->st_mtim.tv_nsec);
+}
+
+
+uint64_t cache_mtime(const struct stat *st) {
+    return (uint64_t) st->st_mtim.tv_sec * NOB_NANOS_PER_SEC + (uint64_t) st->st_mtim.tv_nsec;
+}
+
+
+bool cache_write_atomic(const char *path, const void *data, size_t size) {
+    bool result = true;
+    char tmp_path[4096 + 16];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path);
+    int fd = mkstemp(tmp_path);
+    if (fd < 0) {
+        nob_log(NOB_ERROR, "could not create %s: %s", tmp_path, strerror(errno));
+        nob_return_defer(false);
+    }
+    for (size_t written = 0; written < size;) {
+        ssize_t n = write(fd, (const char*) data + written, size - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            nob_log(NOB_ERROR, "could not write %s: %s", tmp_path, strerror(errno));
+            nob_return_defer(false);
+        }
+        written += n;
+    }
+    if (rename(tmp_path, path) < 0) {
+        nob_log(NOB_ERROR, "could not rename %s to %s: %s", tmp_path, path, strerror(errno));
+        nob_return_defer(false);
+    }
+
+defer:
+    if (fd >= 0) close(fd);
+    if (!result && fd >= 0) unlink(tmp_path);
+    return result;
+}
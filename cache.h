@@ -0,0 +1,33 @@
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+// Everything the tool remembers between sessions lives under
+// $XDG_CACHE_HOME/video-processor (~/.cache/video-processor by default).
+
+// Writes the path of `name` inside the cache directory into `path`, creating the directory
+// on the way. Doesn't use the temporary allocator, so it's safe to call from any thread.
+bool cache_path(char *path, size_t size, const char *name);
+
+// FNV-1a, continued from `hash`. Start from CACHE_HASH_INIT.
+#define CACHE_HASH_INIT 0xcbf29ce484222325ull
+uint64_t cache_hash_bytes(uint64_t hash, const void *data, size_t size);
+uint64_t cache_hash_u64(uint64_t hash, uint64_t value);
+
+// Hash of the path, size and mtime of an input, what the caches name their files after. A file
+// that changes gets a new key, so nothing has to be invalidated.
+uint64_t cache_input_key(const char *path, const struct stat *st);
+
+// The mtime of `st` in nanoseconds, to store next to a cached result and compare when loading it.
+uint64_t cache_mtime(const struct stat *st);
+
+// Writes `data` to a temporary file next to `path` and renames it over `path`, so readers see the
+// old contents or the new ones and never half of them. Several threads may write the same path,
+// each gets its own temporary file.
+bool cache_write_atomic(const char *path, const void *data, size_t size);
+
+#endif // CACHE_H_
@@ -0,0 +1,390 @@
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./compare.h"
+#include "./launcher.h"
+#include "./pool.h"
+
+typedef struct {
+    double *items;
+    size_t count;
+    size_t capacity;
+} Compare_Values;
+
+typedef struct {
+    Compare *compare;
+    size_t generation;
+    char dir[PATH_MAX]; // temporary, removed when the task is done
+    char excerpt[PATH_MAX + 32];
+    // Built on the UI thread, the temporary storage isn't for the pool. They own their strings.
+    Nob_Cmd encode;
+    Nob_Cmd metrics;
+    Nob_Cmd source_frame;
+    Nob_Cmd encoded_frame;
+    int width; // of the frames
+    int height;
+    double offset; // of the shown frame in the excerpt, seconds
+
+    bool ok;
+    unsigned char *source_pixels;
+    unsigned char *encoded_pixels;
+    Compare_Metrics result;
+    size_t frame;
+    double kbps;
+} Compare_Task;
+
+
+const char *compare_mode_name(Compare_Mode mode) {
+    switch (mode) {
+    case COMPARE_SIDE_BY_SIDE: return "side";
+    case COMPARE_WIPE:         return "wipe";
+    case COMPARE_FLICKER:      return "flicker";
+    case COMPARE_MODE_COUNT:   break;
+    }
+    return "?";
+}
+
+
+// The longest side becomes COMPARE_SIZE, both sides even for the chroma subsampling.
+static void compare_fit_size(int width, int height, int *w, int *h) {
+    if (width >= height) {
+        *w = COMPARE_SIZE;
+        *h = (int)((double) COMPARE_SIZE * height / width + 0.5);
+    } else {
+        *h = COMPARE_SIZE;
+        *w = (int)((double) COMPARE_SIZE * width / height + 0.5);
+    }
+    *w = *w / 2 * 2 > 0 ? *w / 2 * 2 : 2;
+    *h = *h / 2 * 2 > 0 ? *h / 2 * 2 : 2;
+}
+
+
+static void compare_cmd_own(Nob_Cmd *cmd) {
+    for (size_t i = 0; i < cmd->count; ++i) cmd->items[i] = strdup(cmd->items[i]);
+}
+
+
+static void compare_cmd_free(Nob_Cmd *cmd) {
+    for (size_t i = 0; i < cmd->count; ++i) free((char*) cmd->items[i]);
+    free(cmd->items);
+    memset(cmd, 0, sizeof(*cmd));
+}
+
+
+static void compare_task_free(Compare_Task *task) {
+    compare_cmd_free(&task->encode);
+    compare_cmd_free(&task->metrics);
+    compare_cmd_free(&task->source_frame);
+    compare_cmd_free(&task->encoded_frame);
+    free(task->source_pixels);
+    free(task->encoded_pixels);
+    nob_da_free(task->result);
+    free(task);
+}
+
+
+// Values of `key` in the stats_file of the ssim or psnr filter, which has a line per frame:
+//   n:1 Y:0.991 U:0.995 V:0.994 All:0.992 (21.0)
+//   n:1 mse_avg:2.41 mse_y:2.90 mse_u:1.20 mse_v:1.38 psnr_avg:44.31 psnr_y:43.51 ...
+static bool compare_read_stats(const char *path, const char *key, Compare_Values *values) {
+    Nob_String_Builder sb = {0};
+    if (!nob_read_entire_file(path, &sb)) return false;
+    Nob_String_View content = nob_sb_to_sv(sb);
+    while (content.count > 0) {
+        Nob_String_View line = nob_sv_chop_by_delim(&content, '\n');
+        char buf[512];
+        snprintf(buf, sizeof(buf), SV_Fmt, SV_Arg(line));
+        const char *value = strstr(buf, key);
+        if (value == NULL) continue;
+        // strtod() reads the "inf" of identical frames as well.
+        nob_da_append(values, strtod(value + strlen(key), NULL));
+    }
+    nob_sb_free(sb);
+    return values->count > 0;
+}
+
+
+static bool compare_run_frame(Nob_Cmd cmd, int width, int height, unsigned char **pixels) {
+    Nob_String_Builder out = {0};
+    if (launcher_run_sync(cmd, &out) && out.count == (size_t) width*height*4) {
+        *pixels = (unsigned char*) out.items;
+        return true;
+    }
+    nob_sb_free(out);
+    return false;
+}
+
+
+static void compare_work(void *arg) {
+    Compare_Task *task = arg;
+    Compare_Values ssim = {0}, psnr = {0};
+    char ssim_path[PATH_MAX + 16], psnr_path[PATH_MAX + 16];
+    snprintf(ssim_path, sizeof(ssim_path), "%s/ssim.log", task->dir);
+    snprintf(psnr_path, sizeof(psnr_path), "%s/psnr.log", task->dir);
+
+    Nob_String_Builder out = {0};
+    if (!launcher_run_sync(task->encode, &out)) goto defer;
+    struct stat st;
+    if (stat(task->excerpt, &st) == 0) task->kbps = st.st_size*8/1000.0/COMPARE_EXCERPT;
+
+    if (!launcher_run_sync(task->metrics, &out)) goto defer;
+    if (!compare_read_stats(ssim_path, "All:", &ssim) || !compare_read_stats(psnr_path, "psnr_avg:", &psnr)) goto defer;
+    for (size_t i = 0; i < ssim.count && i < psnr.count; ++i) {
+        nob_da_append(&task->result, ((Compare_Metric){ssim.items[i], psnr.items[i]}));
+    }
+    task->frame = (size_t)(task->offset / COMPARE_EXCERPT * task->result.count);
+    if (task->frame >= task->result.count) task->frame = task->result.count - 1;
+
+    if (!compare_run_frame(task->source_frame, task->width, task->height, &task->source_pixels)) goto defer;
+    if (!compare_run_frame(task->encoded_frame, task->width, task->height, &task->encoded_pixels)) goto defer;
+    task->ok = true;
+
+defer:
+    nob_sb_free(out);
+    nob_da_free(ssim);
+    nob_da_free(psnr);
+    unlink(task->excerpt);
+    unlink(ssim_path);
+    unlink(psnr_path);
+    rmdir(task->dir);
+}
+
+
+static void compare_done(void *arg) {
+    Compare_Task *task = arg;
+    Compare *compare = task->compare;
+    if (task->generation == compare->generation) {
+        if (task->ok) {
+            if (compare->source.id != 0) UnloadTexture(compare->source);
+            if (compare->encoded.id != 0) UnloadTexture(compare->encoded);
+            compare->source = LoadTextureFromImage((Image){task->source_pixels, task->width, task->height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8});
+            compare->encoded = LoadTextureFromImage((Image){task->encoded_pixels, task->width, task->height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8});
+            SetTextureFilter(compare->source, TEXTURE_FILTER_BILINEAR);
+            SetTextureFilter(compare->encoded, TEXTURE_FILTER_BILINEAR);
+            nob_da_free(compare->metrics);
+            compare->metrics = task->result;
+            memset(&task->result, 0, sizeof(task->result));
+            compare->frame = task->frame;
+            compare->kbps = task->kbps;
+            compare->state = COMPARE_READY;
+        } else {
+            compare->state = COMPARE_FAILED;
+        }
+    }
+    compare_task_free(task);
+}
+
+
+void compare_start(Compare *compare, FfmpegParams params, const Probe *probe, double time) {
+    compare->generation += 1;
+    compare->crf = params.crf;
+    compare->state = COMPARE_FAILED;
+    if (strlen(params.input_path) == 0 || !probe->ok) return;
+    // Crops apply to the frames as players show them.
+    bool turned = probe->rotation % 180 == 90;
+    int width = (turned ? probe->height : probe->width) - params.crop_left - params.crop_right;
+    int height = (turned ? probe->width : probe->height) - params.crop_top - params.crop_bottom;
+    if (width <= 0 || height <= 0) return;
+    if (params.rotation % 180 == 90) {
+        int w = width;
+        width = height;
+        height = w;
+    }
+
+    // The excerpt stays inside the input, the shown frame a bit before its end.
+    double start = time - COMPARE_EXCERPT/2;
+    if (probe->duration > 0 && start + COMPARE_EXCERPT > probe->duration) start = probe->duration - COMPARE_EXCERPT;
+    if (start < 0) start = 0;
+
+    Compare_Task *task = calloc(1, sizeof(*task));
+    task->compare = compare;
+    task->generation = compare->generation;
+    const char *tmp = getenv("TMPDIR");
+    snprintf(task->dir, sizeof(task->dir), "%s/vp-compare-XXXXXX", tmp != NULL && *tmp != '\0' ? tmp : "/tmp");
+    if (mkdtemp(task->dir) == NULL) {
+        nob_log(NOB_ERROR, "could not create %s: %s", task->dir, strerror(errno));
+        free(task);
+        return;
+    }
+    compare_fit_size(width, height, &task->width, &task->height);
+    task->offset = time - start;
+    if (task->offset > COMPARE_EXCERPT - 0.1) task->offset = COMPARE_EXCERPT - 0.1;
+    if (task->offset < 0) task->offset = 0;
+
+    size_t checkpoint = nob_temp_save();
+    const char *ext = strrchr(params.output_path, '.');
+    snprintf(task->excerpt, sizeof(task->excerpt), "%s/excerpt%s", task->dir, ext != NULL ? ext : ".mp4");
+    // The screen recording profile keeps its tune, but not mpdecimate: SSIM and PSNR pair the
+    // frames of both sides in order, and dropped ones would shift everything after them.
+    FfmpegParams every_frame = params;
+    every_frame.screen_recording = false;
+    const char *video = ffmpeg_video_filter(every_frame);
+    const char *crop = video != NULL ? nob_temp_sprintf("%s,", video) : "";
+    const char *seek = nob_temp_sprintf("%.3f", start);
+    const char *length = nob_temp_sprintf("%.3f", COMPARE_EXCERPT);
+    const char *at = nob_temp_sprintf("%.3f", task->offset);
+    const char *scale = nob_temp_sprintf("scale=%d:%d", task->width, task->height);
+
+    // ffmpeg -ss 11.000 -t 2.000 -i in.mp4 -crf 28 -vf crop=... -an excerpt.mp4
+    nob_cmd_append(&task->encode, "ffmpeg", "-y", "-v", "error", "-nostdin", "-ss", seek, "-t", length, "-i", params.input_path);
+    ffmpeg_append_encoder_options(&task->encode, params);
+    if (video != NULL) nob_cmd_append(&task->encode, "-vf", video);
+    nob_cmd_append(&task->encode, "-an", task->excerpt);
+
+    // SSIM and PSNR of every frame in one pass, both against the source with the same crop.
+    const char *graph = nob_temp_sprintf(
+            "[0:v]setpts=PTS-STARTPTS,split[e0][e1];"
+            "[1:v]%ssetpts=PTS-STARTPTS,split[s0][s1];"
+            "[e0][s0]ssim=stats_file=%s/ssim.log[o0];"
+            "[e1][s1]psnr=stats_file=%s/psnr.log[o1]",
+            crop, task->dir, task->dir);
+    nob_cmd_append(&task->metrics, "ffmpeg", "-v", "error", "-nostdin", "-i", task->excerpt);
+    nob_cmd_append(&task->metrics, "-ss", seek, "-t", length, "-i", params.input_path);
+    nob_cmd_append(&task->metrics, "-lavfi", graph, "-map", "[o0]", "-map", "[o1]", "-f", "null", "-");
+
+    // The same frame of both sides: the source is seeked like the excerpt was cut.
+    nob_cmd_append(&task->source_frame, "ffmpeg", "-v", "error", "-nostdin", "-ss", seek, "-i", params.input_path, "-ss", at);
+    nob_cmd_append(&task->source_frame, "-frames:v", "1", "-an", "-vf", nob_temp_sprintf("%s%s", crop, scale));
+    nob_cmd_append(&task->source_frame, "-pix_fmt", "rgba", "-f", "rawvideo", "pipe:1");
+    nob_cmd_append(&task->encoded_frame, "ffmpeg", "-v", "error", "-nostdin", "-i", task->excerpt, "-ss", at);
+    nob_cmd_append(&task->encoded_frame, "-frames:v", "1", "-an", "-vf", scale, "-pix_fmt", "rgba", "-f", "rawvideo", "pipe:1");
+
+    compare_cmd_own(&task->encode);
+    compare_cmd_own(&task->metrics);
+    compare_cmd_own(&task->source_frame);
+    compare_cmd_own(&task->encoded_frame);
+    nob_temp_rewind(checkpoint);
+
+    compare->state = COMPARE_RUNNING;
+    pool_submit(compare_work, compare_done, task);
+}
+
+
+// Largest rectangle with the aspect ratio of `texture` centered in `dest`.
+static Rectangle compare_fit_rect(Texture2D texture, Rectangle dest) {
+    float scale = dest.width / texture.width;
+    if (texture.height*scale > dest.height) scale = dest.height / texture.height;
+    float width = texture.width*scale, height = texture.height*scale;
+    return (Rectangle){dest.x + (dest.width - width)/2, dest.y + (dest.height - height)/2, width, height};
+}
+
+
+static void compare_draw_texture(Texture2D texture, Rectangle dest, const char *label) {
+    Rectangle fitted = compare_fit_rect(texture, dest);
+    DrawTexturePro(texture, (Rectangle){0, 0, texture.width, texture.height}, fitted, (Vector2){0}, 0, WHITE);
+    DrawText(label, fitted.x + 4, fitted.y + 4, 10, YELLOW);
+}
+
+
+// SSIM and PSNR over the excerpt, each scaled to its own range, with the shown frame marked.
+static void compare_draw_graph(const Compare *compare, Rectangle graph) {
+    DrawRectangleLinesEx(graph, 1, LIGHTGRAY);
+    const Compare_Metrics *metrics = &compare->metrics;
+    if (metrics->count < 2) return;
+
+    double ssim_min = 1, psnr_min = INFINITY, psnr_max = -INFINITY;
+    for (size_t i = 0; i < metrics->count; ++i) {
+        if (metrics->items[i].ssim < ssim_min) ssim_min = metrics->items[i].ssim;
+        if (isinf(metrics->items[i].psnr)) continue;
+        if (metrics->items[i].psnr < psnr_min) psnr_min = metrics->items[i].psnr;
+        if (metrics->items[i].psnr > psnr_max) psnr_max = metrics->items[i].psnr;
+    }
+    if (ssim_min > 0.99) ssim_min = 0.99;
+    if (psnr_max - psnr_min < 1) psnr_max = psnr_min + 1;
+
+    float step = graph.width / (metrics->count - 1);
+    for (size_t i = 1; i < metrics->count; ++i) {
+        const Compare_Metric *a = &metrics->items[i - 1], *b = &metrics->items[i];
+        float x0 = graph.x + (i - 1)*step, x1 = graph.x + i*step;
+        float s0 = (a->ssim - ssim_min) / (1 - ssim_min), s1 = (b->ssim - ssim_min) / (1 - ssim_min);
+        DrawLineV((Vector2){x0, graph.y + graph.height*(1 - s0)}, (Vector2){x1, graph.y + graph.height*(1 - s1)}, BLUE);
+        if (isinf(a->psnr) || isinf(b->psnr) || isinf(psnr_min)) continue;
+        float p0 = (a->psnr - psnr_min) / (psnr_max - psnr_min), p1 = (b->psnr - psnr_min) / (psnr_max - psnr_min);
+        DrawLineV((Vector2){x0, graph.y + graph.height*(1 - p0)}, (Vector2){x1, graph.y + graph.height*(1 - p1)}, ORANGE);
+    }
+    float marker = graph.x + compare->frame*step;
+    DrawLineV((Vector2){marker, graph.y}, (Vector2){marker, graph.y + graph.height}, RED);
+    DrawText("ssim", graph.x + graph.width - 60, graph.y + 2, 10, BLUE);
+    DrawText("psnr", graph.x + graph.width - 30, graph.y + 2, 10, ORANGE);
+}
+
+
+void compare_draw(const Compare *compare, Rectangle area, Compare_Mode mode) {
+    DrawRectangleRec(area, WHITE);
+    DrawRectangleLinesEx(area, 2, BLACK);
+    Vector2 header = {area.x + 8, area.y + 6};
+    switch (compare->state) {
+    case COMPARE_IDLE:
+        return;
+    case COMPARE_RUNNING:
+        DrawText(TextFormat("A/B crf %d: encoding %.0fs around the scrub position...", compare->crf, COMPARE_EXCERPT), header.x, header.y, 12, DARKGRAY);
+        return;
+    case COMPARE_FAILED:
+        DrawText(TextFormat("A/B crf %d: failed, see the log", compare->crf), header.x, header.y, 12, RED);
+        return;
+    case COMPARE_READY:
+        break;
+    }
+
+    double ssim = 0, psnr = 0;
+    size_t finite = 0;
+    for (size_t i = 0; i < compare->metrics.count; ++i) {
+        ssim += compare->metrics.items[i].ssim;
+        if (isinf(compare->metrics.items[i].psnr)) continue;
+        psnr += compare->metrics.items[i].psnr;
+        finite += 1;
+    }
+    const Compare_Metric *here = &compare->metrics.items[compare->frame];
+    DrawText(TextFormat("A/B crf %d, %.0f kbps | SSIM %.4f here, %.4f avg | PSNR %.2f dB here, %.2f dB avg",
+                        compare->crf, compare->kbps,
+                        here->ssim, ssim / compare->metrics.count,
+                        here->psnr, finite > 0 ? psnr / finite : INFINITY),
+             header.x, header.y, 12, BLACK);
+
+    Rectangle frames = {area.x + 8, area.y + 24, area.width - 16, area.height - 24 - 48};
+    const char *encoded = TextFormat("crf %d", compare->crf);
+    switch (mode) {
+    case COMPARE_SIDE_BY_SIDE: {
+        float half = frames.width/2 - 4;
+        compare_draw_texture(compare->source, (Rectangle){frames.x, frames.y, half, frames.height}, "source");
+        compare_draw_texture(compare->encoded, (Rectangle){frames.x + half + 8, frames.y, half, frames.height}, encoded);
+    } break;
+    case COMPARE_WIPE: {
+        // The source left of the mouse, the encode right of it.
+        Rectangle fitted = compare_fit_rect(compare->source, frames);
+        float split = GetMousePosition().x;
+        if (split < fitted.x) split = fitted.x;
+        if (split > fitted.x + fitted.width) split = fitted.x + fitted.width;
+        float t = (split - fitted.x) / fitted.width;
+        compare_draw_texture(compare->source, frames, "source");
+        DrawTexturePro(compare->encoded,
+                       (Rectangle){compare->encoded.width*t, 0, compare->encoded.width*(1 - t), compare->encoded.height},
+                       (Rectangle){split, fitted.y, fitted.width*(1 - t), fitted.height},
+                       (Vector2){0}, 0, WHITE);
+        DrawLineV((Vector2){split, fitted.y}, (Vector2){split, fitted.y + fitted.height}, RED);
+        DrawText(encoded, fitted.x + fitted.width - MeasureText(encoded, 10) - 4, fitted.y + 4, 10, YELLOW);
+    } break;
+    case COMPARE_FLICKER: {
+        bool source = (int)(GetTime()*2) % 2 == 0;
+        compare_draw_texture(source ? compare->source : compare->encoded, frames, source ? "source" : encoded);
+    } break;
+    case COMPARE_MODE_COUNT:
+        break;
+    }
+
+    compare_draw_graph(compare, (Rectangle){area.x + 8, area.y + area.height - 44, area.width - 16, 36});
+}
+
+
+void compare_free(Compare *compare) {
+    if (compare->source.id != 0) UnloadTexture(compare->source);
+    if (compare->encoded.id != 0) UnloadTexture(compare->encoded);
+    nob_da_free(compare->metrics);
+    memset(compare, 0, sizeof(*compare));
+}
@@ -0,0 +1,67 @@
+#ifndef COMPARE_H_
+#define COMPARE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "./ffmpeg.h"
+#include "./probe.h"
+#include "./thirdparty/raylib/src/raylib.h"
+
+// A/B view: encodes COMPARE_EXCERPT seconds around the scrub position with the current settings
+// and shows the source next to the result, so a CRF can be judged without encoding the whole file.
+//
+// Everything runs on the pool: the excerpt encode, one ffmpeg pass over the excerpt and the
+// source that writes the SSIM and PSNR of every frame, and one frame of each side.
+
+#define COMPARE_EXCERPT 2.0 // seconds
+#define COMPARE_SIZE 640 // longest side of the frames in pixels
+
+typedef enum {
+    COMPARE_SIDE_BY_SIDE,
+    COMPARE_WIPE,
+    COMPARE_FLICKER,
+    COMPARE_MODE_COUNT,
+} Compare_Mode;
+
+typedef enum {
+    COMPARE_IDLE,
+    COMPARE_RUNNING,
+    COMPARE_READY,
+    COMPARE_FAILED,
+} Compare_State;
+
+typedef struct {
+    double ssim; // All
+    double psnr; // psnr_avg in dB, INFINITY for identical frames
+} Compare_Metric;
+
+typedef struct {
+    Compare_Metric *items; // one per frame of the excerpt
+    size_t count;
+    size_t capacity;
+} Compare_Metrics;
+
+typedef struct {
+    Compare_State state;
+    size_t generation;
+    int crf;
+    Texture2D source;
+    Texture2D encoded;
+    Compare_Metrics metrics;
+    size_t frame; // index of the shown frame in `metrics`
+    double kbps; // of the excerpt
+} Compare;
+
+const char *compare_mode_name(Compare_Mode mode);
+
+// Starts over with `params` at `time` seconds. Whatever was running is dropped when it finishes.
+void compare_start(Compare *compare, FfmpegParams params, const Probe *probe, double time);
+
+// Draws the view into `area`: the frames as `mode` says, the averages and a graph of the metrics.
+void compare_draw(const Compare *compare, Rectangle area, Compare_Mode mode);
+
+// Call after pool_shutdown() and before CloseWindow().
+void compare_free(Compare *compare);
+
+#endif // COMPARE_H_
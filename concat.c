@@ -0,0 +1,188 @@
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./concat.h"
+
+// GOPRnnnn -> (nnnn, 0), GPccnnnn/GXccnnnn/GHccnnnn -> (nnnn, cc)
+static bool concat_gopro_chapter(const char *path, int *video, int *chapter) {
+    const char *name = nob_path_name(path);
+    if (strlen(name) < 8) return false;
+    for (size_t i = 4; i < 8; ++i) {
+        if (!isdigit((unsigned char) name[i])) return false;
+    }
+    if (strncmp(name, "GOPR", 4) == 0) {
+        *chapter = 0;
+    } else if (name[0] == 'G' && (name[1] == 'P' || name[1] == 'X' || name[1] == 'H')
+               && isdigit((unsigned char) name[2]) && isdigit((unsigned char) name[3])) {
+        *chapter = (name[2] - '0')*10 + (name[3] - '0');
+    } else {
+        return false;
+    }
+    *video = atoi(name + 4);
+    return true;
+}
+
+
+static int compare_gopro_chapters(const void *a, const void *b) {
+    int video_a, chapter_a, video_b, chapter_b;
+    concat_gopro_chapter(*(char * const*) a, &video_a, &chapter_a);
+    concat_gopro_chapter(*(char * const*) b, &video_b, &chapter_b);
+    if (video_a != video_b) return (video_a > video_b) - (video_a < video_b);
+    return (chapter_a > chapter_b) - (chapter_a < chapter_b);
+}
+
+
+void concat_sort_chapters(char **paths, size_t count) {
+    int video, chapter;
+    for (size_t i = 0; i < count; ++i) {
+        if (!concat_gopro_chapter(paths[i], &video, &chapter)) return;
+    }
+    qsort(paths, count, sizeof(*paths), compare_gopro_chapters);
+}
+
+
+bool concat_compatible(const Probe *probes, size_t count, char *reason, size_t size) {
+    const Probe *first = &probes[0];
+    for (size_t i = 1; i < count; ++i) {
+        const Probe *p = &probes[i];
+        const char *what = NULL;
+        if (!p->ok || !first->ok)                              what = "could not be probed";
+        else if (strcmp(p->video_codec, first->video_codec))   what = "video codec";
+        else if (strcmp(p->video_profile, first->video_profile)) what = "video profile";
+        else if (p->width != first->width || p->height != first->height) what = "resolution";
+        else if (strcmp(p->pix_fmt, first->pix_fmt))           what = "pixel format";
+        else if (strcmp(p->frame_rate, first->frame_rate))     what = "frame rate";
+        else if (strcmp(p->audio_codec, first->audio_codec))   what = "audio codec";
+        else if (p->sample_rate != first->sample_rate)         what = "sample rate";
+        else if (p->channels != first->channels)               what = "audio channels";
+        if (what != NULL) {
+            snprintf(reason, size, "part %zu differs from the first one: %s", i + 1, what);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// The entries are absolute, the demuxer would resolve relative ones against the list's directory.
+static bool concat_write_list(const char *list_path, char **paths, size_t count) {
+    FILE *f = fopen(list_path, "w");
+    if (f == NULL) {
+        nob_log(NOB_ERROR, "could not write %s: %s", list_path, strerror(errno));
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        char resolved[PATH_MAX];
+        const char *path = realpath(paths[i], resolved) != NULL ? resolved : paths[i];
+        fprintf(f, "file '");
+        for (const char *c = path; *c != '\0'; ++c) {
+            if (*c == '\'') fprintf(f, "'\\''");
+            else fputc(*c, f);
+        }
+        fprintf(f, "'\n");
+    }
+    bool ok = !ferror(f);
+    if (fclose(f) != 0) ok = false;
+    if (!ok) nob_log(NOB_ERROR, "could not write %s", list_path);
+    return ok;
+}
+
+
+int concat_audio_part(const Probe *probes, size_t count) {
+    int audio = -1;
+    for (size_t i = 0; i < count; ++i) {
+        if (probes[i].audio_codec[0] != '\0') {
+            if (audio < 0) audio = i;
+        } else if (probes[i].duration <= 0) {
+            return -1;
+        }
+    }
+    return audio;
+}
+
+
+// Every part is brought to the format of the first one before the concat filter, the audio to
+// the format of the first part that has audio:
+//   [1:v:0]scale=1920:1080:force_original_aspect_ratio=decrease,pad=...,setsar=1,fps=30,format=yuv420p[v1];
+//   [1:a:0]aformat=channel_layouts=stereo:sample_rates=48000[a1];
+//   [v0][a0][v1][a1]concat=n=2:v=1:a=1[vc][ac];[vc]crop=...[v];[ac]volume=1.00[a]
+// A part without audio gets silence instead of [i:a:0], which ffmpeg would fail on:
+//   anullsrc=channel_layout=stereo:sample_rate=48000,atrim=duration=12.500000[a1];
+static const char *concat_filter_graph(FfmpegParams params, const Probe *probes) {
+    const Probe *first = &probes[0];
+    int audio_part = concat_audio_part(probes, params.concat_count);
+    bool audio = audio_part >= 0;
+    const char *layout = audio && probes[audio_part].channels == 1 ? "mono" : "stereo";
+    int sample_rate = audio && probes[audio_part].sample_rate > 0 ? probes[audio_part].sample_rate : 48000;
+    bool fps = first->frame_rate[0] != '\0' && strcmp(first->frame_rate, "0/0") != 0;
+    Nob_String_Builder sb = {0};
+    for (size_t i = 0; i < params.concat_count; ++i) {
+        nob_sb_appendf(&sb, "[%zu:v:0]scale=%d:%d:force_original_aspect_ratio=decrease,pad=%d:%d:(ow-iw)/2:(oh-ih)/2,setsar=1",
+                       i, first->width, first->height, first->width, first->height);
+        if (fps) nob_sb_appendf(&sb, ",fps=%s", first->frame_rate);
+        if (first->pix_fmt[0] != '\0') nob_sb_appendf(&sb, ",format=%s", first->pix_fmt);
+        nob_sb_appendf(&sb, "[v%zu];", i);
+        if (!audio) continue;
+        if (probes[i].audio_codec[0] != '\0') {
+            nob_sb_appendf(&sb, "[%zu:a:0]aformat=channel_layouts=%s:sample_rates=%d[a%zu];", i, layout, sample_rate, i);
+        } else {
+            nob_sb_appendf(&sb, "anullsrc=channel_layout=%s:sample_rate=%d,atrim=duration=%.6f[a%zu];",
+                           layout, sample_rate, probes[i].duration, i);
+        }
+    }
+    for (size_t i = 0; i < params.concat_count; ++i) {
+        nob_sb_appendf(&sb, "[v%zu]", i);
+        if (audio) nob_sb_appendf(&sb, "[a%zu]", i);
+    }
+    nob_sb_appendf(&sb, "concat=n=%zu:v=1:a=%d[vc]", params.concat_count, audio ? 1 : 0);
+    if (audio) nob_sb_append_cstr(&sb, "[ac]");
+
+    const char *video_filter = ffmpeg_video_filter(params);
+    nob_sb_appendf(&sb, ";[vc]%s[v]", video_filter != NULL ? video_filter : "null");
+    if (audio) {
+        const char *audio_filter = ffmpeg_audio_filter(params);
+        nob_sb_appendf(&sb, ";[ac]%s[a]", audio_filter != NULL ? audio_filter : "anull");
+    }
+    nob_sb_append_null(&sb);
+
+    const char *graph = nob_temp_strdup(sb.items);
+    nob_sb_free(sb);
+    return graph;
+}
+
+
+bool concat_build_cmd(Nob_Cmd *cmd, FfmpegParams params, const Probe *probes, const char *list_path) {
+    nob_cmd_append(cmd, "ffmpeg", "-y", "-nostats");
+    if (params.threads > 0) nob_cmd_append(cmd, "-threads", nob_temp_sprintf("%d", params.threads));
+
+    if (params.concat_demuxer) {
+        if (!concat_write_list(list_path, params.concat_paths, params.concat_count)) return false;
+        nob_cmd_append(cmd, "-f", "concat", "-safe", "0", "-i", nob_temp_strdup(list_path));
+        if (params.stream_copy) {
+            nob_cmd_append(cmd, "-c", "copy");
+        } else {
+            ffmpeg_append_encoder_options(cmd, params);
+            const char *video = ffmpeg_video_filter(params);
+            if (video != NULL) nob_cmd_append(cmd, "-vf", video);
+            const char *audio = ffmpeg_audio_filter(params);
+            if (audio != NULL) nob_cmd_append(cmd, "-af", audio);
+        }
+    } else {
+        for (size_t i = 0; i < params.concat_count; ++i) {
+            nob_cmd_append(cmd, "-i", params.concat_paths[i]);
+        }
+        nob_cmd_append(cmd, "-filter_complex", concat_filter_graph(params, probes));
+        nob_cmd_append(cmd, "-map", "[v]");
+        if (concat_audio_part(probes, params.concat_count) >= 0) nob_cmd_append(cmd, "-map", "[a]");
+        ffmpeg_append_encoder_options(cmd, params);
+    }
+    ffmpeg_append_output_options(cmd, params);
+
+    nob_cmd_append(cmd, "-progress", "pipe:1");
+    nob_cmd_append(cmd, params.output_path);
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef CONCAT_H_
+#define CONCAT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "./ffmpeg.h"
+#include "./probe.h"
+
+// Joining several inputs, e.g. the chapters a camera splits a long recording into.
+//
+// When all the parts have the same codec parameters the concat demuxer reads them as one
+// continuous input. Without crop or audio changes that's a plain stream copy, otherwise a single
+// encode with the usual settings. Parts that differ go through the concat filter instead, scaled,
+// padded and resampled to the format of the first part, and are encoded once. Parts without
+// audio get silence of their length in the format of the first part that has audio.
+
+// Puts GoPro chapters in recording order: GOPR0042, GP010042, GP020042, ... (or GX010042,
+// GX020042, ... on newer cameras). Other selections are left in the order they came in.
+void concat_sort_chapters(char **paths, size_t count);
+
+// True when the parts can be joined without decoding them. Otherwise `reason` says what differs.
+bool concat_compatible(const Probe *probes, size_t count, char *reason, size_t size);
+
+// Index of the part whose audio format the join takes, -1 when the join has no audio: none of the
+// parts has any, or a part without it has no known duration to fill with silence.
+int concat_audio_part(const Probe *probes, size_t count);
+
+// Appends the ffmpeg invocation that joins `params.concat_paths` into `params.output_path` to `cmd`.
+// `probes` has one entry per part. `list_path` is where the list for the concat demuxer goes.
+// Returns false when it can't be written.
+bool concat_build_cmd(Nob_Cmd *cmd, FfmpegParams params, const Probe *probes, const char *list_path);
+
+#endif // CONCAT_H_
@@ -0,0 +1,856 @@
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./container.h"
+#include "./thirdparty/nob.h"
+
+#define MP4_TYPE(a, b, c, d) ((uint32_t)(a) << 24 | (uint32_t)(b) << 16 | (uint32_t)(c) << 8 | (uint32_t)(d))
+#define AVI_ID(a, b, c, d) ((uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16 | (uint32_t)(d) << 24)
+
+#define AVI_MAX_STREAMS 16
+#define AVIIF_KEYFRAME 0x10
+#define AVI_INDEX_OF_INDEXES 0x00
+#define AVI_INDEX_OF_CHUNKS 0x01
+
+typedef struct {
+    const uint8_t *data;
+    size_t count;
+} Bytes;
+
+static uint16_t be16(const uint8_t *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+static uint32_t be32(const uint8_t *p) { return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3]; }
+static uint64_t be64(const uint8_t *p) { return (uint64_t) be32(p) << 32 | be32(p + 4); }
+static uint16_t le16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+static uint32_t le32(const uint8_t *p) { return p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24; }
+static uint64_t le64(const uint8_t *p) { return le32(p) | (uint64_t) le32(p + 4) << 32; }
+
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+
+// ffprobe writes frame rates as reduced fractions: 30000/1001, 25/1
+static void container_frame_rate(char *dst, size_t size, uint64_t num, uint64_t den) {
+    if (num == 0 || den == 0) return;
+    uint64_t d = gcd(num, den);
+    snprintf(dst, size, "%llu/%llu", (unsigned long long)(num / d), (unsigned long long)(den / d));
+}
+
+
+static void container_pix_fmt(char *dst, size_t size, int chroma_format, int bit_depth) {
+    static const char *chroma[] = {"gray", "yuv420p", "yuv422p", "yuv444p"};
+    if (chroma_format < 0 || chroma_format > 3) return;
+    if (bit_depth <= 8) {
+        snprintf(dst, size, "%s", chroma[chroma_format]);
+    } else if (chroma_format == 0) {
+        snprintf(dst, size, "gray%dle", bit_depth);
+    } else {
+        snprintf(dst, size, "%s%dle", chroma[chroma_format], bit_depth);
+    }
+}
+
+
+// ISO/IEC 23091-2 code points by ffprobe's name, codes without one are written as numbers, which
+// ffmpeg takes as well. 2 is "unspecified" and stays empty.
+typedef struct {
+    int code;
+    const char *name;
+} Container_Color;
+
+static const Container_Color container_primaries[] = {
+    {1, "bt709"}, {4, "bt470m"}, {5, "bt470bg"}, {6, "smpte170m"}, {7, "smpte240m"}, {8, "film"},
+    {9, "bt2020"}, {10, "smpte428"}, {11, "smpte431"}, {12, "smpte432"}, {22, "jedec-p22"},
+};
+static const Container_Color container_transfers[] = {
+    {1, "bt709"}, {4, "gamma22"}, {5, "gamma28"}, {6, "smpte170m"}, {7, "smpte240m"}, {8, "linear"},
+    {13, "iec61966-2-1"}, {14, "bt2020-10"}, {15, "bt2020-12"}, {16, "smpte2084"}, {18, "arib-std-b67"},
+};
+static const Container_Color container_spaces[] = {
+    {0, "gbr"}, {1, "bt709"}, {4, "fcc"}, {5, "bt470bg"}, {6, "smpte170m"}, {7, "smpte240m"},
+    {8, "ycgco"}, {9, "bt2020nc"}, {10, "bt2020c"},
+};
+
+
+static void container_color(char *dst, size_t size, const Container_Color *colors, size_t count, int code) {
+    if (code == 2) return;
+    for (size_t i = 0; i < count; ++i) {
+        if (colors[i].code == code) {
+            snprintf(dst, size, "%s", colors[i].name);
+            return;
+        }
+    }
+    snprintf(dst, size, "%d", code);
+}
+
+
+static int64_t container_us(int64_t t, uint64_t timescale) {
+    return (int64_t)((double) t * 1e6 / (double) timescale + (t < 0 ? -0.5 : 0.5));
+}
+
+
+// MP4 ////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+    uint32_t type;
+    Bytes body;
+} Mp4_Box;
+
+typedef struct {
+    uint32_t handler;
+    uint32_t timescale;
+    uint64_t duration;
+    Bytes tkhd, stsd, stts, ctts, stss, stsz, stsc, stco, elst;
+    bool co64;
+} Mp4_Track;
+
+
+static bool mp4_next_box(Bytes *b, Mp4_Box *box) {
+    if (b->count < 8) return false;
+    uint64_t size = be32(b->data);
+    size_t header = 8;
+    if (size == 1) {
+        if (b->count < 16) return false;
+        size = be64(b->data + 8);
+        header = 16;
+    } else if (size == 0) {
+        size = b->count; // to the end of the file
+    }
+    if (size < header || size > b->count) return false;
+    box->type = be32(b->data + 4);
+    box->body = (Bytes){b->data + header, size - header};
+    b->data += size;
+    b->count -= size;
+    return true;
+}
+
+
+static bool mp4_find_box(Bytes b, uint32_t type, Bytes *body) {
+    Mp4_Box box;
+    while (mp4_next_box(&b, &box)) {
+        if (box.type == type) {
+            *body = box.body;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Full boxes start with version and flags, followed by an entry count for the tables.
+// Checks that `entry_size` times the count fits.
+static bool mp4_table(Bytes table, size_t header, size_t entry_size, uint32_t *count) {
+    if (table.count < header + 4) return false;
+    *count = be32(table.data + header);
+    return (uint64_t) *count * entry_size <= table.count - header - 4;
+}
+
+
+// mvhd and mdhd share the layout of the timescale and duration.
+static bool mp4_timing(Bytes b, uint32_t *timescale, uint64_t *duration) {
+    if (b.count < 1) return false;
+    if (b.data[0] == 1) {
+        if (b.count < 32) return false;
+        *timescale = be32(b.data + 20);
+        *duration = be64(b.data + 24);
+    } else {
+        if (b.count < 20) return false;
+        *timescale = be32(b.data + 12);
+        *duration = be32(b.data + 16);
+    }
+    return *timescale > 0;
+}
+
+
+static bool mp4_parse_track(Bytes trak, Mp4_Track *t) {
+    Bytes mdia, mdhd, hdlr, minf, stbl, edts;
+    memset(t, 0, sizeof(*t));
+    if (!mp4_find_box(trak, MP4_TYPE('m','d','i','a'), &mdia)) return false;
+    if (!mp4_find_box(mdia, MP4_TYPE('m','d','h','d'), &mdhd)) return false;
+    if (!mp4_find_box(mdia, MP4_TYPE('h','d','l','r'), &hdlr) || hdlr.count < 12) return false;
+    if (!mp4_find_box(mdia, MP4_TYPE('m','i','n','f'), &minf)) return false;
+    if (!mp4_find_box(minf, MP4_TYPE('s','t','b','l'), &stbl)) return false;
+    if (!mp4_timing(mdhd, &t->timescale, &t->duration)) return false;
+    t->handler = be32(hdlr.data + 8);
+
+    mp4_find_box(trak, MP4_TYPE('t','k','h','d'), &t->tkhd);
+    if (mp4_find_box(trak, MP4_TYPE('e','d','t','s'), &edts)) mp4_find_box(edts, MP4_TYPE('e','l','s','t'), &t->elst);
+    mp4_find_box(stbl, MP4_TYPE('s','t','s','d'), &t->stsd);
+    mp4_find_box(stbl, MP4_TYPE('s','t','t','s'), &t->stts);
+    mp4_find_box(stbl, MP4_TYPE('c','t','t','s'), &t->ctts);
+    mp4_find_box(stbl, MP4_TYPE('s','t','s','s'), &t->stss);
+    mp4_find_box(stbl, MP4_TYPE('s','t','s','z'), &t->stsz);
+    mp4_find_box(stbl, MP4_TYPE('s','t','s','c'), &t->stsc);
+    if (!mp4_find_box(stbl, MP4_TYPE('s','t','c','o'), &t->stco)) {
+        t->co64 = mp4_find_box(stbl, MP4_TYPE('c','o','6','4'), &t->stco);
+    }
+    return true;
+}
+
+
+// First sample entry of stsd: its type and its body after the 8 byte box header.
+static bool mp4_sample_entry(const Mp4_Track *t, uint32_t *type, Bytes *entry) {
+    uint32_t count;
+    if (!mp4_table(t->stsd, 4, 0, &count) || count == 0) return false;
+    Bytes entries = {t->stsd.data + 8, t->stsd.count - 8};
+    Mp4_Box box;
+    if (!mp4_next_box(&entries, &box)) return false;
+    *type = box.type;
+    *entry = box.body;
+    return true;
+}
+
+
+static void mp4_parse_avcc(Bytes avcc, Probe *probe) {
+    if (avcc.count < 7) return;
+    int profile = avcc.data[1];
+    probe->level = avcc.data[3];
+    switch (profile) {
+    case 66:  snprintf(probe->video_profile, sizeof(probe->video_profile), (avcc.data[2] & 0x40) ? "Constrained Baseline" : "Baseline"); break;
+    case 77:  snprintf(probe->video_profile, sizeof(probe->video_profile), "Main"); break;
+    case 88:  snprintf(probe->video_profile, sizeof(probe->video_profile), "Extended"); break;
+    case 100: snprintf(probe->video_profile, sizeof(probe->video_profile), "High"); break;
+    case 110: snprintf(probe->video_profile, sizeof(probe->video_profile), "High 10"); break;
+    case 122: snprintf(probe->video_profile, sizeof(probe->video_profile), "High 4:2:2"); break;
+    case 244: snprintf(probe->video_profile, sizeof(probe->video_profile), "High 4:4:4 Predictive"); break;
+    }
+
+    // The chroma format and bit depth are only stored for the High profiles, after the parameter sets.
+    int chroma_format = 1, bit_depth = 8;
+    if (profile == 100 || profile == 110 || profile == 122 || profile == 244) {
+        size_t at = 6;
+        for (int sets = avcc.data[5] & 0x1f, pass = 0; pass < 2; ++pass) {
+            for (int i = 0; i < sets; ++i) {
+                if (at + 2 > avcc.count) goto done;
+                at += 2 + be16(avcc.data + at);
+            }
+            if (pass == 0) {
+                if (at >= avcc.count) goto done;
+                sets = avcc.data[at++];
+            }
+        }
+        if (at + 2 <= avcc.count) {
+            chroma_format = avcc.data[at] & 0x03;
+            bit_depth = 8 + (avcc.data[at + 1] & 0x07);
+        }
+    }
+done:
+    container_pix_fmt(probe->pix_fmt, sizeof(probe->pix_fmt), chroma_format, bit_depth);
+}
+
+
+static void mp4_parse_hvcc(Bytes hvcc, Probe *probe) {
+    if (hvcc.count < 18) return;
+    probe->level = hvcc.data[12];
+    switch (hvcc.data[1] & 0x1f) {
+    case 1: snprintf(probe->video_profile, sizeof(probe->video_profile), "Main"); break;
+    case 2: snprintf(probe->video_profile, sizeof(probe->video_profile), "Main 10"); break;
+    case 3: snprintf(probe->video_profile, sizeof(probe->video_profile), "Main Still Picture"); break;
+    case 4: snprintf(probe->video_profile, sizeof(probe->video_profile), "Rext"); break;
+    }
+    container_pix_fmt(probe->pix_fmt, sizeof(probe->pix_fmt), hvcc.data[16] & 0x03, 8 + (hvcc.data[17] & 0x07));
+}
+
+
+// The display matrix of tkhd, as far as it's one of the quarter turns. The a, b, c, d of
+// [a b u; c d v; x y w] are 16.16 fixed point, a quarter turn clockwise is [0 1; -1 0].
+static int mp4_rotation(Bytes tkhd) {
+    size_t offset = tkhd.count > 0 && tkhd.data[0] == 1 ? 52 : 40;
+    if (tkhd.count < offset + 20) return 0;
+    int32_t a = be32(tkhd.data + offset);
+    int32_t b = be32(tkhd.data + offset + 4);
+    int32_t c = be32(tkhd.data + offset + 12);
+    int32_t d = be32(tkhd.data + offset + 16);
+    if (a == 0 && d == 0 && b > 0 && c < 0) return 90;
+    if (a < 0 && d < 0 && b == 0 && c == 0) return 180;
+    if (a == 0 && d == 0 && b < 0 && c > 0) return 270;
+    return 0;
+}
+
+
+// Visual sample entries have 78 bytes of fixed fields before the codec configuration boxes.
+static void mp4_parse_video(const Mp4_Track *t, Probe *probe) {
+    uint32_t type;
+    Bytes entry;
+    probe->rotation = mp4_rotation(t->tkhd);
+    if (!mp4_sample_entry(t, &type, &entry) || entry.count < 78) return;
+    probe->width = be16(entry.data + 24);
+    probe->height = be16(entry.data + 26);
+    Bytes config = {entry.data + 78, entry.count - 78};
+    Bytes box;
+
+    const char *codec = NULL;
+    switch (type) {
+    case MP4_TYPE('a','v','c','1'):
+    case MP4_TYPE('a','v','c','3'):
+        codec = "h264";
+        if (mp4_find_box(config, MP4_TYPE('a','v','c','C'), &box)) mp4_parse_avcc(box, probe);
+        break;
+    case MP4_TYPE('h','v','c','1'):
+    case MP4_TYPE('h','e','v','1'):
+        codec = "hevc";
+        if (mp4_find_box(config, MP4_TYPE('h','v','c','C'), &box)) mp4_parse_hvcc(box, probe);
+        break;
+    case MP4_TYPE('m','p','4','v'):
+        codec = "mpeg4";
+        snprintf(probe->pix_fmt, sizeof(probe->pix_fmt), "yuv420p");
+        break;
+    case MP4_TYPE('a','v','0','1'): codec = "av1"; break;
+    case MP4_TYPE('v','p','0','9'): codec = "vp9"; break;
+    case MP4_TYPE('j','p','e','g'):
+    case MP4_TYPE('m','j','p','a'): codec = "mjpeg"; break;
+    }
+    // nclx colour information, the same code points as the VUI of the codec. ICC profiles aren't
+    // worth reading.
+    if (mp4_find_box(config, MP4_TYPE('c','o','l','r'), &box) && box.count >= 11 && be32(box.data) == MP4_TYPE('n','c','l','x')) {
+        container_color(probe->color_primaries, sizeof(probe->color_primaries), container_primaries, NOB_ARRAY_LEN(container_primaries), be16(box.data + 4));
+        container_color(probe->color_transfer, sizeof(probe->color_transfer), container_transfers, NOB_ARRAY_LEN(container_transfers), be16(box.data + 6));
+        container_color(probe->color_space, sizeof(probe->color_space), container_spaces, NOB_ARRAY_LEN(container_spaces), be16(box.data + 8));
+        snprintf(probe->color_range, sizeof(probe->color_range), "%s", (box.data[10] & 0x80) ? "pc" : "tv");
+    }
+
+    if (codec != NULL) {
+        snprintf(probe->video_codec, sizeof(probe->video_codec), "%s", codec);
+    } else {
+        char fourcc[5] = {type >> 24, type >> 16, type >> 8, type, 0};
+        snprintf(probe->video_codec, sizeof(probe->video_codec), "%s", fourcc);
+    }
+
+    // The most common sample duration gives the frame rate.
+    uint32_t count;
+    if (!mp4_table(t->stts, 4, 8, &count)) return;
+    uint32_t best_count = 0, best_delta = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint8_t *e = t->stts.data + 8 + i*8;
+        if (be32(e) > best_count) {
+            best_count = be32(e);
+            best_delta = be32(e + 4);
+        }
+    }
+    container_frame_rate(probe->frame_rate, sizeof(probe->frame_rate), t->timescale, best_delta);
+}
+
+
+// Only the object type of the decoder config matters: ES_Descriptor(0x03) > DecoderConfigDescriptor(0x04)
+static int mp4_esds_object_type(Bytes esds) {
+    size_t at = 4;
+    for (int expected = 0x03; expected <= 0x04; ++expected) {
+        if (at >= esds.count || esds.data[at++] != expected) return 0;
+        for (int i = 0; i < 4 && at < esds.count; ++i) {
+            if ((esds.data[at++] & 0x80) == 0) break;
+        }
+        if (expected == 0x03) {
+            if (at + 3 > esds.count) return 0;
+            uint8_t flags = esds.data[at + 2];
+            at += 3;
+            if (flags & 0x80) at += 2;
+            if (flags & 0x40) at += at < esds.count ? 1 + esds.data[at] : 0;
+            if (flags & 0x20) at += 2;
+        }
+    }
+    return at < esds.count ? esds.data[at] : 0;
+}
+
+
+// Sound sample entries: 28 bytes of fixed fields in version 0, QuickTime adds 16 in version 1 and 36 in version 2.
+static void mp4_parse_audio(const Mp4_Track *t, Probe *probe) {
+    uint32_t type;
+    Bytes entry;
+    if (!mp4_sample_entry(t, &type, &entry) || entry.count < 28) return;
+    int version = be16(entry.data + 8);
+    probe->channels = be16(entry.data + 16);
+    probe->sample_rate = be32(entry.data + 24) >> 16;
+    size_t fixed = 28;
+    if (version == 1) {
+        fixed = 44;
+    } else if (version == 2 && entry.count >= 64) {
+        uint64_t bits = be64(entry.data + 32);
+        double rate;
+        memcpy(&rate, &bits, sizeof(rate));
+        probe->sample_rate = (int) rate;
+        probe->channels = be32(entry.data + 40);
+        fixed = 64;
+    }
+    if (probe->sample_rate == 0) probe->sample_rate = t->timescale;
+
+    const char *codec = NULL;
+    Bytes esds;
+    switch (type) {
+    case MP4_TYPE('m','p','4','a'):
+        codec = "aac";
+        if (entry.count > fixed && mp4_find_box((Bytes){entry.data + fixed, entry.count - fixed}, MP4_TYPE('e','s','d','s'), &esds)) {
+            int object_type = mp4_esds_object_type(esds);
+            if (object_type == 0x69 || object_type == 0x6b) codec = "mp3";
+        }
+        break;
+    case MP4_TYPE('.','m','p','3'): codec = "mp3"; break;
+    case MP4_TYPE('a','c','-','3'): codec = "ac3"; break;
+    case MP4_TYPE('e','c','-','3'): codec = "eac3"; break;
+    case MP4_TYPE('O','p','u','s'): codec = "opus"; break;
+    case MP4_TYPE('f','L','a','C'): codec = "flac"; break;
+    case MP4_TYPE('s','o','w','t'): codec = "pcm_s16le"; break;
+    case MP4_TYPE('t','w','o','s'): codec = "pcm_s16be"; break;
+    }
+    if (codec != NULL) {
+        snprintf(probe->audio_codec, sizeof(probe->audio_codec), "%s", codec);
+    } else {
+        char fourcc[5] = {type >> 24, type >> 16, type >> 8, type, 0};
+        snprintf(probe->audio_codec, sizeof(probe->audio_codec), "%s", fourcc);
+    }
+}
+
+
+static size_t mp4_sample_count(const Mp4_Track *t) {
+    if (t->stsz.count < 12) return 0;
+    return be32(t->stsz.data + 8);
+}
+
+
+// Presentation time of the first sample: empty edits delay the track, the media time of the
+// first real edit cuts off its beginning (e.g. the B-frame delay). In the track timescale.
+static int64_t mp4_edit_shift(const Mp4_Track *t, uint32_t movie_timescale) {
+    uint32_t count;
+    if (t->elst.count < 1) return 0;
+    bool v1 = t->elst.data[0] == 1;
+    size_t entry_size = v1 ? 20 : 12;
+    if (!mp4_table(t->elst, 4, entry_size, &count)) return 0;
+    int64_t shift = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint8_t *e = t->elst.data + 8 + i*entry_size;
+        uint64_t segment = v1 ? be64(e) : be32(e);
+        int64_t media_time = v1 ? (int64_t) be64(e + 8) : (int32_t) be32(e + 4);
+        if (media_time == -1) {
+            if (movie_timescale > 0) shift += (int64_t)((double) segment * t->timescale / movie_timescale);
+            continue;
+        }
+        return shift - media_time;
+    }
+    return shift;
+}
+
+
+// Walks every sample through the time-to-sample, composition offset, sample-to-chunk and chunk
+// offset tables at once, and picks the sync samples.
+static bool mp4_keyframes(const Mp4_Track *t, uint32_t movie_timescale, size_t file_size, Keyframe_Index *index) {
+    uint32_t stts_count, ctts_count = 0, stss_count = 0, stsc_count, chunk_count, stsz_count = 0;
+    size_t sample_count = mp4_sample_count(t);
+    if (t->stsz.count < 12) return false;
+    uint32_t constant_size = be32(t->stsz.data + 4);
+    if (constant_size == 0 && !mp4_table(t->stsz, 8, 4, &stsz_count)) return false;
+    if (constant_size == 0 && stsz_count < sample_count) return false;
+    if (!mp4_table(t->stts, 4, 8, &stts_count)) return false;
+    if (t->ctts.count > 0 && !mp4_table(t->ctts, 4, 8, &ctts_count)) return false;
+    if (t->stss.count > 0 && !mp4_table(t->stss, 4, 4, &stss_count)) return false;
+    if (!mp4_table(t->stsc, 4, 12, &stsc_count) || stsc_count == 0) return false;
+    if (!mp4_table(t->stco, 4, t->co64 ? 8 : 4, &chunk_count)) return false;
+
+    int64_t shift = mp4_edit_shift(t, movie_timescale);
+    int64_t dts = 0;
+    uint32_t stts_at = 0, stts_left = stts_count > 0 ? be32(t->stts.data + 8) : 0;
+    uint32_t ctts_at = 0, ctts_left = ctts_count > 0 ? be32(t->ctts.data + 8) : 0;
+    uint32_t stss_at = 0, stsc_at = 0;
+    size_t sample = 0;
+    for (uint32_t chunk = 0; chunk < chunk_count && sample < sample_count; ++chunk) {
+        while (stsc_at + 1 < stsc_count && be32(t->stsc.data + 8 + (stsc_at + 1)*12) <= chunk + 1) stsc_at += 1;
+        uint32_t samples_per_chunk = be32(t->stsc.data + 8 + stsc_at*12 + 4);
+        uint64_t pos = t->co64 ? be64(t->stco.data + 8 + chunk*8) : be32(t->stco.data + 8 + chunk*4);
+        if (pos > file_size) return false;
+
+        for (uint32_t i = 0; i < samples_per_chunk && sample < sample_count; ++i, ++sample) {
+            while (stts_left == 0 && stts_at + 1 < stts_count) stts_left = be32(t->stts.data + 8 + (++stts_at)*8);
+            while (ctts_left == 0 && ctts_at + 1 < ctts_count) ctts_left = be32(t->ctts.data + 8 + (++ctts_at)*8);
+            int64_t offset = ctts_count > 0 ? (int32_t) be32(t->ctts.data + 8 + ctts_at*8 + 4) : 0;
+
+            bool key = stss_count == 0;
+            if (stss_at < stss_count && be32(t->stss.data + 8 + stss_at*4) == sample + 1) {
+                key = true;
+                stss_at += 1;
+            }
+            if (key) {
+                Keyframe kf = {
+                    .pts = container_us(dts + offset + shift, t->timescale),
+                    .pos = (int64_t) pos,
+                };
+                nob_da_append(index, kf);
+            }
+
+            pos += constant_size != 0 ? constant_size : be32(t->stsz.data + 12 + sample*4);
+            if (pos > file_size) return false; // a broken table, don't walk billions of samples
+            if (stts_count > 0) dts += be32(t->stts.data + 8 + stts_at*8 + 4);
+            if (stts_left > 0) stts_left -= 1;
+            if (ctts_left > 0) ctts_left -= 1;
+        }
+    }
+    return true;
+}
+
+
+static int compare_keyframes_pts(const void *a, const void *b) {
+    int64_t x = ((const Keyframe*) a)->pts;
+    int64_t y = ((const Keyframe*) b)->pts;
+    return (x > y) - (x < y);
+}
+
+
+static bool mp4_parse(Bytes file, Container_Info *info, bool want_keyframes) {
+    Bytes moov, mvhd, mvex;
+    if (!mp4_find_box(file, MP4_TYPE('m','o','o','v'), &moov)) return false;
+    // Fragmented files keep their samples in moof boxes all over the file.
+    if (mp4_find_box(moov, MP4_TYPE('m','v','e','x'), &mvex)) return false;
+
+    uint32_t movie_timescale = 0;
+    uint64_t movie_duration = 0;
+    if (mp4_find_box(moov, MP4_TYPE('m','v','h','d'), &mvhd)) mp4_timing(mvhd, &movie_timescale, &movie_duration);
+
+    Mp4_Track video = {0}, audio = {0}, track;
+    bool has_video = false, has_audio = false;
+    double longest = 0;
+    Bytes rest = moov;
+    Mp4_Box box;
+    while (mp4_next_box(&rest, &box)) {
+        if (box.type != MP4_TYPE('t','r','a','k') || !mp4_parse_track(box.body, &track)) continue;
+        double duration = (double) track.duration / track.timescale;
+        if (duration > longest) longest = duration;
+        if (track.handler == MP4_TYPE('v','i','d','e') && !has_video) {
+            video = track;
+            has_video = true;
+        } else if (track.handler == MP4_TYPE('s','o','u','n') && !has_audio) {
+            audio = track;
+            has_audio = true;
+        }
+    }
+    if (!has_video && !has_audio) return false;
+
+    Probe *probe = &info->probe;
+    probe->duration = movie_timescale > 0 && movie_duration > 0 ? (double) movie_duration / movie_timescale : longest;
+    if (has_video) {
+        mp4_parse_video(&video, probe);
+        info->video_samples = mp4_sample_count(&video);
+    }
+    if (has_audio) {
+        mp4_parse_audio(&audio, probe);
+        info->audio_samples = mp4_sample_count(&audio);
+    }
+
+    if (want_keyframes && has_video) {
+        if (!mp4_keyframes(&video, movie_timescale, file.count, &info->keyframes)) return false;
+        // Open GOPs and edit lists can reorder the keyframes a little.
+        qsort(info->keyframes.items, info->keyframes.count, sizeof(*info->keyframes.items), compare_keyframes_pts);
+    }
+    return true;
+}
+
+
+// AVI ////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+    uint32_t id;
+    Bytes body;
+    uint64_t offset; // of the chunk header in the file
+} Avi_Chunk;
+
+typedef struct {
+    uint32_t type; // vids, auds
+    uint32_t scale;
+    uint32_t rate;
+    uint32_t length;
+    Bytes strf;
+    Bytes indx;
+} Avi_Stream;
+
+typedef struct {
+    Avi_Stream streams[AVI_MAX_STREAMS];
+    size_t stream_count;
+    uint32_t total_frames; // dmlh, the avih count only covers the first RIFF
+    uint64_t movi_offset; // of the 'movi' list type, idx1 offsets are relative to it
+    Bytes idx1;
+} Avi_Header;
+
+
+// Chunks are padded to an even size. Lists are chunks whose body starts with the list type.
+static bool avi_next_chunk(Bytes *b, Bytes file, Avi_Chunk *chunk) {
+    if (b->count < 8) return false;
+    uint32_t size = le32(b->data + 4);
+    if (size > b->count - 8) size = b->count - 8; // truncated file, take what's there
+    chunk->id = le32(b->data);
+    chunk->body = (Bytes){b->data + 8, size};
+    chunk->offset = (uint64_t)(b->data - file.data);
+    size_t step = 8 + (size_t) size + (size & 1);
+    if (step > b->count) step = b->count;
+    b->data += step;
+    b->count -= step;
+    return true;
+}
+
+
+static void avi_parse_strl(Bytes strl, Bytes file, Avi_Header *header) {
+    if (header->stream_count >= AVI_MAX_STREAMS) return;
+    Avi_Stream *stream = &header->streams[header->stream_count++];
+    Avi_Chunk chunk;
+    while (avi_next_chunk(&strl, file, &chunk)) {
+        if (chunk.id == AVI_ID('s','t','r','h') && chunk.body.count >= 36) {
+            stream->type = le32(chunk.body.data);
+            stream->scale = le32(chunk.body.data + 20);
+            stream->rate = le32(chunk.body.data + 24);
+            stream->length = le32(chunk.body.data + 32);
+        } else if (chunk.id == AVI_ID('s','t','r','f')) {
+            stream->strf = chunk.body;
+        } else if (chunk.id == AVI_ID('i','n','d','x')) {
+            stream->indx = chunk.body;
+        }
+    }
+}
+
+
+static bool avi_parse_header(Bytes file, Avi_Header *header) {
+    if (file.count < 12 || le32(file.data) != AVI_ID('R','I','F','F') || le32(file.data + 8) != AVI_ID('A','V','I',' ')) return false;
+    uint32_t riff_size = le32(file.data + 4);
+    Bytes riff = {file.data + 12, riff_size - 4 < file.count - 12 ? riff_size - 4 : file.count - 12};
+
+    Avi_Chunk chunk;
+    while (avi_next_chunk(&riff, file, &chunk)) {
+        if (chunk.id == AVI_ID('i','d','x','1')) {
+            header->idx1 = chunk.body;
+            continue;
+        }
+        if (chunk.id != AVI_ID('L','I','S','T') || chunk.body.count < 4) continue;
+        uint32_t type = le32(chunk.body.data);
+        Bytes list = {chunk.body.data + 4, chunk.body.count - 4};
+        if (type == AVI_ID('m','o','v','i')) {
+            header->movi_offset = chunk.offset + 8;
+        } else if (type == AVI_ID('h','d','r','l')) {
+            Avi_Chunk item;
+            while (avi_next_chunk(&list, file, &item)) {
+                if (item.id != AVI_ID('L','I','S','T') || item.body.count < 4) continue;
+                uint32_t item_type = le32(item.body.data);
+                Bytes sub = {item.body.data + 4, item.body.count - 4};
+                if (item_type == AVI_ID('s','t','r','l')) {
+                    avi_parse_strl(sub, file, header);
+                } else if (item_type == AVI_ID('o','d','m','l')) {
+                    Avi_Chunk dmlh;
+                    while (avi_next_chunk(&sub, file, &dmlh)) {
+                        if (dmlh.id == AVI_ID('d','m','l','h') && dmlh.body.count >= 4) header->total_frames = le32(dmlh.body.data);
+                    }
+                }
+            }
+        }
+    }
+    return header->stream_count > 0;
+}
+
+
+// `00dc`, `01wb`...: the stream number in two digits and the kind of data.
+static bool avi_chunk_stream(uint32_t id, size_t stream) {
+    int d0 = id & 0xff, d1 = (id >> 8) & 0xff;
+    if (!isdigit(d0) || !isdigit(d1)) return false;
+    return (size_t)((d0 - '0')*10 + (d1 - '0')) == stream;
+}
+
+
+typedef struct {
+    size_t count; // chunks of the stream
+    Keyframe_Index *keyframes; // NULL when not wanted
+    uint64_t scale;
+    uint64_t rate;
+} Avi_Index_Walk;
+
+
+static void avi_index_entry(Avi_Index_Walk *walk, bool key, uint64_t pos) {
+    if (key && walk->keyframes != NULL && walk->rate > 0) {
+        Keyframe kf = {
+            .pts = (int64_t)((double) walk->count * walk->scale * 1e6 / walk->rate + 0.5),
+            .pos = (int64_t) pos,
+        };
+        nob_da_append(walk->keyframes, kf);
+    }
+    walk->count += 1;
+}
+
+
+// OpenDML: the super index in the stream header points to standard index chunks (ix00...) all
+// over the file. Entries point to the chunk data, the key flag is the clear high bit of the size.
+static bool avi_walk_odml(Bytes file, Bytes indx, Avi_Index_Walk *walk) {
+    if (indx.count < 24 || indx.data[3] != AVI_INDEX_OF_INDEXES) return false;
+    uint32_t entries = le32(indx.data + 4);
+    if ((uint64_t) entries * 16 > indx.count - 24) return false;
+    for (uint32_t i = 0; i < entries; ++i) {
+        uint64_t offset = le64(indx.data + 24 + i*16);
+        if (offset > file.count || file.count - offset < 32) return false;
+        const uint8_t *ix = file.data + offset;
+        uint32_t size = le32(ix + 4);
+        if (size > file.count - offset - 8 || size < 24 || ix[8 + 3] != AVI_INDEX_OF_CHUNKS) return false;
+        uint16_t longs_per_entry = le16(ix + 8);
+        uint32_t count = le32(ix + 8 + 4);
+        uint64_t base = le64(ix + 8 + 12);
+        size_t entry_size = (size_t) longs_per_entry * 4;
+        if (entry_size < 8 || (uint64_t) count * entry_size > size - 24) return false;
+        for (uint32_t j = 0; j < count; ++j) {
+            const uint8_t *e = ix + 8 + 24 + j*entry_size;
+            avi_index_entry(walk, (le32(e + 4) & 0x80000000u) == 0, base + le32(e) - 8);
+        }
+    }
+    return true;
+}
+
+
+// idx1: {ckid, flags, offset, size} per chunk of the first RIFF. The offsets are relative to the
+// movi list, except in the files that store them absolute.
+static bool avi_walk_idx1(Bytes idx1, uint64_t movi_offset, size_t stream, Avi_Index_Walk *walk) {
+    size_t entries = idx1.count / 16;
+    if (entries == 0) return false;
+    uint64_t base = le32(idx1.data + 8) >= movi_offset ? 0 : movi_offset;
+    for (size_t i = 0; i < entries; ++i) {
+        const uint8_t *e = idx1.data + i*16;
+        if (!avi_chunk_stream(le32(e), stream)) continue;
+        avi_index_entry(walk, (le32(e + 4) & AVIIF_KEYFRAME) != 0, base + le32(e + 8));
+    }
+    return true;
+}
+
+
+static bool avi_walk(Bytes file, const Avi_Header *header, size_t stream, Avi_Index_Walk *walk) {
+    if (header->streams[stream].indx.count > 0 && avi_walk_odml(file, header->streams[stream].indx, walk)) return true;
+    walk->count = 0;
+    if (walk->keyframes != NULL) walk->keyframes->count = 0;
+    return avi_walk_idx1(header->idx1, header->movi_offset, stream, walk);
+}
+
+
+static const char *avi_video_codec(uint32_t fourcc) {
+    char c[5] = {0};
+    for (int i = 0; i < 4; ++i) c[i] = toupper((fourcc >> (i*8)) & 0xff);
+    if (!strcmp(c, "H264") || !strcmp(c, "X264") || !strcmp(c, "AVC1") || !strcmp(c, "DAVC")) return "h264";
+    if (!strcmp(c, "HEVC") || !strcmp(c, "H265") || !strcmp(c, "HVC1")) return "hevc";
+    if (!strcmp(c, "XVID") || !strcmp(c, "DIVX") || !strcmp(c, "DX50") || !strcmp(c, "FMP4") || !strcmp(c, "MP4V")) return "mpeg4";
+    if (!strcmp(c, "DIV3") || !strcmp(c, "MP43")) return "msmpeg4v3";
+    if (!strcmp(c, "MJPG")) return "mjpeg";
+    return NULL;
+}
+
+
+static const char *avi_audio_codec(uint16_t format_tag, uint16_t bits) {
+    switch (format_tag) {
+    case 0x0001: return bits == 8 ? "pcm_u8" : bits == 24 ? "pcm_s24le" : "pcm_s16le";
+    case 0x0050: return "mp2";
+    case 0x0055: return "mp3";
+    case 0x00ff:
+    case 0x1610:
+    case 0x706d: return "aac";
+    case 0x0161: return "wmav2";
+    case 0x2000: return "ac3";
+    }
+    return NULL;
+}
+
+
+static bool avi_parse(Bytes file, Container_Info *info, bool want_keyframes) {
+    Avi_Header header = {0};
+    if (!avi_parse_header(file, &header)) return false;
+
+    Probe *probe = &info->probe;
+    bool has_video = false, has_audio = false;
+    for (size_t i = 0; i < header.stream_count; ++i) {
+        Avi_Stream *stream = &header.streams[i];
+        if (stream->type == AVI_ID('v','i','d','s') && !has_video) {
+            has_video = true;
+            // BITMAPINFOHEADER
+            if (stream->strf.count >= 20) {
+                probe->width = (int32_t) le32(stream->strf.data + 4);
+                int32_t height = (int32_t) le32(stream->strf.data + 8);
+                probe->height = height < 0 ? -height : height;
+                uint32_t fourcc = le32(stream->strf.data + 16);
+                const char *codec = avi_video_codec(fourcc);
+                if (codec != NULL) {
+                    snprintf(probe->video_codec, sizeof(probe->video_codec), "%s", codec);
+                    if (strcmp(codec, "h264") == 0 || strcmp(codec, "mpeg4") == 0) snprintf(probe->pix_fmt, sizeof(probe->pix_fmt), "yuv420p");
+                } else {
+                    char name[5] = {fourcc, fourcc >> 8, fourcc >> 16, fourcc >> 24, 0};
+                    for (int c = 0; c < 4; ++c) name[c] = tolower((unsigned char) name[c]);
+                    snprintf(probe->video_codec, sizeof(probe->video_codec), "%s", name);
+                }
+            }
+            container_frame_rate(probe->frame_rate, sizeof(probe->frame_rate), stream->rate, stream->scale);
+
+            Avi_Index_Walk walk = {
+                .keyframes = want_keyframes ? &info->keyframes : NULL,
+                .scale = stream->scale,
+                .rate = stream->rate,
+            };
+            if (!avi_walk(file, &header, i, &walk)) return false;
+            info->video_samples = walk.count;
+            size_t frames = walk.count;
+            if (header.total_frames > frames) frames = header.total_frames;
+            if (stream->length > frames) frames = stream->length;
+            if (stream->rate > 0) probe->duration = (double) frames * stream->scale / stream->rate;
+        } else if (stream->type == AVI_ID('a','u','d','s') && !has_audio) {
+            has_audio = true;
+            // WAVEFORMATEX
+            if (stream->strf.count >= 16) {
+                uint16_t format_tag = le16(stream->strf.data);
+                probe->channels = le16(stream->strf.data + 2);
+                probe->sample_rate = le32(stream->strf.data + 4);
+                const char *codec = avi_audio_codec(format_tag, le16(stream->strf.data + 14));
+                if (codec != NULL) {
+                    snprintf(probe->audio_codec, sizeof(probe->audio_codec), "%s", codec);
+                } else {
+                    snprintf(probe->audio_codec, sizeof(probe->audio_codec), "0x%04x", format_tag);
+                }
+            }
+            Avi_Index_Walk walk = {0};
+            if (avi_walk(file, &header, i, &walk)) info->audio_samples = walk.count;
+            if (probe->duration == 0 && stream->rate > 0) probe->duration = (double) stream->length * stream->scale / stream->rate;
+        }
+    }
+    return has_video || has_audio;
+}
+
+
+bool container_parse(const char *path, Container_Info *info, bool want_keyframes) {
+    memset(info, 0, sizeof(*info));
+    const char *ext = strrchr(path, '.');
+    if (ext == NULL) return false;
+    bool mp4 = strcasecmp(ext, ".mp4") == 0 || strcasecmp(ext, ".mov") == 0 || strcasecmp(ext, ".m4v") == 0 || strcasecmp(ext, ".m4a") == 0;
+    bool avi = strcasecmp(ext, ".avi") == 0;
+    if (!mp4 && !avi) return false;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    // Only the headers and indexes are read, which can be anywhere in the file.
+    madvise(map, st.st_size, MADV_RANDOM);
+
+    Bytes file = {map, (size_t) st.st_size};
+    bool ok = mp4 ? mp4_parse(file, info, want_keyframes) : avi_parse(file, info, want_keyframes);
+    munmap(map, st.st_size);
+
+    info->probe.size = (double) st.st_size;
+    info->probe.ok = ok && info->probe.duration > 0;
+    if (!info->probe.ok) container_info_free(info);
+    return info->probe.ok;
+}
+
+
+void container_info_free(Container_Info *info) {
+    nob_da_free(info->keyframes);
+    memset(info, 0, sizeof(*info));
+}
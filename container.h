@@ -0,0 +1,32 @@
+#ifndef CONTAINER_H_
+#define CONTAINER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "./keyframes.h"
+#include "./probe.h"
+
+// Reads the metadata of MP4/MOV and AVI files straight from the file, without spawning
+// ffprobe or decoding anything. The file is mmapped and only the index structures are touched:
+//   MP4/MOV: moov/trak/mdia (mdhd, hdlr) and the sample tables (stsd, stts, ctts, stss, stsz, stsc, stco/co64, elst)
+//   AVI:     hdrl (avih, strh, strf) and the OpenDML super/standard indexes, or idx1 for plain AVIs
+//
+// Codec names, profiles and pixel formats follow ffprobe's naming so the results are
+// interchangeable with probe_file_ffprobe().
+
+typedef struct {
+    Probe probe;
+    size_t video_samples; // frames in the first video stream
+    size_t audio_samples; // packets in the first audio stream
+    Keyframe_Index keyframes; // only when asked for
+} Container_Info;
+
+// Returns false for other containers and for files this parser doesn't understand (fragmented
+// MP4, AVIs without an index, truncated files...). The callers fall back to ffprobe then.
+// Safe to call from any thread.
+bool container_parse(const char *path, Container_Info *info, bool want_keyframes);
+
+void container_info_free(Container_Info *info);
+
+#endif // CONTAINER_H_
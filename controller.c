@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "./controller.h"
+
+#define CONTROLLER_SAMPLE_INTERVAL (1ull*NOB_NANOS_PER_SEC)
+// New jobs need a few seconds to ramp up before their effect on the machine is visible.
+#define CONTROLLER_COOLDOWN (3ull*NOB_NANOS_PER_SEC)
+#define CONTROLLER_CPU_UNDERUSED 0.85
+#define CONTROLLER_IOWAIT_HIGH 0.15
+// Part of the RAM that is kept free so the desktop doesn't start swapping.
+#define CONTROLLER_MEM_RESERVE_DIVISOR 10
+
+static bool controller_read_cpu(uint64_t *busy, uint64_t *iowait, uint64_t *total) {
+    FILE *f = fopen("/proc/stat", "r");
+    if (f == NULL) return false;
+    unsigned long long user, nice, system, idle, io, irq, softirq, steal;
+    int n = fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+                   &user, &nice, &system, &idle, &io, &irq, &softirq, &steal);
+    fclose(f);
+    if (n != 8) return false;
+
+    *busy = user + nice + system + irq + softirq + steal;
+    *iowait = io;
+    *total = *busy + idle + io;
+    return true;
+}
+
+
+static bool controller_read_meminfo(uint64_t *total, uint64_t *available) {
+    FILE *f = fopen("/proc/meminfo", "r");
+    if (f == NULL) return false;
+    char line[256];
+    int found = 0;
+    while (fgets(line, sizeof(line), f) != NULL && found < 2) {
+        unsigned long long kb;
+        if (sscanf(line, "MemTotal: %llu kB", &kb) == 1) { *total = kb*1024; found += 1; }
+        if (sscanf(line, "MemAvailable: %llu kB", &kb) == 1) { *available = kb*1024; found += 1; }
+    }
+    fclose(f);
+    return found == 2;
+}
+
+
+// utime+stime in clock ticks from /proc/<pid>/stat. The command name may contain spaces and
+// parentheses, so the fields are counted from the last ')'.
+static bool controller_read_proc_ticks(pid_t pid, uint64_t *ticks) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return false;
+    char buf[1024];
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+
+    char *p = strrchr(buf, ')');
+    if (p == NULL) return false;
+    unsigned long long utime, stime;
+    // state ppid pgrp session tty_nr tpgid flags minflt cminflt majflt cmajflt utime stime
+    if (sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2) return false;
+    *ticks = utime + stime;
+    return true;
+}
+
+
+static bool controller_read_proc_rss(pid_t pid, uint64_t *rss) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return false;
+    char line[256];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), f) != NULL) {
+        unsigned long long kb;
+        if (sscanf(line, "VmRSS: %llu kB", &kb) == 1) {
+            *rss = kb*1024;
+            found = true;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+
+static void controller_sample_jobs(Controller *controller, Jobs *jobs, double elapsed) {
+    static long ticks_per_sec = 0;
+    if (ticks_per_sec == 0) ticks_per_sec = sysconf(_SC_CLK_TCK);
+
+    uint64_t rss_sum = 0;
+    size_t rss_count = 0;
+    for (size_t i = 0; i < jobs->count; ++i) {
+        Job *job = &jobs->items[i];
+        if (job->state != JOB_RUNNING) continue;
+
+        uint64_t ticks;
+        if (controller_read_proc_ticks(job->pid, &ticks)) {
+            if (job->cpu_ticks > 0 && elapsed > 0) {
+                job->cpu_usage = (double)(ticks - job->cpu_ticks) / ticks_per_sec / elapsed;
+            }
+            job->cpu_ticks = ticks;
+        }
+        if (controller_read_proc_rss(job->pid, &job->rss)) {
+            rss_sum += job->rss;
+            rss_count += 1;
+        }
+    }
+    controller->avg_rss = rss_count > 0 ? rss_sum / rss_count : 0;
+}
+
+
+static void controller_decide(Controller *controller, Jobs *jobs, uint64_t now) {
+    size_t running = jobs_running_count(jobs);
+    size_t queued = 0;
+    for (size_t i = 0; i < jobs->count; ++i) {
+        if (jobs->items[i].state == JOB_QUEUED) queued += 1;
+    }
+
+    size_t max_target = thread_budget_total(&jobs->thread_budget);
+    uint64_t reserve = controller->mem_total / CONTROLLER_MEM_RESERVE_DIVISOR;
+    bool cooling_down = now - controller->last_change_at < CONTROLLER_COOLDOWN;
+    size_t target = controller->target;
+
+    if (controller->mem_available < reserve) {
+        if (target > 1) target -= 1;
+        snprintf(controller->decision, sizeof(controller->decision), "lowering: memory pressure, %.1fG available",
+                 controller->mem_available / 1e9);
+    } else if (controller->iowait > CONTROLLER_IOWAIT_HIGH) {
+        if (target > 1) target -= 1;
+        snprintf(controller->decision, sizeof(controller->decision), "lowering: iowait %d%%",
+                 (int)(controller->iowait*100));
+    } else if (queued == 0) {
+        snprintf(controller->decision, sizeof(controller->decision), "holding: nothing queued");
+    } else if (running < target) {
+        snprintf(controller->decision, sizeof(controller->decision), "holding: jobs are starting");
+    } else if (controller->cpu_usage >= CONTROLLER_CPU_UNDERUSED) {
+        snprintf(controller->decision, sizeof(controller->decision), "holding: cpu busy");
+    } else if (controller->mem_available < reserve + controller->avg_rss*2) {
+        snprintf(controller->decision, sizeof(controller->decision), "holding: not enough memory for another job");
+    } else if (target < max_target) {
+        target += 1;
+        snprintf(controller->decision, sizeof(controller->decision), "raising: cpu underused");
+    }
+
+    if (target == controller->target) return;
+    if (cooling_down) {
+        size_t n = strlen(controller->decision);
+        snprintf(controller->decision + n, sizeof(controller->decision) - n, ", waiting for the last change to settle");
+        return;
+    }
+
+    nob_log(NOB_INFO, "jobs at once: %zu -> %zu (%s)", controller->target, target, controller->decision);
+    controller->target = target;
+    controller->last_change_at = now;
+}
+
+
+void controller_update(Controller *controller, Jobs *jobs) {
+    if (controller->target == 0) {
+        controller->target = thread_budget_default_concurrency(&jobs->thread_budget);
+        snprintf(controller->decision, sizeof(controller->decision), "starting");
+    }
+    jobs->max_running = controller->target;
+
+    uint64_t now = nob_nanos_since_unspecified_epoch();
+    if (controller->last_sample_at > 0 && now - controller->last_sample_at < CONTROLLER_SAMPLE_INTERVAL) return;
+    double elapsed = (double)(now - controller->last_sample_at) / NOB_NANOS_PER_SEC;
+    bool first_sample = controller->last_sample_at == 0;
+    controller->last_sample_at = now;
+
+    uint64_t busy, iowait, total;
+    if (!controller_read_cpu(&busy, &iowait, &total)) return;
+    if (!controller_read_meminfo(&controller->mem_total, &controller->mem_available)) return;
+    if (total > controller->prev_total) {
+        double dt = total - controller->prev_total;
+        controller->cpu_usage = (busy - controller->prev_busy) / dt;
+        controller->iowait = (iowait - controller->prev_iowait) / dt;
+    }
+    controller->prev_busy = busy;
+    controller->prev_iowait = iowait;
+    controller->prev_total = total;
+
+    controller_sample_jobs(controller, jobs, first_sample ? 0 : elapsed);
+    if (first_sample) return;
+
+    controller_decide(controller, jobs, now);
+    jobs->max_running = controller->target;
+}
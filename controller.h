@@ -0,0 +1,37 @@
+#ifndef CONTROLLER_H_
+#define CONTROLLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./jobs.h"
+
+// Picks how many jobs run at once from what the machine is doing right now.
+// A fixed count is wrong for mixed batches: 720p encodes leave cores idle while 4K encodes swap.
+//
+// Once a second it samples /proc/stat, /proc/meminfo and /proc/<pid>/{stat,status} of the running
+// jobs. Concurrency goes up while the CPU is underused and the free memory can hold another job of
+// the average size, and goes down under memory pressure or high iowait. Running jobs are never
+// stopped, a lower target only holds back the queue.
+typedef struct {
+    size_t target; // jobs at once, 0 until the first sample
+
+    double cpu_usage; // 0..1 of the whole machine
+    double iowait; // 0..1 of the whole machine
+    uint64_t mem_total; // bytes
+    uint64_t mem_available; // bytes
+    uint64_t avg_rss; // bytes, of the running jobs
+
+    uint64_t prev_busy; // jiffies from /proc/stat
+    uint64_t prev_iowait;
+    uint64_t prev_total;
+    uint64_t last_sample_at; // nob_nanos_since_unspecified_epoch()
+    uint64_t last_change_at;
+
+    char decision[128]; // why the target is what it is, for the UI
+} Controller;
+
+// Samples when it's time, updates the per-job stats and `jobs->max_running`. Call once per frame.
+void controller_update(Controller *controller, Jobs *jobs);
+
+#endif // CONTROLLER_H_
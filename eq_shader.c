@@ -0,0 +1,80 @@
+#include <stdio.h>
+
+#include "./eq_shader.h"
+#include "./thirdparty/raylib/src/rlgl.h"
+
+// ffmpeg's eq works on YUV: luma goes through contrast, brightness and gamma, chroma is scaled
+// by the saturation. BT.601 like the swscale default for SD and most phone footage.
+static const char *EQ_SHADER_BODY =
+    "IN vec2 fragTexCoord;\n"
+    "IN vec4 fragColor;\n"
+    "uniform sampler2D texture0;\n"
+    "uniform vec4 colDiffuse;\n"
+    "uniform vec4 eq; // brightness, contrast, saturation, gamma\n"
+    "void main() {\n"
+    "    vec4 texel = TEXTURE(texture0, fragTexCoord)*colDiffuse*fragColor;\n"
+    "    float y = dot(texel.rgb, vec3(0.299, 0.587, 0.114));\n"
+    "    float u = dot(texel.rgb, vec3(-0.168736, -0.331264, 0.5));\n"
+    "    float v = dot(texel.rgb, vec3(0.5, -0.418688, -0.081312));\n"
+    "    y = eq.y*(y - 0.5) + 0.5 + eq.x;\n"
+    "    y = y > 0.0 ? pow(y, 1.0/eq.w) : 0.0;\n"
+    "    u *= eq.z;\n"
+    "    v *= eq.z;\n"
+    "    vec3 rgb = vec3(y + 1.402*v, y - 0.344136*u - 0.714136*v, y + 1.772*u);\n"
+    "    FRAG_COLOR = vec4(clamp(rgb, 0.0, 1.0), texel.a);\n"
+    "}\n";
+
+
+bool eq_shader_load(Eq_Shader *eq) {
+    const char *header;
+    switch (rlGetVersion()) {
+    case RL_OPENGL_33:
+    case RL_OPENGL_43:
+        header = "#version 330\n#define IN in\n#define TEXTURE texture\nout vec4 finalColor;\n#define FRAG_COLOR finalColor\n";
+        break;
+    case RL_OPENGL_21:
+        header = "#version 120\n#define IN varying\n#define TEXTURE texture2D\n#define FRAG_COLOR gl_FragColor\n";
+        break;
+    case RL_OPENGL_ES_20:
+    case RL_OPENGL_ES_30:
+        header = "#version 100\nprecision mediump float;\n#define IN varying\n#define TEXTURE texture2D\n#define FRAG_COLOR gl_FragColor\n";
+        break;
+    default:
+        TraceLog(LOG_WARNING, "EQ: no shaders on this OpenGL version, the preview is drawn without the color settings");
+        return false;
+    }
+
+    char source[2048];
+    snprintf(source, sizeof(source), "%s%s", header, EQ_SHADER_BODY);
+    eq->shader = LoadShaderFromMemory(NULL, source);
+    // raylib falls back to its default shader when ours doesn't compile.
+    eq->loaded = eq->shader.id != rlGetShaderIdDefault();
+    if (!eq->loaded) {
+        TraceLog(LOG_WARNING, "EQ: shader didn't compile, the preview is drawn without the color settings");
+        return false;
+    }
+    eq->eq_loc = GetShaderLocation(eq->shader, "eq");
+    return true;
+}
+
+
+void eq_shader_begin(Eq_Shader *eq, FfmpegParams params) {
+    eq->active = eq->loaded && ffmpeg_params_colored(params);
+    if (!eq->active) return;
+    FfmpegEq values = ffmpeg_eq(params);
+    float uniform[4] = {values.brightness, values.contrast, values.saturation, values.gamma};
+    SetShaderValue(eq->shader, eq->eq_loc, uniform, SHADER_UNIFORM_VEC4);
+    BeginShaderMode(eq->shader);
+}
+
+
+void eq_shader_end(Eq_Shader *eq) {
+    if (eq->active) EndShaderMode();
+    eq->active = false;
+}
+
+
+void eq_shader_unload(Eq_Shader *eq) {
+    if (eq->loaded) UnloadShader(eq->shader);
+    eq->loaded = false;
+}
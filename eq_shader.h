@@ -0,0 +1,34 @@
+#ifndef EQ_SHADER_H_
+#define EQ_SHADER_H_
+
+#include <stdbool.h>
+
+#include "./ffmpeg.h"
+#include "./thirdparty/raylib/src/raylib.h"
+
+// The color settings applied to the preview on the GPU with the curves of ffmpeg's eq filter, so
+// moving a color slider costs one uniform update per frame instead of an ffmpeg render. The encode
+// gets the real eq filter, see ffmpeg_video_filter().
+//
+// The shader is written for the GLSL of whatever context raylib got (330, 120 or 100 on GLES2)
+// and sticks to what Mesa's software rasterizers accept: float literals only, no pow() of
+// negative numbers.
+
+typedef struct {
+    Shader shader;
+    int eq_loc;
+    bool loaded;
+    bool active;
+} Eq_Shader;
+
+// Call after InitWindow(). When the shader doesn't compile the preview is just drawn without it.
+bool eq_shader_load(Eq_Shader *eq);
+
+// Draws everything until eq_shader_end() with the color settings of `params`. Does nothing when
+// they are neutral.
+void eq_shader_begin(Eq_Shader *eq, FfmpegParams params);
+void eq_shader_end(Eq_Shader *eq);
+
+void eq_shader_unload(Eq_Shader *eq);
+
+#endif // EQ_SHADER_H_
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "./ffmpeg.h"
+#include "./formats.h"
+
+void ffmpeg_params_print(FfmpegParams *params) {
+    printf("[DEBUG] input_path: \"%s\"\n", (*params).input_path);
+    printf("[DEBUG] output_path: \"%s\"\n", (*params).output_path);
+    printf("[DEBUG] crf: %d\n", (*params).crf);
+    printf("[DEBUG] crop: [%d, %d, %d, %d]",
+           (*params).crop_top,
+           (*params).crop_bottom,
+           (*params).crop_left,
+           (*params).crop_right);
+    printf("\n");
+    printf("[DEBUG] eq: [%d, %d, %d, %d]\n",
+           (*params).brightness,
+           (*params).contrast,
+           (*params).saturation,
+           (*params).gamma);
+    printf("[DEBUG] rotation: %d, audio offset: %.3fs\n", (*params).rotation, (*params).audio_offset);
+    printf("[DEBUG] threads: %d\n", (*params).threads);
+    printf("[DEBUG] screen recording: %s\n", (*params).screen_recording ? "yes" : "no");
+    printf("[DEBUG] trim: [%.3f, %.3f]%s%s\n", (*params).trim_in, (*params).trim_out, (*params).stream_copy ? " copy" : "", (*params).remux ? " remux" : "");
+    printf("[DEBUG] faststart: %s\n", (*params).faststart ? "yes" : "no");
+}
+
+
+FfmpegEq ffmpeg_eq(FfmpegParams params) {
+    FfmpegEq eq = {
+        .brightness = params.brightness/100.0,
+        .contrast = 1 + params.contrast/100.0,
+        .saturation = 1 + params.saturation/100.0,
+        .gamma = 1 + params.gamma/100.0,
+    };
+    if (eq.brightness < -1) eq.brightness = -1;
+    if (eq.brightness > 1) eq.brightness = 1;
+    if (eq.contrast < 0) eq.contrast = 0;
+    if (eq.saturation < 0) eq.saturation = 0;
+    if (eq.saturation > 3) eq.saturation = 3;
+    if (eq.gamma < 0.1) eq.gamma = 0.1;
+    if (eq.gamma > 10) eq.gamma = 10;
+    return eq;
+}
+
+
+bool ffmpeg_params_colored(FfmpegParams params) {
+    return (params.brightness | params.contrast | params.saturation | params.gamma) != 0;
+}
+
+
+bool ffmpeg_params_filtered(FfmpegParams params) {
+    return (params.crop_top | params.crop_bottom | params.crop_left | params.crop_right) != 0
+        || ffmpeg_params_colored(params)
+        || params.volume != 100
+        || params.audio_channels != NO_MODIFICATION
+        || params.screen_recording;
+}
+
+
+bool ffmpeg_params_metadata_edited(FfmpegParams params) {
+    return params.rotation % 360 != 0 || params.audio_offset != 0;
+}
+
+
+void ffmpeg_params_profile(FfmpegParams params, char *profile, size_t size) {
+    const char *ext = strrchr(params.output_path, '.');
+    if (params.stream_copy) {
+        snprintf(profile, size, "%s copy", ext != NULL ? ext + 1 : "-");
+    } else {
+        snprintf(profile, size, "%s crf=%d%s", ext != NULL ? ext + 1 : "-", params.crf, params.screen_recording ? " screen" : "");
+    }
+}
+
+
+const char *ffmpeg_video_filter(FfmpegParams params) {
+    const Format *format = format_find(params.output_path);
+    if (format != NULL && format->audio_only) return NULL;
+    const char *filter = NULL;
+    if ((params.crop_top | params.crop_bottom | params.crop_left | params.crop_right) != 0) {
+        filter = nob_temp_sprintf(
+                "crop=in_w-%d:in_h-%d:%d:%d",
+                params.crop_left + params.crop_right,
+                params.crop_top + params.crop_bottom,
+                params.crop_left,
+                params.crop_top
+                );
+    }
+    if (ffmpeg_params_colored(params)) {
+        FfmpegEq values = ffmpeg_eq(params);
+        const char *eq = nob_temp_sprintf("eq=brightness=%.2f:contrast=%.2f:saturation=%.2f:gamma=%.2f",
+                                          values.brightness, values.contrast, values.saturation, values.gamma);
+        filter = filter != NULL ? nob_temp_sprintf("%s,%s", filter, eq) : eq;
+    }
+    // ffmpeg has turned the frames by the input rotation already, this is on top of it.
+    const char *turn = NULL;
+    switch ((params.rotation % 360 + 360) % 360) {
+    case 90:  turn = "transpose=clock"; break;
+    case 180: turn = "hflip,vflip"; break;
+    case 270: turn = "transpose=cclock"; break;
+    }
+    if (turn != NULL) filter = filter != NULL ? nob_temp_sprintf("%s,%s", filter, turn) : turn;
+    // Last, so it compares the frames as they are going to be encoded.
+    if (params.screen_recording) filter = filter != NULL ? nob_temp_sprintf("%s,mpdecimate", filter) : "mpdecimate";
+    return filter;
+}
+
+
+const char *ffmpeg_audio_filter(FfmpegParams params) {
+    char audio[255] = {0};
+    if (params.audio_channels == CLONE_LEFT) {
+        char* option = "pan=stereo|FL=FL|FR=FL";
+        snprintf(audio, strlen(option) + 1, "%s", option);
+    }
+    if (params.audio_channels == CLONE_RIGHT) {
+        char* option ="pan=stereo|FL=FR|FR=FR";
+        snprintf(audio, strlen(option) + 1, "%s", option);
+    }
+
+    if (strlen(audio) > 0) snprintf(audio + strlen(audio), 2, ",");
+    snprintf(audio + strlen(audio), strlen("volume=")+5, "volume=%.2f", (float)params.volume/100);
+
+    return strlen(audio) > 0 ? nob_temp_strdup(audio) : NULL;
+}
+
+
+void ffmpeg_append_encoder_options(Nob_Cmd *cmd, FfmpegParams params) {
+    const char *threads = nob_temp_sprintf("%d", params.threads);
+    const Format *format = format_find(params.output_path);
+    bool vpx = format != NULL && format->vpx;
+    // The muxer picks the encoder: libx264 for the ISO BMFF and Matroska outputs, mpeg4 for AVI.
+    bool x264 = format == NULL || (!vpx && !format->audio_only && strcmp(format->ext, ".avi") != 0);
+    nob_cmd_append(cmd, "-crf", nob_temp_sprintf("%d", params.crf));
+    if (params.threads > 0) {
+        nob_cmd_append(cmd, "-threads", threads);
+        nob_cmd_append(cmd, "-filter_threads", threads);
+        if (x264) nob_cmd_append(cmd, "-x264-params", nob_temp_sprintf("threads=%d", params.threads));
+        // libvpx splits the frames into tile columns for -threads, rows only run in parallel with this.
+        if (vpx) nob_cmd_append(cmd, "-row-mt", "1");
+    }
+    if (vpx) nob_cmd_append(cmd, "-b:v", "0");
+    if (params.screen_recording) {
+        // Without vfr the muxer would duplicate the dropped frames right back in.
+        nob_cmd_append(cmd, "-fps_mode", "vfr");
+        if (vpx) nob_cmd_append(cmd, "-tune-content", "screen");
+        if (x264) nob_cmd_append(cmd, "-tune", "animation");
+    }
+}
+
+
+void ffmpeg_append_output_options(Nob_Cmd *cmd, FfmpegParams params) {
+    const Format *format = format_find(params.output_path);
+    if (format == NULL) return;
+    if (format->audio_only) nob_cmd_append(cmd, "-vn");
+    if (params.faststart && format->faststart) nob_cmd_append(cmd, "-movflags", "+faststart");
+}
+
+
+// The input, and with an audio offset the input a second time for the audio with its timestamps
+// shifted. Returns the audio stream to map.
+static const char *ffmpeg_append_inputs(Nob_Cmd *cmd, FfmpegParams params) {
+    // Input seeking: demuxes from the keyframe before trim_in. With -c copy the output starts
+    // at that keyframe, otherwise the frames before trim_in are decoded and dropped.
+    const char *seek = params.trim_in > 0 ? nob_temp_sprintf("%.6f", params.trim_in) : NULL;
+    if (seek != NULL) nob_cmd_append(cmd, "-ss", seek);
+    if (params.stream_copy && params.rotation % 360 != 0) {
+        // Replaces the display matrix of the input, counter-clockwise.
+        int rotation = (params.input_rotation + params.rotation) % 360;
+        nob_cmd_append(cmd, "-display_rotation:v:0", nob_temp_sprintf("%d", (360 - rotation) % 360));
+    }
+    if (params.audio_offset < 0) nob_cmd_append(cmd, "-itsoffset", nob_temp_sprintf("%.6f", -params.audio_offset));
+    nob_cmd_append(cmd, "-i", params.input_path);
+    if (params.audio_offset == 0) return "0:a:0?";
+
+    if (seek != NULL) nob_cmd_append(cmd, "-ss", seek);
+    if (params.audio_offset > 0) nob_cmd_append(cmd, "-itsoffset", nob_temp_sprintf("%.6f", params.audio_offset));
+    nob_cmd_append(cmd, "-i", params.input_path);
+    return "1:a:0?";
+}
+
+
+void ffmpeg_build_cmd(Nob_Cmd *cmd, FfmpegParams params) {
+    const char *threads = nob_temp_sprintf("%d", params.threads);
+
+    nob_cmd_append(cmd, "ffmpeg", "-y", "-nostats");
+    if (params.stream_copy) {
+        const char *audio = ffmpeg_append_inputs(cmd, params);
+        if (params.audio_offset != 0) nob_cmd_append(cmd, "-map", "0:v:0?", "-map", audio);
+        if (params.trim_out > 0) nob_cmd_append(cmd, "-t", nob_temp_sprintf("%.6f", params.trim_out - params.trim_in));
+        nob_cmd_append(cmd, "-c", "copy", "-avoid_negative_ts", "make_zero");
+        ffmpeg_append_output_options(cmd, params);
+        nob_cmd_append(cmd, "-progress", "pipe:1");
+        nob_cmd_append(cmd, params.output_path);
+        return;
+    }
+
+    if (params.threads > 0) nob_cmd_append(cmd, "-threads", threads);
+    const char *audio_stream = ffmpeg_append_inputs(cmd, params);
+    if (params.trim_out > 0) nob_cmd_append(cmd, "-t", nob_temp_sprintf("%.6f", params.trim_out - params.trim_in));
+    ffmpeg_append_encoder_options(cmd, params);
+
+    const char *video = ffmpeg_video_filter(params);
+    if (params.monitor) {
+        // The monitor gets a branch of the same filter graph, so it costs a split, an fps and a
+        // tiny scale on top of the encode, but no decode of its own.
+        nob_cmd_append(cmd, "-filter_complex", nob_temp_sprintf(
+            "[0:v]%s,split[encode][tap];"
+            "[tap]fps=%d,scale=%d:%d:force_original_aspect_ratio=decrease,pad=%d:%d:-1:-1,format=rgba[monitor]",
+            video != NULL ? video : "null",
+            FFMPEG_MONITOR_FPS,
+            FFMPEG_MONITOR_WIDTH, FFMPEG_MONITOR_HEIGHT,
+            FFMPEG_MONITOR_WIDTH, FFMPEG_MONITOR_HEIGHT));
+        nob_cmd_append(cmd, "-map", "[encode]", "-map", audio_stream);
+    } else {
+        if (params.audio_offset != 0) nob_cmd_append(cmd, "-map", "0:v:0?", "-map", audio_stream);
+        if (video != NULL) nob_cmd_append(cmd, "-vf", video);
+    }
+    const char *audio = ffmpeg_audio_filter(params);
+    if (audio != NULL) nob_cmd_append(cmd, "-af", audio);
+    ffmpeg_append_output_options(cmd, params);
+
+    nob_cmd_append(cmd, "-progress", "pipe:1");
+    nob_cmd_append(cmd, params.output_path);
+
+    if (params.monitor) {
+        nob_cmd_append(cmd, "-map", "[monitor]");
+        if (params.trim_out > 0) nob_cmd_append(cmd, "-t", nob_temp_sprintf("%.6f", params.trim_out - params.trim_in));
+        nob_cmd_append(cmd, "-f", "rawvideo", nob_temp_sprintf("pipe:%d", FFMPEG_MONITOR_FD));
+    }
+}
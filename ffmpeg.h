@@ -0,0 +1,113 @@
+#ifndef FFMPEG_H_
+#define FFMPEG_H_
+
+#include "./thirdparty/nob.h"
+
+// Live monitor of an encode: FFMPEG_MONITOR_FPS frames per second of the filtered video,
+// letterboxed into FFMPEG_MONITOR_WIDTH x FFMPEG_MONITOR_HEIGHT RGBA and written raw to
+// FFMPEG_MONITOR_FD of the ffmpeg process.
+#define FFMPEG_MONITOR_FD 3
+#define FFMPEG_MONITOR_FPS 1
+#define FFMPEG_MONITOR_WIDTH 320
+#define FFMPEG_MONITOR_HEIGHT 180
+#define FFMPEG_MONITOR_FRAME_SIZE (FFMPEG_MONITOR_WIDTH*FFMPEG_MONITOR_HEIGHT*4)
+
+typedef enum {
+    NO_MODIFICATION = 1,
+    CLONE_LEFT,
+    CLONE_RIGHT,
+    AUDIO_CHANNELS_LAST,
+} AudioChannels;
+
+typedef struct {
+    char* input_path;
+    char* output_path;
+    int crf;
+    int crop_top;
+    int crop_bottom;
+    int crop_left;
+    int crop_right;
+    int volume;
+    AudioChannels audio_channels;
+    // Color settings for the eq filter, in percent off the neutral value so a zeroed struct
+    // leaves the picture alone: brightness -100..100 is eq's -1..1, the others are eq's 1 + x/100.
+    int brightness;
+    int contrast;
+    int saturation;
+    int gamma;
+    // Metadata edits, see ffmpeg_params_metadata_edited(). A stream copy writes the rotation to the
+    // display matrix and shifts the audio with -itsoffset, an encode turns the pixels instead.
+    int rotation; // degrees clockwise on top of how players show the input: 0, 90, 180 or 270
+    int input_rotation; // degrees clockwise players already turn the input by, from the probe
+    double audio_offset; // seconds the audio is moved later against the video, negative moves it earlier
+    int threads; // decoder, filter graph and encoder threads, 0 lets ffmpeg decide
+    double trim_in; // seconds
+    double trim_out; // seconds, 0 means the end of the input
+    double dead_air; // seconds of black or silence the auto-trim took off the ends, only for show
+    bool stream_copy; // -c copy, everything above that needs a re-encode is ignored
+    // Only the container changes, as a stream copy of the whole input. The job fails instead of
+    // encoding when the codecs don't fit the container of output_path.
+    bool remux;
+    bool faststart; // moves the index of MP4/MOV/M4A outputs to the front, so playback can start before it's all read
+    // Splits the decoded and filtered frames to the live monitor as well, see FFMPEG_MONITOR_FD.
+    // Stream copies have no frames to show and go without.
+    bool monitor;
+    // Screen recording profile: mpdecimate drops the frames that barely differ from the last one
+    // kept and the output gets a variable frame rate, so a mostly static capture costs the encoder
+    // only the frames where something moves. Tuned for flat synthetic content.
+    bool screen_recording;
+    // Smart render of the trim: only [trim_in, smart_copy_from) and [smart_copy_to, trim_out) are
+    // re-encoded, the keyframe-aligned middle is copied. smart_copy_to is 0 when the copy goes to the end.
+    bool smart_render;
+    double smart_copy_from;
+    double smart_copy_to;
+    // Joins these inputs in order instead of encoding input_path alone, which is the first of them.
+    // The trim doesn't apply to joins.
+    char **concat_paths;
+    size_t concat_count;
+    bool concat_demuxer; // the parts match and are read as one input, see concat.h
+} FfmpegParams;
+
+typedef struct {
+    double brightness;
+    double contrast;
+    double saturation;
+    double gamma;
+} FfmpegEq;
+
+void ffmpeg_params_print(FfmpegParams *params);
+
+// Values of the eq filter for the color settings, clamped to what it accepts.
+FfmpegEq ffmpeg_eq(FfmpegParams params);
+bool ffmpeg_params_colored(FfmpegParams params);
+
+// True when the crop, color, audio or screen recording settings need a filter graph, which rules
+// out a stream copy.
+bool ffmpeg_params_filtered(FfmpegParams params);
+
+// True when the rotation or the audio offset is set. Those alone don't need an encode.
+bool ffmpeg_params_metadata_edited(FfmpegParams params);
+
+// Short key of the settings that decide how fast an encode runs, e.g. "mp4 crf=28" or "mp4 copy".
+// The screen recording profile encodes far fewer frames and gets " screen" appended.
+void ffmpeg_params_profile(FfmpegParams params, char *profile, size_t size);
+
+// Filter chains of the crop, color, rotation, decimation and audio settings, NULL when there is
+// nothing to do or the output has no video. Allocated in the temporary storage.
+const char *ffmpeg_video_filter(FfmpegParams params);
+const char *ffmpeg_audio_filter(FfmpegParams params);
+
+// -crf, the encoder thread options and the tune and frame rate mode of the screen recording profile.
+void ffmpeg_append_encoder_options(Nob_Cmd *cmd, FfmpegParams params);
+
+// What the container of the output path needs: -vn for audio-only ones, -movflags for faststart.
+// Goes right before the output path.
+void ffmpeg_append_output_options(Nob_Cmd *cmd, FfmpegParams params);
+
+// Appends the full ffmpeg invocation for `params` to `cmd`.
+// Progress is reported as `key=value` lines on stdout (`-progress pipe:1`).
+// Stdin stays interactive, so writing "q" to it stops the encode gracefully.
+// With `params.monitor` the process expects FFMPEG_MONITOR_FD to be open for writing.
+void ffmpeg_build_cmd(Nob_Cmd *cmd, FfmpegParams params);
+
+#endif // FFMPEG_H_
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "./formats.h"
+
+const Format formats[] = {
+    {
+        .ext = ".mp4",
+        .video_codecs = "h264 hevc av1 vp9 mpeg4",
+        .audio_codecs = "aac mp3 opus flac alac ac3 eac3",
+        .faststart = true,
+    },
+    {
+        .ext = ".avi",
+        .video_codecs = "mpeg4 h264 mjpeg msmpeg4v3",
+        .audio_codecs = "mp3 mp2 aac ac3 pcm_s16le pcm_u8",
+    },
+    {
+        .ext = ".mkv",
+    },
+    {
+        .ext = ".mov",
+        .video_codecs = "h264 hevc av1 mpeg4 mjpeg prores",
+        .audio_codecs = "aac mp3 alac ac3 eac3 flac pcm_s16le pcm_s16be pcm_s24le",
+        .faststart = true,
+    },
+    {
+        .ext = ".webm",
+        .video_codecs = "vp8 vp9 av1",
+        .audio_codecs = "vorbis opus",
+        .vpx = true,
+    },
+    {
+        .ext = ".m4a",
+        .audio_codecs = "aac alac",
+        .audio_only = true,
+        .faststart = true,
+    },
+};
+const size_t formats_count = sizeof(formats)/sizeof(formats[0]);
+
+
+const Format *format_find(const char *path) {
+    const char *dot = strrchr(path, '.');
+    if (dot == NULL || strchr(dot, '/') != NULL) return NULL;
+    for (size_t i = 0; i < formats_count; ++i) {
+        if (strcasecmp(dot, formats[i].ext) == 0) return &formats[i];
+    }
+    return NULL;
+}
+
+
+static bool format_has_codec(const char *codecs, const char *codec) {
+    if (codecs == NULL) return true;
+    size_t n = strlen(codec);
+    while (*codecs != '\0') {
+        size_t len = strcspn(codecs, " ");
+        if (len == n && strncmp(codecs, codec, n) == 0) return true;
+        codecs += len;
+        while (*codecs == ' ') codecs += 1;
+    }
+    return false;
+}
+
+
+bool format_can_copy(const Format *format, const Probe *probe, char *reason, size_t size) {
+    if (probe->video_codec[0] != '\0' && !format->audio_only && !format_has_codec(format->video_codecs, probe->video_codec)) {
+        snprintf(reason, size, "%s can't hold %s video", format->ext, probe->video_codec);
+        return false;
+    }
+    if (probe->audio_codec[0] != '\0' && !format_has_codec(format->audio_codecs, probe->audio_codec)) {
+        snprintf(reason, size, "%s can't hold %s audio", format->ext, probe->audio_codec);
+        return false;
+    }
+    if (format->audio_only && probe->audio_codec[0] == '\0') {
+        snprintf(reason, size, "%s needs audio and the input has none", format->ext);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef FORMATS_H_
+#define FORMATS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "./probe.h"
+
+// The containers we read and write, picked by the extension of the path, and which codecs each
+// of them can take as they are. A stream copy into a container that can't hold the codecs of the
+// input fails in the muxer, so the jobs check before and encode instead.
+
+typedef struct {
+    const char *ext; // with the dot, compared case-insensitively
+    // Space-separated codec names as ffprobe reports them, NULL takes anything.
+    const char *video_codecs;
+    const char *audio_codecs;
+    bool audio_only; // the video of the input is dropped
+    bool faststart; // ISO BMFF, the index can be moved in front of the media data
+    bool vpx; // encodes with libvpx: -crf needs -b:v 0 and the x264 tunes don't exist
+} Format;
+
+extern const Format formats[];
+extern const size_t formats_count;
+
+// NULL when the extension of `path` isn't one of ours.
+const Format *format_find(const char *path);
+
+// True when every stream of `probe` that ends up in `format` can be copied into it. Otherwise
+// `reason` says which codec doesn't fit.
+bool format_can_copy(const Format *format, const Probe *probe, char *reason, size_t size);
+
+#endif // FORMATS_H_
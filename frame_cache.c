@@ -0,0 +1,168 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./cache.h"
+#include "./frame_cache.h"
+#include "./thirdparty/nob.h"
+#include "./thirdparty/raylib/src/external/qoi.h"
+
+typedef struct {
+    char name[32];
+    struct timespec used;
+    long long size;
+} Frame_Cache_Entry;
+
+typedef struct {
+    Frame_Cache_Entry *items;
+    size_t count;
+    size_t capacity;
+} Frame_Cache_Entries;
+
+static struct {
+    pthread_mutex_t lock;
+    bool counted;
+    long long bytes; // in the directory, counted once and then kept up to date by the stores
+} frame_cache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+
+static bool frame_cache_dir(char *dir, size_t size) {
+    if (!cache_path(dir, size, "frames")) return false;
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        nob_log(NOB_ERROR, "could not create directory %s: %s", dir, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+
+// The key of the input, the millisecond of the frame and the variant.
+static bool frame_cache_file(char *file, size_t size, const char *path, double time, const char *variant) {
+    struct stat st;
+    if (stat(path, &st) < 0) return false;
+    uint64_t hash = cache_input_key(path, &st);
+    hash = cache_hash_u64(hash, (uint64_t) llround(time*1000));
+    hash = cache_hash_bytes(hash, variant, strlen(variant));
+
+    char dir[PATH_MAX];
+    if (!frame_cache_dir(dir, sizeof(dir))) return false;
+    int written = snprintf(file, size, "%s/%016" PRIx64 ".qoi", dir, hash);
+    return written > 0 && (size_t) written < size;
+}
+
+
+bool frame_cache_load(const char *path, double time, const char *variant, Image *image) {
+    char file[PATH_MAX];
+    if (!frame_cache_file(file, sizeof(file), path, time, variant)) return false;
+    int fd = open(file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false; // not cached
+
+    bool result = false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            qoi_desc desc;
+            void *pixels = qoi_decode(data, (int) st.st_size, &desc, 4);
+            munmap(data, st.st_size);
+            if (pixels != NULL) {
+                *image = (Image){pixels, desc.width, desc.height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+                futimens(fd, NULL); // used just now
+                result = true;
+            }
+        }
+    }
+    close(fd);
+    return result;
+}
+
+
+static int frame_cache_compare_used(const void *a, const void *b) {
+    const struct timespec *x = &((const Frame_Cache_Entry*) a)->used;
+    const struct timespec *y = &((const Frame_Cache_Entry*) b)->used;
+    if (x->tv_sec != y->tv_sec) return (x->tv_sec > y->tv_sec) - (x->tv_sec < y->tv_sec);
+    return (x->tv_nsec > y->tv_nsec) - (x->tv_nsec < y->tv_nsec);
+}
+
+
+// Lists the frames and, when `evict` is set, deletes the least recently used ones until the
+// directory is down to three quarters of the limit, so it isn't scanned again on the next store.
+// Returns the bytes left. Called with the lock held.
+static long long frame_cache_scan(const char *dir, bool evict) {
+    DIR *d = opendir(dir);
+    if (d == NULL) return 0;
+    Frame_Cache_Entries entries = {0};
+    long long bytes = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        const char *dot = strrchr(ent->d_name, '.');
+        if (dot == NULL || strcmp(dot, ".qoi") != 0 || strlen(ent->d_name) >= sizeof(entries.items->name)) continue;
+        struct stat st;
+        if (fstatat(dirfd(d), ent->d_name, &st, 0) < 0) continue;
+        Frame_Cache_Entry entry = {.used = st.st_mtim, .size = st.st_size};
+        strcpy(entry.name, ent->d_name);
+        nob_da_append(&entries, entry);
+        bytes += st.st_size;
+    }
+
+    if (evict && bytes > FRAME_CACHE_MAX_BYTES) {
+        qsort(entries.items, entries.count, sizeof(*entries.items), frame_cache_compare_used);
+        size_t evicted = 0;
+        for (size_t i = 0; i < entries.count && bytes > FRAME_CACHE_MAX_BYTES/4*3; ++i) {
+            if (unlinkat(dirfd(d), entries.items[i].name, 0) < 0) continue;
+            bytes -= entries.items[i].size;
+            evicted += 1;
+        }
+        nob_log(NOB_INFO, "evicted %zu preview frames, %lldM left", evicted, bytes / (1024*1024));
+    }
+    closedir(d);
+    nob_da_free(entries);
+    return bytes;
+}
+
+
+bool frame_cache_store(const char *path, double time, const char *variant, Image image) {
+    if (image.format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 || image.data == NULL) return false;
+    char file[PATH_MAX];
+    if (!frame_cache_file(file, sizeof(file), path, time, variant)) return false;
+
+    qoi_desc desc = {
+        .width = image.width,
+        .height = image.height,
+        .channels = 4,
+        .colorspace = QOI_SRGB,
+    };
+    int size = 0;
+    unsigned char *encoded = qoi_encode(image.data, &desc, &size);
+    if (encoded == NULL) return false;
+
+    bool written = cache_write_atomic(file, encoded, size);
+    MemFree(encoded);
+    if (!written) return false;
+
+    pthread_mutex_lock(&frame_cache.lock);
+    char *slash = strrchr(file, '/');
+    *slash = '\0';
+    if (!frame_cache.counted) {
+        frame_cache.bytes = frame_cache_scan(file, false);
+        frame_cache.counted = true;
+    } else {
+        frame_cache.bytes += size;
+    }
+    if (frame_cache.bytes > FRAME_CACHE_MAX_BYTES) frame_cache.bytes = frame_cache_scan(file, true);
+    pthread_mutex_unlock(&frame_cache.lock);
+    return true;
+}
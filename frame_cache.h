@@ -0,0 +1,28 @@
+#ifndef FRAME_CACHE_H_
+#define FRAME_CACHE_H_
+
+#include <stdbool.h>
+
+#include "./thirdparty/raylib/src/raylib.h"
+
+// Downscaled preview frames kept between sessions, so scrubbing a file you've been through
+// before doesn't decode anything:
+//   $XDG_CACHE_HOME/video-processor/frames/<hash>.qoi
+// The hash covers the path, size and mtime of the input, the time of the frame and `variant`,
+// whatever else decides how the frame looks (the -vf chain). QOI decodes several times faster
+// than PNG and the files are mapped rather than read.
+//
+// The directory is kept under FRAME_CACHE_MAX_BYTES by deleting the least recently used frames.
+// A hit bumps the mtime of its file, which is what "recently used" goes by.
+//
+// Safe to call from the pool.
+
+#define FRAME_CACHE_MAX_BYTES (256ll*1024*1024)
+
+// The frame is RGBA. It's the caller's to UnloadImage().
+bool frame_cache_load(const char *path, double time, const char *variant, Image *image);
+
+// `image` must be RGBA.
+bool frame_cache_store(const char *path, double time, const char *variant, Image image);
+
+#endif // FRAME_CACHE_H_
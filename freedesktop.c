@@ -0,0 +1,285 @@
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./freedesktop.h"
+#include "./thirdparty/nob.h"
+
+#define FREEDESKTOP_URI_CAPACITY (PATH_MAX*3 + 8)
+
+static const uint32_t md5_k[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static const uint8_t md5_r[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+
+static void md5_block(uint32_t state[4], const uint8_t *block) {
+    uint32_t m[16];
+    for (size_t i = 0; i < 16; ++i) {
+        m[i] = (uint32_t) block[i*4] | (uint32_t) block[i*4 + 1] << 8 | (uint32_t) block[i*4 + 2] << 16 | (uint32_t) block[i*4 + 3] << 24;
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    for (size_t i = 0; i < 64; ++i) {
+        uint32_t f;
+        size_t g;
+        if (i < 16)      { f = (b & c) | (~b & d); g = i; }
+        else if (i < 32) { f = (d & b) | (~d & c); g = (5*i + 1) % 16; }
+        else if (i < 48) { f = b ^ c ^ d;          g = (3*i + 5) % 16; }
+        else             { f = c ^ (b | ~d);       g = (7*i) % 16; }
+        f += a + md5_k[i] + m[g];
+        a = d;
+        d = c;
+        c = b;
+        b += f << md5_r[i] | f >> (32 - md5_r[i]);
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+
+// raylib has ComputeMD5() but it returns a static buffer, and we hash from several workers at once.
+static void md5_hex(const char *data, char hex[33]) {
+    uint32_t state[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+    size_t size = strlen(data), i = 0;
+    for (; i + 64 <= size; i += 64) md5_block(state, (const uint8_t*) data + i);
+
+    uint8_t tail[128] = {0};
+    size_t rest = size - i;
+    memcpy(tail, data + i, rest);
+    tail[rest] = 0x80;
+    size_t tail_size = rest + 1 + 8 <= 64 ? 64 : 128;
+    uint64_t bits = (uint64_t) size*8;
+    for (size_t j = 0; j < 8; ++j) tail[tail_size - 8 + j] = (uint8_t)(bits >> (8*j));
+    for (size_t j = 0; j < tail_size; j += 64) md5_block(state, tail + j);
+
+    for (size_t j = 0; j < 16; ++j) sprintf(hex + j*2, "%02x", (state[j/4] >> (8*(j%4))) & 0xff);
+}
+
+
+// file:///absolute/path with everything but the RFC 2396 unreserved characters escaped,
+// which is what the file managers hash.
+static bool freedesktop_uri(const char *path, char *uri, size_t size) {
+    char absolute[PATH_MAX];
+    if (realpath(path, absolute) == NULL) return false;
+
+    size_t n = (size_t) snprintf(uri, size, "file://");
+    for (const char *p = absolute; *p != '\0'; ++p) {
+        unsigned char ch = *p;
+        if (n + 4 > size) return false;
+        if (isalnum(ch) || strchr("-_.!~*'()/:@&=+$,", ch) != NULL) {
+            uri[n++] = ch;
+        } else {
+            n += snprintf(uri + n, size - n, "%%%02X", ch);
+        }
+    }
+    uri[n] = '\0';
+    return true;
+}
+
+
+// $XDG_CACHE_HOME/thumbnails/<flavor>, without creating anything.
+static bool freedesktop_dir(char *dir, size_t size, const char *flavor) {
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    int written;
+    if (xdg != NULL && *xdg != '\0') {
+        written = snprintf(dir, size, "%s/thumbnails/%s", xdg, flavor);
+    } else if (home != NULL) {
+        written = snprintf(dir, size, "%s/.cache/thumbnails/%s", home, flavor);
+    } else {
+        return false;
+    }
+    return written > 0 && (size_t) written < size;
+}
+
+
+// Value of the tEXt chunk `key`, pointing into `png`, or NULL.
+static const char *freedesktop_png_text(const unsigned char *png, size_t size, const char *key, size_t *length) {
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (size < 8 || memcmp(png, signature, 8) != 0) return NULL;
+
+    size_t key_size = strlen(key);
+    for (size_t pos = 8; pos + 12 <= size;) {
+        size_t chunk = (size_t) png[pos] << 24 | (size_t) png[pos + 1] << 16 | (size_t) png[pos + 2] << 8 | png[pos + 3];
+        if (chunk > size - pos - 12) return NULL;
+        const unsigned char *type = png + pos + 4;
+        const unsigned char *data = png + pos + 8;
+        if (memcmp(type, "IDAT", 4) == 0 || memcmp(type, "IEND", 4) == 0) return NULL;
+        if (memcmp(type, "tEXt", 4) == 0 && chunk > key_size && memcmp(data, key, key_size) == 0 && data[key_size] == '\0') {
+            *length = chunk - key_size - 1;
+            return (const char*) data + key_size + 1;
+        }
+        pos += chunk + 12;
+    }
+    return NULL;
+}
+
+
+static bool freedesktop_valid(const Nob_String_Builder *png, const char *uri, const struct stat *st) {
+    const unsigned char *data = (const unsigned char*) png->items;
+    size_t length;
+    const char *mtime = freedesktop_png_text(data, png->count, "Thumb::MTime", &length);
+    if (mtime == NULL || length == 0 || length >= 32) return false;
+    char value[32];
+    memcpy(value, mtime, length);
+    value[length] = '\0';
+    char *end;
+    long long seconds = strtoll(value, &end, 10);
+    if (*end != '\0' || seconds != (long long) st->st_mtime) return false;
+
+    // Thumb::URI is required by the spec, but a hash collision is the only way it can differ.
+    const char *stored = freedesktop_png_text(data, png->count, "Thumb::URI", &length);
+    return stored == NULL || (length == strlen(uri) && memcmp(stored, uri, length) == 0);
+}
+
+
+bool freedesktop_thumbnail_load(const char *path, Image *image) {
+    struct stat st;
+    char uri[FREEDESKTOP_URI_CAPACITY], hash[33];
+    if (stat(path, &st) < 0 || !freedesktop_uri(path, uri, sizeof(uri))) return false;
+    md5_hex(uri, hash);
+
+    static const char *flavors[] = {"normal", "large"};
+    for (size_t i = 0; i < NOB_ARRAY_LEN(flavors); ++i) {
+        char dir[PATH_MAX], thumbnail[PATH_MAX + 64];
+        if (!freedesktop_dir(dir, sizeof(dir), flavors[i])) return false;
+        snprintf(thumbnail, sizeof(thumbnail), "%s/%s.png", dir, hash);
+        // Misses are the common case, don't let nob_read_entire_file() log them.
+        if (access(thumbnail, R_OK) < 0) continue;
+
+        Nob_String_Builder png = {0};
+        if (!nob_read_entire_file(thumbnail, &png)) continue;
+        if (freedesktop_valid(&png, uri, &st)) {
+            Image loaded = LoadImageFromMemory(".png", (const unsigned char*) png.items, (int) png.count);
+            if (loaded.data != NULL) {
+                ImageFormat(&loaded, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+                *image = loaded;
+                nob_sb_free(png);
+                return true;
+            }
+        }
+        nob_sb_free(png);
+    }
+    return false;
+}
+
+
+static void freedesktop_append_be32(Nob_String_Builder *sb, uint32_t value) {
+    char bytes[4] = {(char)(value >> 24), (char)(value >> 16), (char)(value >> 8), (char) value};
+    nob_sb_append_buf(sb, bytes, 4);
+}
+
+
+static void freedesktop_append_text(Nob_String_Builder *sb, const char *key, const char *value) {
+    size_t key_size = strlen(key), value_size = strlen(value);
+    freedesktop_append_be32(sb, (uint32_t)(key_size + 1 + value_size));
+    size_t type = sb->count;
+    nob_sb_append_cstr(sb, "tEXt");
+    nob_sb_append_buf(sb, key, key_size + 1);
+    nob_sb_append_buf(sb, value, value_size);
+    // The CRC covers the type and the data.
+    freedesktop_append_be32(sb, ComputeCRC32((unsigned char*) sb->items + type, (int)(sb->count - type)));
+}
+
+
+// mkdir -p, private to the user like the spec wants.
+static bool freedesktop_mkdir(char *dir) {
+    for (char *p = dir + 1;; ++p) {
+        if (*p != '/' && *p != '\0') continue;
+        char ch = *p;
+        *p = '\0';
+        int ret = mkdir(dir, 0700);
+        *p = ch;
+        if (ret < 0 && errno != EEXIST) {
+            nob_log(NOB_ERROR, "could not create directory %s: %s", dir, strerror(errno));
+            return false;
+        }
+        if (ch == '\0') return true;
+    }
+}
+
+
+bool freedesktop_thumbnail_save(const char *path, Image image) {
+    bool result = true;
+    struct stat st;
+    char uri[FREEDESKTOP_URI_CAPACITY], hash[33], dir[PATH_MAX];
+    if (stat(path, &st) < 0 || !freedesktop_uri(path, uri, sizeof(uri))) return false;
+    if (!freedesktop_dir(dir, sizeof(dir), "normal")) return false;
+    md5_hex(uri, hash);
+
+    if (!freedesktop_mkdir(dir)) return false;
+
+    int size = 0;
+    unsigned char *encoded = ExportImageToMemory(image, ".png", &size);
+    Nob_String_Builder png = {0};
+    char temp[PATH_MAX + 64], thumbnail[PATH_MAX + 64];
+    int fd = -1;
+    temp[0] = '\0';
+    // The text chunks go right after IHDR: signature (8) + IHDR (4 + 4 + 13 + 4).
+    if (encoded == NULL || size < 33 || memcmp(encoded + 12, "IHDR", 4) != 0) nob_return_defer(false);
+
+    char mtime[32], file_size[32];
+    snprintf(mtime, sizeof(mtime), "%lld", (long long) st.st_mtime);
+    snprintf(file_size, sizeof(file_size), "%lld", (long long) st.st_size);
+    nob_sb_append_buf(&png, encoded, 33);
+    freedesktop_append_text(&png, "Thumb::URI", uri);
+    freedesktop_append_text(&png, "Thumb::MTime", mtime);
+    freedesktop_append_text(&png, "Thumb::Size", file_size);
+    freedesktop_append_text(&png, "Software", "video-processor");
+    nob_sb_append_buf(&png, encoded + 33, size - 33);
+
+    // Written next to the final name and renamed over it, so readers never see half a file.
+    snprintf(thumbnail, sizeof(thumbnail), "%s/%s.png", dir, hash);
+    snprintf(temp, sizeof(temp), "%s/%s.png.XXXXXX", dir, hash);
+    fd = mkstemp(temp);
+    if (fd < 0) {
+        nob_log(NOB_ERROR, "could not create %s: %s", temp, strerror(errno));
+        temp[0] = '\0';
+        nob_return_defer(false);
+    }
+    fchmod(fd, 0600);
+    for (size_t written = 0; written < png.count;) {
+        ssize_t n = write(fd, png.items + written, png.count - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            nob_log(NOB_ERROR, "could not write %s: %s", temp, strerror(errno));
+            nob_return_defer(false);
+        }
+        written += (size_t) n;
+    }
+    close(fd);
+    fd = -1;
+    if (rename(temp, thumbnail) < 0) {
+        nob_log(NOB_ERROR, "could not rename %s to %s: %s", temp, thumbnail, strerror(errno));
+        nob_return_defer(false);
+    }
+    temp[0] = '\0';
+
+defer:
+    if (fd >= 0) close(fd);
+    if (temp[0] != '\0') unlink(temp);
+    nob_sb_free(png);
+    MemFree(encoded);
+    return result;
+}
@@ -0,0 +1,23 @@
+#ifndef FREEDESKTOP_H_
+#define FREEDESKTOP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "./thirdparty/raylib/src/raylib.h"
+
+// The shared thumbnail cache of the freedesktop.org Thumbnail Managing Standard, which Nemo,
+// Nautilus and the others fill as you browse:
+//   $XDG_CACHE_HOME/thumbnails/{normal,large}/<md5 of the file URI>.png
+// A thumbnail is valid when its Thumb::URI and Thumb::MTime text chunks match the file.
+//
+// Everything here is safe to call from the pool.
+
+// Loads the best cached thumbnail of `path`: "normal" (128 px) if there is one, else "large"
+// (256 px). The image is RGBA; it's the caller's to UnloadImage().
+bool freedesktop_thumbnail_load(const char *path, Image *image);
+
+// Stores an RGBA thumbnail of at most 128 px in "normal", where other applications find it too.
+bool freedesktop_thumbnail_save(const char *path, Image image);
+
+#endif // FREEDESKTOP_H_
@@ -0,0 +1,759 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "./concat.h"
+#include "./formats.h"
+#include "./jobs.h"
+#include "./pool.h"
+#include "./trim.h"
+
+_Static_assert(FFMPEG_MONITOR_FD == LAUNCHER_TAP_FD, "ffmpeg writes the monitor to the launcher's tap");
+
+// How long ffmpeg gets to finish after "q" before SIGTERM, and after SIGTERM before SIGKILL.
+#define JOB_CANCEL_TIMEOUT 3.0
+// A stream copy only reads and writes the file, it goes about as fast as the disk.
+#define JOB_COPY_BYTES_PER_SEC 200e6
+
+const char *job_state_name(Job_State state) {
+    switch (state) {
+    case JOB_QUEUED:  return "QUEUED";
+    case JOB_RUNNING: return "RUNNING";
+    case JOB_PAUSED:  return "PAUSED";
+    case JOB_CANCELLING: return "CANCELLING";
+    case JOB_DONE:    return "DONE";
+    case JOB_FAILED:  return "FAILED";
+    case JOB_CANCELLED: return "CANCELLED";
+    }
+    NOB_UNREACHABLE("job_state_name");
+}
+
+
+static size_t jobs_max_running(const Jobs *jobs) {
+    return jobs->max_running > 0
+        ? jobs->max_running
+        : thread_budget_default_concurrency(&jobs->thread_budget);
+}
+
+
+// Encode time so far, without the time spent paused.
+static double job_elapsed(const Job *job, uint64_t now) {
+    uint64_t paused_for = job->paused_for;
+    if (job->paused_at > 0) paused_for += now - job->paused_at;
+    return (double)(now - job->started_at - paused_for) / NOB_NANOS_PER_SEC;
+}
+
+
+// `dir/name.mp4` -> `dir/name.part.mp4`, keeping the extension so ffmpeg still guesses the muxer.
+static char *job_part_path(const char *output_path) {
+    const char *slash = strrchr(output_path, '/');
+    const char *dot = strrchr(output_path, '.');
+    if (dot == NULL || (slash != NULL && dot < slash)) dot = output_path + strlen(output_path);
+
+    size_t size = strlen(output_path) + sizeof(".part");
+    char *part_path = malloc(size);
+    snprintf(part_path, size, "%.*s.part%s", (int)(dot - output_path), output_path, dot);
+    return part_path;
+}
+
+
+static void job_remove_partial_output(Job *job) {
+    if (unlink(job->part_path) < 0 && errno != ENOENT) {
+        nob_log(NOB_WARNING, "could not remove %s: %s", job->part_path, strerror(errno));
+    }
+}
+
+
+// The files next to the partial output that only live while the job runs: the pieces of a smart
+// render and the list of a join. The middle piece is about as big as the input.
+static void job_remove_temporaries(Job *job) {
+    if (job->params.smart_render) trim_smart_cleanup(job->part_path);
+    if (job->params.concat_count > 0) {
+        char list_path[4096];
+        snprintf(list_path, sizeof(list_path), "%s.concat.txt", job->part_path);
+        if (unlink(list_path) < 0 && errno != ENOENT) nob_log(NOB_WARNING, "could not remove %s: %s", list_path, strerror(errno));
+    }
+}
+
+
+// Seconds of the input that end up in the output.
+static double job_output_duration(FfmpegParams params, const Probe *probe) {
+    double end = params.trim_out > 0 && params.trim_out < probe->duration ? params.trim_out : probe->duration;
+    return end > params.trim_in ? end - params.trim_in : 0;
+}
+
+
+// Seconds of the output that go through the encoder.
+static double job_encoded_duration(FfmpegParams params, const Probe *probe) {
+    if (params.stream_copy) return 0;
+    if (!params.smart_render) return job_output_duration(params, probe);
+    double head = params.smart_copy_from - params.trim_in;
+    double tail = params.trim_out > 0 && params.smart_copy_to > 0 ? params.trim_out - params.smart_copy_to : 0;
+    return head + tail;
+}
+
+
+// Output pixels times seconds to encode, 0 when there's nothing to encode or the input couldn't be probed.
+static double job_work(FfmpegParams params, const Probe *probe) {
+    if (!probe->ok) return 0;
+    int width = probe->width - params.crop_left - params.crop_right;
+    int height = probe->height - params.crop_top - params.crop_bottom;
+    // Audio-only inputs still take some time.
+    if (width < 16) width = 16;
+    if (height < 16) height = 16;
+    return job_encoded_duration(params, probe) * width * height;
+}
+
+
+static double jobs_cost(const Jobs *jobs, FfmpegParams params, const Probe *probe, double work, size_t threads) {
+    double cost = 0;
+    if ((params.stream_copy || params.smart_render) && probe->ok && probe->duration > 0) {
+        double copied = job_output_duration(params, probe) - job_encoded_duration(params, probe);
+        cost += probe->size * copied / probe->duration / JOB_COPY_BYTES_PER_SEC;
+        // concat and the decode check go over the output once more each
+        if (params.smart_render) cost *= 3;
+    }
+    if (work > 0) {
+        char profile[64];
+        ffmpeg_params_profile(params, profile, sizeof(profile));
+        if (threads == 0) threads = thread_budget_total(&jobs->thread_budget);
+        cost += work / (throughput_history_get(&jobs->history, profile) * threads);
+    }
+    return cost;
+}
+
+
+// Encode time of `job` with `threads` threads according to the throughput history.
+static double job_cost(const Jobs *jobs, const Job *job, size_t threads) {
+    return jobs_cost(jobs, job->params, &job->probe, job->work, threads);
+}
+
+
+static size_t jobs_default_threads(const Jobs *jobs) {
+    size_t threads = thread_budget_total(&jobs->thread_budget) / jobs_max_running(jobs);
+    return threads > 0 ? threads : 1;
+}
+
+
+static void jobs_load_history(Jobs *jobs) {
+    if (jobs->history_loaded) return;
+    throughput_history_load(&jobs->history);
+    jobs->history_loaded = true;
+}
+
+
+double jobs_estimate(Jobs *jobs, FfmpegParams params, const Probe *probe) {
+    jobs_load_history(jobs);
+    return jobs_cost(jobs, params, probe, job_work(params, probe), jobs_default_threads(jobs));
+}
+
+
+double job_frame_reduction(const Job *job) {
+    if (!job->params.screen_recording || job->frames <= 0) return 0;
+    // r_frame_rate of the input, e.g. "30000/1001".
+    char *end;
+    double fps = strtod(job->probe.frame_rate, &end);
+    if (*end == '/') {
+        double den = strtod(end + 1, NULL);
+        fps = den > 0 ? fps / den : 0;
+    }
+    double input_frames = job->out_time * fps;
+    if (input_frames < 1) return 0;
+    double reduction = 1 - job->frames / input_frames;
+    return reduction > 0 ? reduction : 0;
+}
+
+
+double job_speedup(const Job *job) {
+    if (!job->params.screen_recording || job->state != JOB_DONE || job->plain_predicted <= 0) return 0;
+    double wall = job_elapsed(job, job->finished_at);
+    return wall > 0 ? job->plain_predicted / wall : 0;
+}
+
+
+// Predicts the end of the current batch: running jobs keep their slots for the rest of their
+// predicted time and the queue is scheduled LPT-first onto the slots as they free up.
+static void jobs_predict(Jobs *jobs) {
+    uint64_t now = nob_nanos_since_unspecified_epoch();
+    size_t machines = jobs_max_running(jobs);
+    size_t threads = jobs_default_threads(jobs);
+
+    double *loads = calloc(machines, sizeof(*loads));
+    double *costs = calloc(jobs->count + 1, sizeof(*costs));
+    size_t running = 0;
+    size_t queued = 0;
+    for (size_t i = 0; i < jobs->count; ++i) {
+        Job *job = &jobs->items[i];
+        if (job->state == JOB_QUEUED) {
+            job->predicted = job_cost(jobs, job, threads);
+            costs[queued++] = job->predicted;
+        } else if ((job->state == JOB_RUNNING || job->state == JOB_CANCELLING) && running < machines) {
+            double left = job->predicted - job_elapsed(job, now);
+            loads[running++] = left > 0 ? left : 0;
+        }
+    }
+
+    double elapsed = jobs->batch_started_at > 0 ? (double)(now - jobs->batch_started_at) / NOB_NANOS_PER_SEC : 0;
+    jobs->batch_predicted = elapsed + makespan_lpt(costs, queued, loads, machines);
+    free(costs);
+    free(loads);
+}
+
+
+typedef struct {
+    Jobs *jobs;
+    size_t id;
+    char **paths; // owned by the job, which outlives the task
+    size_t count;
+    char *input_path; // what `paths` points to for a single input
+    Probe *probes;
+    FfmpegParams params; // as submitted, the paths owned by the job
+    bool disabled; // don't key the result cache
+    Result_Cache_Key key;
+    bool keyed;
+} Job_Probe_Task;
+
+
+static void job_probe_work(void *arg) {
+    Job_Probe_Task *task = arg;
+    for (size_t i = 0; i < task->count; ++i) probe_file(task->paths[i], &task->probes[i]);
+    // Sampling the inputs is cheap next to the probe, and the page cache already has the start.
+    if (!task->disabled) task->keyed = result_cache_key(task->params, &task->key);
+}
+
+
+// The probe of a join describes the joined output: the format of the first part, the audio of
+// the first part that has some, with the total duration and size.
+static void job_probe_concat(Job *job, const Probe *probes) {
+    FfmpegParams *params = &job->params;
+    char reason[128] = "";
+    params->concat_demuxer = concat_compatible(probes, params->concat_count, reason, sizeof(reason));
+    params->stream_copy = params->concat_demuxer && !ffmpeg_params_filtered(*params);
+    if (!params->concat_demuxer) nob_log(NOB_INFO, "%s: joining with an encode, %s", params->output_path, reason);
+
+    job->probe = probes[0];
+    for (size_t i = 1; i < params->concat_count; ++i) {
+        job->probe.ok = job->probe.ok && probes[i].ok;
+        job->probe.duration += probes[i].duration;
+        job->probe.size += probes[i].size;
+    }
+
+    int audio = concat_audio_part(probes, params->concat_count);
+    if (audio < 0) {
+        job->probe.audio_codec[0] = '\0';
+        for (size_t i = 0; i < params->concat_count; ++i) {
+            if (probes[i].audio_codec[0] != '\0') {
+                nob_log(NOB_WARNING, "%s: joining without audio, a part without it has no known length to fill with silence", params->output_path);
+                break;
+            }
+        }
+        return;
+    }
+    memcpy(job->probe.audio_codec, probes[audio].audio_codec, sizeof(job->probe.audio_codec));
+    job->probe.sample_rate = probes[audio].sample_rate;
+    job->probe.channels = probes[audio].channels;
+    for (size_t i = 0; i < params->concat_count; ++i) {
+        if (probes[i].audio_codec[0] == '\0') nob_log(NOB_INFO, "%s: part %zu has no audio, filling it with silence", params->output_path, i + 1);
+    }
+}
+
+
+// A copy into a container that can't hold the codecs of the input would fail in the muxer. Those
+// are encoded instead, except for remuxes, which are only worth it as copies.
+static void job_check_format(Job *job) {
+    FfmpegParams *params = &job->params;
+    const Format *format = format_find(params->output_path);
+    if (!(params->stream_copy || params->smart_render) || format == NULL || !job->probe.ok) return;
+    char reason[128];
+    if (format_can_copy(format, &job->probe, reason, sizeof(reason))) return;
+    if (params->remux) {
+        job->state = JOB_FAILED;
+        job->started_at = job->finished_at = nob_nanos_since_unspecified_epoch();
+        snprintf(job->last_error, sizeof(job->last_error), "can't remux: %s", reason);
+        nob_log(NOB_ERROR, "%s: %s", params->input_path, job->last_error);
+        return;
+    }
+    nob_log(NOB_INFO, "%s: encoding instead of copying, %s", params->output_path, reason);
+    params->stream_copy = params->smart_render = false;
+}
+
+
+// Finishes the job right away with the output of an earlier run of the same inputs and settings.
+static bool job_reuse_result(Jobs *jobs, Job *job) {
+    if (!job->cache_keyed || !result_cache_fetch(&jobs->results, job->cache_key, job->part_path)) return false;
+    if (rename(job->part_path, job->params.output_path) < 0) {
+        nob_log(NOB_WARNING, "could not rename %s: %s", job->part_path, strerror(errno));
+        unlink(job->part_path);
+        return false;
+    }
+    job->state = JOB_DONE;
+    job->started_at = job->finished_at = nob_nanos_since_unspecified_epoch();
+    job->work = 0;
+    nob_log(NOB_INFO, "%s: reused the cached result", job->params.input_path);
+    return true;
+}
+
+
+static void job_probe_done(void *arg) {
+    Job_Probe_Task *task = arg;
+    Job *job = &task->jobs->items[task->id];
+    if (job->params.concat_count > 0) {
+        job_probe_concat(job, task->probes);
+        job->parts = task->probes;
+        task->probes = NULL;
+    } else {
+        job->probe = task->probes[0];
+        job->params.input_rotation = job->probe.rotation;
+    }
+    job->cache_key = task->key;
+    job->cache_keyed = task->keyed;
+    if (job->state == JOB_QUEUED) job_check_format(job);
+    // The monitor taps the first video stream, without one (or without knowing) ffmpeg can't
+    // build the graph and the whole encode fails.
+    if (job->probe.video_codec[0] == '\0') job->params.monitor = false;
+    job->work = job_work(job->params, &job->probe);
+    if (job->state == JOB_QUEUED) job_reuse_result(task->jobs, job);
+    job->probed = true;
+    jobs_predict(task->jobs);
+    free(task->probes);
+    free(task);
+}
+
+
+// Takes whatever the tap has without blocking. Only the latest whole frame is kept, the UI shows
+// nothing older anyway.
+static void job_read_monitor(Job *job) {
+    if (job->monitor_fd < 0) return;
+    if (job->monitor_partial == NULL) job->monitor_partial = malloc(FFMPEG_MONITOR_FRAME_SIZE);
+    for (;;) {
+        ssize_t n = read(job->monitor_fd, job->monitor_partial + job->monitor_filled, FFMPEG_MONITOR_FRAME_SIZE - job->monitor_filled);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        job->monitor_filled += n;
+        if (job->monitor_filled < FFMPEG_MONITOR_FRAME_SIZE) continue;
+        unsigned char *frame = job->monitor_frame;
+        job->monitor_frame = job->monitor_partial;
+        job->monitor_partial = frame != NULL ? frame : malloc(FFMPEG_MONITOR_FRAME_SIZE);
+        job->monitor_filled = 0;
+        job->monitor_frames += 1;
+    }
+}
+
+
+static void job_close_monitor(Job *job) {
+    if (job->monitor_fd >= 0) close(job->monitor_fd);
+    job->monitor_fd = -1;
+    free(job->monitor_frame);
+    free(job->monitor_partial);
+    job->monitor_frame = job->monitor_partial = NULL;
+    job->monitor_filled = 0;
+}
+
+
+size_t jobs_submit(Jobs *jobs, FfmpegParams params) {
+    jobs_load_history(jobs);
+
+    Job job = {
+        .id = jobs->count,
+        .params = params,
+        .state = JOB_QUEUED,
+        .pid = -1,
+        .stdin_fd = -1,
+        .monitor_fd = -1,
+    };
+    job.params.input_path = strdup(params.input_path);
+    job.params.output_path = strdup(params.output_path);
+    job.part_path = job_part_path(params.output_path);
+    if (params.concat_count > 0) {
+        job.params.concat_paths = malloc(params.concat_count * sizeof(*job.params.concat_paths));
+        for (size_t i = 0; i < params.concat_count; ++i) job.params.concat_paths[i] = strdup(params.concat_paths[i]);
+        job.params.trim_in = job.params.trim_out = 0;
+        job.params.stream_copy = job.params.smart_render = false;
+    }
+    if (job.params.remux) {
+        job.params.stream_copy = true;
+        job.params.smart_render = false;
+        job.params.trim_in = job.params.trim_out = 0;
+    }
+    // Only the plain encode has a filter graph of its own to split, and only with video.
+    const Format *format = format_find(params.output_path);
+    if (job.params.stream_copy || job.params.smart_render || job.params.concat_count > 0) job.params.monitor = false;
+    if (format != NULL && format->audio_only) job.params.monitor = false;
+    nob_da_append(jobs, job);
+
+    // Probing a big selection takes seconds, the job waits in the queue until its probe is back.
+    Job_Probe_Task *task = calloc(1, sizeof(*task));
+    task->jobs = jobs;
+    task->id = job.id;
+    if (params.concat_count > 0) {
+        task->paths = job.params.concat_paths;
+        task->count = params.concat_count;
+    } else {
+        task->input_path = job.params.input_path;
+        task->paths = &task->input_path;
+        task->count = 1;
+    }
+    task->probes = calloc(task->count, sizeof(*task->probes));
+    task->params = job.params;
+    task->disabled = jobs->results_disabled;
+    pool_submit(job_probe_work, job_probe_done, task);
+    jobs_predict(jobs);
+    return job.id;
+}
+
+
+size_t jobs_running_count(const Jobs *jobs) {
+    size_t count = 0;
+    for (size_t i = 0; i < jobs->count; ++i) {
+        Job_State state = jobs->items[i].state;
+        if (state == JOB_RUNNING || state == JOB_CANCELLING) count += 1;
+    }
+    return count;
+}
+
+
+bool jobs_finished(const Jobs *jobs) {
+    for (size_t i = 0; i < jobs->count; ++i) {
+        Job_State state = jobs->items[i].state;
+        if (state == JOB_QUEUED || state == JOB_RUNNING || state == JOB_PAUSED || state == JOB_CANCELLING) return false;
+    }
+    return true;
+}
+
+
+bool jobs_pause(Jobs *jobs, size_t id) {
+    if (id >= jobs->count || jobs->items[id].state != JOB_RUNNING) return false;
+    Job *job = &jobs->items[id];
+    if (!launcher_signal(job->pid, SIGSTOP)) return false;
+    job->state = JOB_PAUSED;
+    job->paused_at = nob_nanos_since_unspecified_epoch();
+    thread_budget_release(&jobs->thread_budget, job->threads);
+    return true;
+}
+
+
+bool jobs_resume(Jobs *jobs, size_t id) {
+    if (id >= jobs->count || jobs->items[id].state != JOB_PAUSED) return false;
+    Job *job = &jobs->items[id];
+    if (!launcher_signal(job->pid, SIGCONT)) return false;
+    job->state = JOB_RUNNING;
+    job->paused_for += nob_nanos_since_unspecified_epoch() - job->paused_at;
+    job->paused_at = 0;
+    thread_budget_take(&jobs->thread_budget, job->threads);
+    return true;
+}
+
+
+bool jobs_cancel(Jobs *jobs, size_t id) {
+    if (id >= jobs->count) return false;
+    Job *job = &jobs->items[id];
+    switch (job->state) {
+    case JOB_QUEUED:
+        job->state = JOB_CANCELLED;
+        jobs_predict(jobs);
+        return true;
+    case JOB_PAUSED:
+        // A stopped ffmpeg can't read the "q".
+        if (!jobs_resume(jobs, id)) return false;
+        // fallthrough
+    case JOB_RUNNING:
+        job->state = JOB_CANCELLING;
+        job->cancel_requested_at = nob_nanos_since_unspecified_epoch();
+        job->cancel_signal = 0;
+        // ffmpeg finishes the current frame, writes the trailer and exits with 0 or 255.
+        if (job->stdin_fd < 0 || write(job->stdin_fd, "q", 1) != 1) {
+            job->cancel_signal = SIGTERM;
+            launcher_signal(job->pid, SIGTERM);
+        }
+        return true;
+    case JOB_CANCELLING:
+    case JOB_DONE:
+    case JOB_FAILED:
+    case JOB_CANCELLED:
+        return false;
+    }
+    NOB_UNREACHABLE("jobs_cancel");
+}
+
+
+void jobs_shutdown(Jobs *jobs) {
+    for (size_t i = 0; i < jobs->count; ++i) {
+        Job *job = &jobs->items[i];
+        if (job->state != JOB_RUNNING && job->state != JOB_PAUSED && job->state != JOB_CANCELLING) continue;
+        // The launcher reaps the processes when it shuts down, the file is gone already by then.
+        if (job->state == JOB_PAUSED) launcher_signal(job->pid, SIGCONT);
+        launcher_signal(job->pid, SIGTERM);
+        job_remove_partial_output(job);
+        job_remove_temporaries(job);
+        job->state = JOB_CANCELLED;
+    }
+}
+
+
+void jobs_free(Jobs *jobs) {
+    for (size_t i = 0; i < jobs->count; ++i) {
+        free(jobs->items[i].params.input_path);
+        free(jobs->items[i].params.output_path);
+        free(jobs->items[i].part_path);
+        for (size_t j = 0; j < jobs->items[i].params.concat_count; ++j) free(jobs->items[i].params.concat_paths[j]);
+        free(jobs->items[i].params.concat_paths);
+        free(jobs->items[i].parts);
+        if (jobs->items[i].stdin_fd >= 0) close(jobs->items[i].stdin_fd);
+        job_close_monitor(&jobs->items[i]);
+    }
+    nob_da_free(*jobs);
+    nob_da_free(jobs->history);
+    result_cache_free(&jobs->results);
+    memset(jobs, 0, sizeof(*jobs));
+}
+
+
+static void job_parse_progress(Job *job, const char *line) {
+    Nob_String_View value = nob_sv_from_cstr(line);
+    Nob_String_View key = nob_sv_chop_by_delim(&value, '=');
+
+    // Despite the name out_time_ms is in microseconds as well.
+    if (nob_sv_eq(key, nob_sv_from_cstr("out_time_us"))) {
+        long long us = strtoll(value.data, NULL, 10);
+        if (us >= 0) job->out_time = us / 1e6;
+    } else if (nob_sv_eq(key, nob_sv_from_cstr("speed"))) {
+        job->speed = strtod(value.data, NULL);
+    } else if (nob_sv_eq(key, nob_sv_from_cstr("frame"))) {
+        job->frames = strtoll(value.data, NULL, 10);
+    }
+}
+
+
+// Starts the ffmpeg of the current step. A smart render goes through the Trim_Steps one process
+// at a time and skips the ones it doesn't need, everything else is a single step.
+static bool job_spawn(Job *job) {
+    FfmpegParams params = job->params;
+    params.output_path = job->part_path;
+    size_t checkpoint = nob_temp_save();
+    Nob_Cmd cmd = {0};
+    bool ok = true;
+    if (params.concat_count > 0) {
+        ok = concat_build_cmd(&cmd, params, job->parts, nob_temp_sprintf("%s.concat.txt", job->part_path));
+    } else if (params.smart_render) {
+        while (ok && cmd.count == 0 && job->step < TRIM_STEP_COUNT) {
+            ok = trim_smart_step_cmd(&cmd, params, &job->probe, job->step);
+            if (cmd.count == 0) job->step += 1;
+        }
+    } else {
+        ffmpeg_build_cmd(&cmd, params);
+    }
+    int *monitor_fd = job->params.monitor ? &job->monitor_fd : NULL;
+    // The samples of the controller belong to the previous process of a smart render, the ticks
+    // of a new one start over and the difference would wrap around.
+    job->cpu_ticks = 0;
+    job->cpu_usage = 0;
+    job->rss = 0;
+    job->pid = ok && cmd.count > 0 ? launcher_spawn(cmd, job->id, &job->stdin_fd, monitor_fd) : -1;
+    nob_cmd_free(cmd);
+    nob_temp_rewind(checkpoint);
+    return job->pid >= 0;
+}
+
+
+static void job_start(Jobs *jobs, Job *job, size_t starting) {
+    job->threads = thread_budget_acquire(&jobs->thread_budget, starting);
+    job->params.threads = job->threads;
+    job_spawn(job);
+
+    job->started_at = nob_nanos_since_unspecified_epoch();
+    job->predicted = job_cost(jobs, job, job->threads);
+    if (job->params.screen_recording) {
+        FfmpegParams plain = job->params;
+        plain.screen_recording = false;
+        job->plain_predicted = jobs_cost(jobs, plain, &job->probe, job->work, job->threads);
+    }
+    if (jobs->batch_started_at == 0) jobs->batch_started_at = job->started_at;
+    if (job->pid < 0) {
+        thread_budget_release(&jobs->thread_budget, job->threads);
+        job->state = JOB_FAILED;
+        job->finished_at = job->started_at;
+        snprintf(job->last_error, sizeof(job->last_error), "could not start ffmpeg");
+        return;
+    }
+    job->state = JOB_RUNNING;
+}
+
+
+static void job_finish(Jobs *jobs, Job *job, int exit_code) {
+    job->exit_code = exit_code;
+    job->finished_at = nob_nanos_since_unspecified_epoch();
+    thread_budget_release(&jobs->thread_budget, job->threads);
+    if (job->stdin_fd >= 0) {
+        close(job->stdin_fd);
+        job->stdin_fd = -1;
+    }
+    job_close_monitor(job);
+    job_remove_temporaries(job);
+
+    if (job->state == JOB_CANCELLING) {
+        job->state = JOB_CANCELLED;
+        job_remove_partial_output(job);
+        nob_log(NOB_INFO, "%s: cancelled", job->params.input_path);
+        return;
+    }
+
+    if (exit_code != 0) {
+        job->state = JOB_FAILED;
+        job_remove_partial_output(job);
+        nob_log(NOB_ERROR, "%s: ffmpeg exited with code %d: %s", job->params.input_path, exit_code, job->last_error);
+        return;
+    }
+
+    if (rename(job->part_path, job->params.output_path) < 0) {
+        job->state = JOB_FAILED;
+        snprintf(job->last_error, sizeof(job->last_error), "could not rename %s: %s", job->part_path, strerror(errno));
+        nob_log(NOB_ERROR, "%s: %s", job->params.input_path, job->last_error);
+        return;
+    }
+
+    job->state = JOB_DONE;
+    if (job->cache_keyed && !jobs->results_disabled) result_cache_store(&jobs->results, job->cache_key, job->params.output_path);
+    double wall = job_elapsed(job, job->finished_at);
+    nob_log(NOB_INFO, "%s: done in %.1fs, predicted %.1fs", job->params.input_path, wall, job->predicted);
+    if (job->params.screen_recording) {
+        nob_log(NOB_INFO, "%s: %.0f%% of the frames dropped, %.1fx the predicted speed without decimation",
+                job->params.input_path, job_frame_reduction(job)*100, job_speedup(job));
+    }
+    // A smart render spends most of its time copying, it says nothing about the encoder.
+    if (job->work > 0 && wall > 0 && !job->params.smart_render) {
+        char profile[64];
+        ffmpeg_params_profile(job->params, profile, sizeof(profile));
+        size_t threads = job->threads > 0 ? job->threads : thread_budget_total(&jobs->thread_budget);
+        throughput_history_record(&jobs->history, profile, job->work / (wall * threads));
+        throughput_history_save(&jobs->history);
+    }
+}
+
+
+// Comparing the pieces of a smart render runs ffprobe on each of them, so it waits for the pool
+// like the probe of the input. There is no process in the meantime, signals go nowhere.
+typedef struct {
+    Jobs *jobs;
+    size_t id;
+    FfmpegParams params;
+    bool match;
+    char reason[256];
+} Job_Pieces_Task;
+
+
+static void job_pieces_work(void *arg) {
+    Job_Pieces_Task *task = arg;
+    task->match = trim_smart_pieces_match(task->params, task->reason, sizeof(task->reason));
+}
+
+
+static void job_pieces_done(void *arg) {
+    Job_Pieces_Task *task = arg;
+    Job *job = &task->jobs->items[task->id];
+    if (job->state == JOB_CANCELLING) {
+        job_finish(task->jobs, job, 1);
+    } else if (job->state != JOB_RUNNING) {
+        // Shut down in the meantime, the pieces are gone already.
+    } else if (!task->match) {
+        snprintf(job->last_error, sizeof(job->last_error), "smart render pieces differ: %s", task->reason);
+        job_finish(task->jobs, job, 1);
+    } else if (!job_spawn(job)) {
+        snprintf(job->last_error, sizeof(job->last_error), "could not start ffmpeg");
+        job_finish(task->jobs, job, 1);
+    }
+    free(task);
+}
+
+
+// Escalates a cancel that ffmpeg ignores, e.g. when it is stuck on a network input.
+static void job_escalate_cancel(Job *job, uint64_t now) {
+    double waited = (double)(now - job->cancel_requested_at) / NOB_NANOS_PER_SEC;
+    if (job->cancel_signal == 0 && waited > JOB_CANCEL_TIMEOUT) {
+        job->cancel_signal = SIGTERM;
+        launcher_signal(job->pid, SIGTERM);
+    } else if (job->cancel_signal == SIGTERM && waited > 2*JOB_CANCEL_TIMEOUT) {
+        job->cancel_signal = SIGKILL;
+        launcher_signal(job->pid, SIGKILL);
+    }
+}
+
+
+void jobs_update(Jobs *jobs) {
+    Launcher_Event event;
+    while (launcher_poll(&event)) {
+        if (event.job_id >= jobs->count) continue;
+        Job *job = &jobs->items[event.job_id];
+        switch (event.kind) {
+        case LAUNCHER_EVENT_STDOUT:
+            job_parse_progress(job, event.line);
+            break;
+        case LAUNCHER_EVENT_STDERR:
+            memcpy(job->last_error, event.line, sizeof(job->last_error));
+            break;
+        case LAUNCHER_EVENT_EXIT:
+            if (event.exit_code == 0 && job->state == JOB_RUNNING && job->params.smart_render && job->step + 1 < TRIM_STEP_COUNT) {
+                if (job->stdin_fd >= 0) close(job->stdin_fd);
+                job->stdin_fd = -1;
+                job->step += 1;
+                job->out_time = 0;
+                if (job->step == TRIM_STEP_CONCAT) {
+                    job->pid = -1;
+                    Job_Pieces_Task *task = calloc(1, sizeof(*task));
+                    task->jobs = jobs;
+                    task->id = job->id;
+                    task->params = job->params;
+                    task->params.output_path = job->part_path;
+                    pool_submit(job_pieces_work, job_pieces_done, task);
+                    break;
+                }
+                if (job_spawn(job)) break;
+                snprintf(job->last_error, sizeof(job->last_error), "could not start ffmpeg");
+                job_finish(jobs, job, 1);
+                break;
+            }
+            job_finish(jobs, job, event.exit_code);
+            break;
+        }
+    }
+
+    uint64_t now = nob_nanos_since_unspecified_epoch();
+    for (size_t i = 0; i < jobs->count; ++i) {
+        if (jobs->items[i].state == JOB_CANCELLING) job_escalate_cancel(&jobs->items[i], now);
+        job_read_monitor(&jobs->items[i]);
+    }
+
+    if (jobs->batch_started_at > 0 && jobs_finished(jobs)) {
+        jobs->last_batch_predicted = jobs->batch_predicted;
+        jobs->last_batch_actual = (double)(now - jobs->batch_started_at) / NOB_NANOS_PER_SEC;
+        jobs->batch_started_at = 0;
+        nob_log(NOB_INFO, "batch done in %.1fs, predicted %.1fs", jobs->last_batch_actual, jobs->last_batch_predicted);
+    }
+
+    size_t max_running = jobs_max_running(jobs);
+    size_t running = jobs_running_count(jobs);
+    size_t queued = 0;
+    for (size_t i = 0; i < jobs->count; ++i) {
+        if (jobs->items[i].state == JOB_QUEUED && jobs->items[i].probed) queued += 1;
+    }
+
+    // Every job starting in this round gets an equal share of the threads that are free now.
+    // Longest predicted job first, the same order jobs_predict() schedules the batch in, so it
+    // doesn't end with one big file running alone on an idle machine. The predictions are
+    // refreshed first, the jobs that finished since may have changed the throughput history.
+    // Jobs that couldn't be probed have no cost and go last.
+    size_t starting = running < max_running ? max_running - running : 0;
+    if (starting > queued) starting = queued;
+    if (starting > 0) jobs_predict(jobs);
+    for (; starting > 0; --starting) {
+        Job *longest = NULL;
+        for (size_t i = 0; i < jobs->count; ++i) {
+            Job *job = &jobs->items[i];
+            if (job->state != JOB_QUEUED || !job->probed) continue;
+            if (longest == NULL || job->predicted > longest->predicted) longest = job;
+        }
+        job_start(jobs, longest, starting);
+    }
+}
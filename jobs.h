@@ -0,0 +1,119 @@
+#ifndef JOBS_H_
+#define JOBS_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "./ffmpeg.h"
+#include "./launcher.h"
+#include "./probe.h"
+#include "./result_cache.h"
+#include "./scheduler.h"
+
+typedef enum {
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_PAUSED,
+    JOB_CANCELLING,
+    JOB_DONE,
+    JOB_FAILED,
+    JOB_CANCELLED,
+} Job_State;
+
+typedef struct {
+    size_t id; // index in Jobs, jobs are never removed
+    FfmpegParams params; // owns input_path and output_path
+    char *part_path; // ffmpeg writes here, renamed to output_path only when it succeeds
+    Job_State state;
+    Probe probe;
+    Probe *parts; // one per part of a join, NULL otherwise
+    bool probed; // the probe runs on the pool, the job isn't started before it's back
+    Result_Cache_Key cache_key; // of the inputs and settings, computed along with the probe
+    bool cache_keyed; // false when the inputs couldn't be read for the key
+    double work; // output pixels times seconds, 0 for stream copies and when the input couldn't be probed
+    double predicted; // seconds, with the thread share the job is expected to get
+    double plain_predicted; // seconds the same encode would take without the screen recording profile
+    pid_t pid;
+    int stdin_fd; // write end of ffmpeg's stdin, -1 when not running
+    int monitor_fd; // read end of the monitor tap, -1 when there is none
+    unsigned char *monitor_frame; // latest complete frame of the tap, FFMPEG_MONITOR_FRAME_SIZE bytes of RGBA
+    unsigned char *monitor_partial; // the frame coming in
+    size_t monitor_filled; // bytes of monitor_partial
+    size_t monitor_frames; // frames received so far, to tell when monitor_frame changed
+    size_t step; // Trim_Step of a smart render
+    uint64_t paused_at; // 0 unless paused
+    uint64_t paused_for; // nanoseconds spent paused, not part of the encode time
+    uint64_t cancel_requested_at;
+    int cancel_signal; // last signal sent while cancelling, 0 after just "q"
+    size_t threads; // share of the thread budget, 0 while queued
+    uint64_t started_at; // nob_nanos_since_unspecified_epoch()
+    uint64_t finished_at;
+    double out_time; // seconds of output written so far, from -progress
+    double speed; // realtime multiplier, from -progress
+    int64_t frames; // frames written so far, from -progress
+    uint64_t rss; // bytes, sampled by the controller
+    uint64_t cpu_ticks; // utime+stime at the last sample
+    double cpu_usage; // cores in use
+    int exit_code;
+    char last_error[LAUNCHER_LINE_SIZE]; // last line ffmpeg printed to stderr
+} Job;
+
+typedef struct {
+    Job *items;
+    size_t count;
+    size_t capacity;
+    size_t max_running; // 0 means thread_budget_default_concurrency()
+    Thread_Budget thread_budget;
+
+    Throughput_History history;
+    bool history_loaded;
+    Result_Cache results;
+    bool results_disabled; // every job encodes and nothing is stored, for benchmarks
+    uint64_t batch_started_at; // 0 while idle
+    double batch_predicted; // seconds from batch_started_at
+    double last_batch_predicted;
+    double last_batch_actual;
+} Jobs;
+
+const char *job_state_name(Job_State state);
+
+// Queues an encode and probes its input in the background to estimate the cost. The paths in
+// `params` are copied. `jobs` must stay where it is until the pool is shut down.
+size_t jobs_submit(Jobs *jobs, FfmpegParams params);
+
+// Predicted time of running `params` on an input described by `probe`, with a default thread share.
+double jobs_estimate(Jobs *jobs, FfmpegParams params, const Probe *probe);
+
+// Share of the input frames the screen recording profile dropped so far, 0 for other jobs and
+// before there is any progress.
+double job_frame_reduction(const Job *job);
+
+// Predicted encode time without the screen recording profile over the actual one, 0 until a
+// screen recording job is done.
+double job_speedup(const Job *job);
+
+// Processes the launcher events and starts queued jobs while there is room. Call once per frame.
+void jobs_update(Jobs *jobs);
+
+// Running and cancelling jobs, the ones that hold a share of the thread budget.
+size_t jobs_running_count(const Jobs *jobs);
+
+// True when no job is queued, running or paused.
+bool jobs_finished(const Jobs *jobs);
+
+// SIGSTOP/SIGCONT the process group of a job. A paused job gives its threads back and doesn't
+// count towards the concurrency, so other work can run in the meantime. Resuming takes them
+// back even if that goes over the budget for a while.
+bool jobs_pause(Jobs *jobs, size_t id);
+bool jobs_resume(Jobs *jobs, size_t id);
+
+// Asks ffmpeg to stop with "q" on stdin, escalates to SIGTERM and then SIGKILL if it doesn't
+// exit in time. The partial output is removed. Queued jobs are cancelled right away.
+bool jobs_cancel(Jobs *jobs, size_t id);
+
+// Terminates everything still running and removes the partial outputs. For quitting.
+void jobs_shutdown(Jobs *jobs);
+
+void jobs_free(Jobs *jobs);
+
+#endif // JOBS_H_
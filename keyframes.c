@@ -0,0 +1,245 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./cache.h"
+#include "./container.h"
+#include "./keyframes.h"
+#include "./launcher.h"
+
+#define KEYFRAMES_MAGIC "VPKF"
+#define KEYFRAMES_VERSION 1
+
+typedef struct {
+    const uint8_t *data;
+    size_t count;
+    bool ok;
+} Keyframes_Reader;
+
+
+static void keyframes_put_varint(Nob_String_Builder *sb, uint64_t value) {
+    while (value >= 0x80) {
+        nob_da_append(sb, (char)(value | 0x80));
+        value >>= 7;
+    }
+    nob_da_append(sb, (char) value);
+}
+
+
+static uint64_t keyframes_get_varint(Keyframes_Reader *r) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (r->count == 0) break;
+        uint8_t byte = *r->data++;
+        r->count -= 1;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return value;
+    }
+    r->ok = false;
+    return 0;
+}
+
+
+// Deltas of the byte offsets can be negative when pts and decode order differ.
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t)(value >> 63);
+}
+
+
+static int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+
+// The path is stored in the file as well, to catch collisions.
+static bool keyframes_cache_path(char *cache, size_t size, const char *path, const struct stat *st) {
+    char name[64];
+    snprintf(name, sizeof(name), "keyframes-%016" PRIx64 ".idx", cache_input_key(path, st));
+    return cache_path(cache, size, name);
+}
+
+
+static int64_t keyframes_us(double seconds) {
+    return (int64_t)(seconds*1e6 + (seconds < 0 ? -0.5 : 0.5));
+}
+
+
+static bool keyframes_read(const char *cache, const char *path, const struct stat *st, Keyframe_Index *index) {
+    if (access(cache, R_OK) < 0) return false; // not indexed yet
+    Nob_String_Builder sb = {0};
+    if (!nob_read_entire_file(cache, &sb)) return false;
+
+    bool result = true;
+    Keyframes_Reader r = {(const uint8_t*) sb.items, sb.count, true};
+    size_t magic = strlen(KEYFRAMES_MAGIC);
+    if (r.count < magic || memcmp(r.data, KEYFRAMES_MAGIC, magic) != 0) nob_return_defer(false);
+    r.data += magic;
+    r.count -= magic;
+
+    if (keyframes_get_varint(&r) != KEYFRAMES_VERSION) nob_return_defer(false);
+    if (keyframes_get_varint(&r) != (uint64_t) st->st_size) nob_return_defer(false);
+    if (keyframes_get_varint(&r) != cache_mtime(st)) nob_return_defer(false);
+    uint64_t path_len = keyframes_get_varint(&r);
+    if (!r.ok || path_len != strlen(path) || path_len > r.count || memcmp(r.data, path, path_len) != 0) nob_return_defer(false);
+    r.data += path_len;
+    r.count -= path_len;
+
+    uint64_t count = keyframes_get_varint(&r);
+    // every keyframe takes at least two bytes
+    if (!r.ok || count > r.count / 2) nob_return_defer(false);
+    Keyframe prev = {0};
+    for (uint64_t i = 0; i < count && r.ok; ++i) {
+        Keyframe kf = {
+            .pts = prev.pts + unzigzag(keyframes_get_varint(&r)),
+            .pos = prev.pos + unzigzag(keyframes_get_varint(&r)),
+        };
+        nob_da_append(index, kf);
+        prev = kf;
+    }
+    if (!r.ok) nob_return_defer(false);
+
+defer:
+    if (!result) index->count = 0;
+    nob_sb_free(sb);
+    return result;
+}
+
+
+static bool keyframes_write(const char *cache, const char *path, const struct stat *st, const Keyframe_Index *index) {
+    Nob_String_Builder sb = {0};
+    nob_sb_append_cstr(&sb, KEYFRAMES_MAGIC);
+    keyframes_put_varint(&sb, KEYFRAMES_VERSION);
+    keyframes_put_varint(&sb, (uint64_t) st->st_size);
+    keyframes_put_varint(&sb, cache_mtime(st));
+    keyframes_put_varint(&sb, strlen(path));
+    nob_sb_append_cstr(&sb, path);
+    keyframes_put_varint(&sb, index->count);
+    Keyframe prev = {0};
+    for (size_t i = 0; i < index->count; ++i) {
+        keyframes_put_varint(&sb, zigzag(index->items[i].pts - prev.pts));
+        keyframes_put_varint(&sb, zigzag(index->items[i].pos - prev.pos));
+        prev = index->items[i];
+    }
+
+    bool result = cache_write_atomic(cache, sb.items, sb.count);
+    nob_sb_free(sb);
+    return result;
+}
+
+
+static int compare_keyframes(const void *a, const void *b) {
+    int64_t x = ((const Keyframe*) a)->pts;
+    int64_t y = ((const Keyframe*) b)->pts;
+    return (x > y) - (x < y);
+}
+
+
+// Packets are listed without decoding anything, one `pts_time,pos,flags` line each:
+//   2.002000,184320,K__
+bool keyframe_index_ffprobe(const char *path, Keyframe_Index *index) {
+    Nob_Cmd cmd = {0};
+    Nob_String_Builder out = {0};
+    nob_cmd_append(&cmd, "ffprobe", "-v", "error", "-select_streams", "v:0");
+    nob_cmd_append(&cmd, "-show_entries", "packet=pts_time,pos,flags");
+    nob_cmd_append(&cmd, "-of", "csv=p=0", path);
+    bool ok = launcher_run_sync(cmd, &out);
+    nob_cmd_free(cmd);
+    if (!ok) {
+        nob_log(NOB_ERROR, "could not index the keyframes of %s", path);
+        nob_sb_free(out);
+        return false;
+    }
+
+    Nob_String_View output = nob_sb_to_sv(out);
+    while (output.count > 0) {
+        Nob_String_View line = nob_sv_trim(nob_sv_chop_by_delim(&output, '\n'));
+        Nob_String_View pts_time = nob_sv_chop_by_delim(&line, ',');
+        Nob_String_View pos = nob_sv_chop_by_delim(&line, ',');
+        if (line.count == 0 || line.data[0] != 'K') continue;
+
+        char value[64];
+        if (pts_time.count == 0 || pts_time.count >= sizeof(value)) continue;
+        memcpy(value, pts_time.data, pts_time.count);
+        value[pts_time.count] = '\0';
+        char *end;
+        double seconds = strtod(value, &end);
+        if (end == value) continue; // N/A
+
+        Keyframe kf = {.pts = keyframes_us(seconds), .pos = -1};
+        if (pos.count > 0 && pos.count < sizeof(value)) {
+            memcpy(value, pos.data, pos.count);
+            value[pos.count] = '\0';
+            kf.pos = strtoll(value, &end, 10);
+            if (end == value) kf.pos = -1;
+        }
+        nob_da_append(index, kf);
+    }
+    nob_sb_free(out);
+
+    // Packets come in decode order.
+    qsort(index->items, index->count, sizeof(*index->items), compare_keyframes);
+    return true;
+}
+
+
+bool keyframe_index_load(const char *path, Keyframe_Index *index) {
+    index->count = 0;
+    struct stat st;
+    if (stat(path, &st) < 0) {
+        nob_log(NOB_ERROR, "could not stat %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    // Reading the sample tables of MP4s and AVIs is about as cheap as reading the cache file.
+    Container_Info info;
+    if (container_parse(path, &info, true) && info.keyframes.count > 0) {
+        nob_da_append_many(index, info.keyframes.items, info.keyframes.count);
+        container_info_free(&info);
+        return true;
+    }
+    container_info_free(&info);
+
+    char cache[1024];
+    bool cached = keyframes_cache_path(cache, sizeof(cache), path, &st);
+    if (cached && keyframes_read(cache, path, &st, index)) return true;
+
+    if (!keyframe_index_ffprobe(path, index)) return false;
+    if (cached) keyframes_write(cache, path, &st, index);
+    return true;
+}
+
+
+const Keyframe *keyframe_index_at_or_before(const Keyframe_Index *index, double seconds) {
+    int64_t pts = keyframes_us(seconds);
+    // first keyframe after pts
+    size_t lo = 0, hi = index->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo)/2;
+        if (index->items[mid].pts <= pts) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo > 0 ? &index->items[lo - 1] : NULL;
+}
+
+
+const Keyframe *keyframe_index_at_or_after(const Keyframe_Index *index, double seconds) {
+    int64_t pts = keyframes_us(seconds);
+    // first keyframe at or after pts
+    size_t lo = 0, hi = index->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo)/2;
+        if (index->items[mid].pts < pts) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < index->count ? &index->items[lo] : NULL;
+}
+
+
+void keyframe_index_free(Keyframe_Index *index) {
+    nob_da_free(*index);
+    memset(index, 0, sizeof(*index));
+}
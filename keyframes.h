@@ -0,0 +1,43 @@
+#ifndef KEYFRAMES_H_
+#define KEYFRAMES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Keyframe positions of the first video stream of an input, for seeking and GOP-aligned cuts.
+//
+// MP4/MOV and AVI files carry them in their indexes, which container_parse() reads directly.
+// For everything else finding them means reading every packet of the file with ffprobe, which
+// takes a while for long inputs, so that index is built once and kept in the cache directory,
+// keyed by the path, size and mtime of the input. On disk the keyframes are delta-encoded
+// varints, a couple of bytes each.
+
+typedef struct {
+    int64_t pts; // microseconds
+    int64_t pos; // byte offset of the packet in the file, -1 when the demuxer doesn't know it
+} Keyframe;
+
+typedef struct {
+    Keyframe *items; // sorted by pts
+    size_t count;
+    size_t capacity;
+} Keyframe_Index;
+
+// Reads the index of `path` from its container, or loads it from the cache, or builds it with
+// ffprobe and stores it when there is none or the input changed since. Doesn't use the temporary allocator, so it's safe to call from any thread.
+bool keyframe_index_load(const char *path, Keyframe_Index *index);
+
+// Lists the keyframe packets with ffprobe, without touching the cache.
+bool keyframe_index_ffprobe(const char *path, Keyframe_Index *index);
+
+// The last keyframe at or before `seconds`, in O(log n). NULL when `seconds` is before the
+// first keyframe or the index is empty.
+const Keyframe *keyframe_index_at_or_before(const Keyframe_Index *index, double seconds);
+
+// The first keyframe at or after `seconds`. NULL when there is none.
+const Keyframe *keyframe_index_at_or_after(const Keyframe_Index *index, double seconds);
+
+void keyframe_index_free(Keyframe_Index *index);
+
+#endif // KEYFRAMES_H_
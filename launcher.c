@@ -0,0 +1,499 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "./launcher.h"
+
+extern char **environ;
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+typedef enum {
+    SOURCE_STDOUT,
+    SOURCE_STDERR,
+    SOURCE_PIDFD,
+    SOURCE_WAKEUP,
+} Source;
+
+#define EPOLL_DATA(slot, source) (((uint64_t)(slot) << 2) | (source))
+
+typedef struct {
+    int fd;
+    char buf[LAUNCHER_LINE_SIZE];
+    size_t len;
+} Launcher_Pipe;
+
+typedef struct {
+    atomic_bool used;
+    size_t job_id;
+    pid_t pid;
+    int pidfd;
+    Launcher_Pipe pipes[2]; // indexed by SOURCE_STDOUT/SOURCE_STDERR
+} Launcher_Proc;
+
+static struct {
+    bool running;
+    pthread_t monitor;
+    int epfd;
+    int wakefd;
+    atomic_bool stop;
+    Launcher_Proc procs[LAUNCHER_MAX_PROCS];
+
+    Launcher_Event events[LAUNCHER_QUEUE_CAPACITY];
+    atomic_size_t head; // advanced by the consumer (UI thread)
+    atomic_size_t tail; // advanced by the producer (monitor thread)
+} launcher = {0};
+
+
+static void launcher_push(const Launcher_Event *event) {
+    size_t tail = atomic_load_explicit(&launcher.tail, memory_order_relaxed);
+    // The UI drains the queue every frame, so being full is rare. Wait instead of dropping
+    // because the exit event of a job must never get lost.
+    while (tail - atomic_load_explicit(&launcher.head, memory_order_acquire) >= LAUNCHER_QUEUE_CAPACITY) {
+        if (atomic_load(&launcher.stop)) return;
+        nanosleep(&(struct timespec){.tv_nsec = 1000*1000}, NULL);
+    }
+    launcher.events[tail & (LAUNCHER_QUEUE_CAPACITY - 1)] = *event;
+    atomic_store_explicit(&launcher.tail, tail + 1, memory_order_release);
+}
+
+
+bool launcher_poll(Launcher_Event *event) {
+    size_t head = atomic_load_explicit(&launcher.head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&launcher.tail, memory_order_acquire)) return false;
+    *event = launcher.events[head & (LAUNCHER_QUEUE_CAPACITY - 1)];
+    atomic_store_explicit(&launcher.head, head + 1, memory_order_release);
+    return true;
+}
+
+
+static void launcher_flush_line(Launcher_Proc *proc, Source source) {
+    Launcher_Pipe *pipe = &proc->pipes[source];
+    if (pipe->len == 0) return;
+
+    Launcher_Event event = {
+        .kind = source == SOURCE_STDOUT ? LAUNCHER_EVENT_STDOUT : LAUNCHER_EVENT_STDERR,
+        .job_id = proc->job_id,
+        .pid = proc->pid,
+    };
+    memcpy(event.line, pipe->buf, pipe->len);
+    event.line[pipe->len] = '\0';
+    pipe->len = 0;
+    launcher_push(&event);
+}
+
+
+static void launcher_close_pipe(Launcher_Proc *proc, Source source) {
+    Launcher_Pipe *pipe = &proc->pipes[source];
+    if (pipe->fd < 0) return;
+    launcher_flush_line(proc, source);
+    epoll_ctl(launcher.epfd, EPOLL_CTL_DEL, pipe->fd, NULL);
+    close(pipe->fd);
+    pipe->fd = -1;
+}
+
+
+// Reads everything that is currently available. ffmpeg terminates its status lines
+// with '\r', so both '\r' and '\n' end a line.
+static void launcher_drain(Launcher_Proc *proc, Source source) {
+    Launcher_Pipe *pipe = &proc->pipes[source];
+    char chunk[4096];
+    while (pipe->fd >= 0) {
+        ssize_t n = read(pipe->fd, chunk, sizeof(chunk));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) return;
+            nob_log(NOB_ERROR, "could not read output of process %d: %s", proc->pid, strerror(errno));
+            launcher_close_pipe(proc, source);
+            return;
+        }
+        if (n == 0) {
+            launcher_close_pipe(proc, source);
+            return;
+        }
+        for (ssize_t i = 0; i < n; ++i) {
+            if (chunk[i] == '\n' || chunk[i] == '\r') {
+                launcher_flush_line(proc, source);
+                continue;
+            }
+            pipe->buf[pipe->len++] = chunk[i];
+            if (pipe->len == LAUNCHER_LINE_SIZE - 1) launcher_flush_line(proc, source);
+        }
+    }
+}
+
+
+static void launcher_reap(Launcher_Proc *proc) {
+    launcher_drain(proc, SOURCE_STDOUT);
+    launcher_drain(proc, SOURCE_STDERR);
+    launcher_close_pipe(proc, SOURCE_STDOUT);
+    launcher_close_pipe(proc, SOURCE_STDERR);
+
+    int wstatus = 0;
+    int exit_code = -1;
+    while (waitpid(proc->pid, &wstatus, 0) < 0) {
+        if (errno == EINTR) continue;
+        nob_log(NOB_ERROR, "could not wait on process %d: %s", proc->pid, strerror(errno));
+        break;
+    }
+    if (WIFEXITED(wstatus)) exit_code = WEXITSTATUS(wstatus);
+    if (WIFSIGNALED(wstatus)) exit_code = 128 + WTERMSIG(wstatus);
+
+    if (proc->pidfd >= 0) {
+        epoll_ctl(launcher.epfd, EPOLL_CTL_DEL, proc->pidfd, NULL);
+        close(proc->pidfd);
+        proc->pidfd = -1;
+    }
+
+    Launcher_Event event = {
+        .kind = LAUNCHER_EVENT_EXIT,
+        .job_id = proc->job_id,
+        .pid = proc->pid,
+        .exit_code = exit_code,
+    };
+    launcher_push(&event);
+    atomic_store(&proc->used, false);
+}
+
+
+static void *launcher_monitor(void *arg) {
+    (void) arg;
+    struct epoll_event events[32];
+    while (!atomic_load(&launcher.stop)) {
+        int n = epoll_wait(launcher.epfd, events, NOB_ARRAY_LEN(events), -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            nob_log(NOB_ERROR, "could not wait on processes: %s", strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            size_t slot = events[i].data.u64 >> 2;
+            Source source = events[i].data.u64 & 3;
+            if (source == SOURCE_WAKEUP) {
+                uint64_t value;
+                (void) !read(launcher.wakefd, &value, sizeof(value));
+                continue;
+            }
+
+            Launcher_Proc *proc = &launcher.procs[slot];
+            if (!atomic_load(&proc->used)) continue;
+            if (source == SOURCE_PIDFD) {
+                launcher_reap(proc);
+                continue;
+            }
+            launcher_drain(proc, source);
+            // Without pidfd the only exit notification is both pipes hitting EOF.
+            if (proc->pidfd < 0 && proc->pipes[SOURCE_STDOUT].fd < 0 && proc->pipes[SOURCE_STDERR].fd < 0) {
+                launcher_reap(proc);
+            }
+        }
+    }
+    return NULL;
+}
+
+
+bool launcher_init(void) {
+    if (launcher.running) return true;
+
+    // Writing to the stdin of a process that just exited must not kill us.
+    signal(SIGPIPE, SIG_IGN);
+
+    launcher.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (launcher.epfd < 0) {
+        nob_log(NOB_ERROR, "could not create epoll instance: %s", strerror(errno));
+        return false;
+    }
+    launcher.wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (launcher.wakefd < 0) {
+        nob_log(NOB_ERROR, "could not create eventfd: %s", strerror(errno));
+        close(launcher.epfd);
+        return false;
+    }
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = EPOLL_DATA(0, SOURCE_WAKEUP)};
+    epoll_ctl(launcher.epfd, EPOLL_CTL_ADD, launcher.wakefd, &ev);
+
+    atomic_store(&launcher.stop, false);
+    int ret = pthread_create(&launcher.monitor, NULL, launcher_monitor, NULL);
+    if (ret != 0) {
+        nob_log(NOB_ERROR, "could not start process monitor thread: %s", strerror(ret));
+        close(launcher.wakefd);
+        close(launcher.epfd);
+        return false;
+    }
+    launcher.running = true;
+    return true;
+}
+
+
+void launcher_shutdown(void) {
+    if (!launcher.running) return;
+
+    atomic_store(&launcher.stop, true);
+    uint64_t one = 1;
+    (void) !write(launcher.wakefd, &one, sizeof(one));
+    pthread_join(launcher.monitor, NULL);
+
+    for (size_t i = 0; i < LAUNCHER_MAX_PROCS; ++i) {
+        Launcher_Proc *proc = &launcher.procs[i];
+        if (!atomic_load(&proc->used)) continue;
+        nob_log(NOB_WARNING, "terminating process %d", proc->pid);
+        kill(-proc->pid, SIGCONT);
+        kill(-proc->pid, SIGTERM);
+        launcher_reap(proc);
+    }
+
+    close(launcher.wakefd);
+    close(launcher.epfd);
+    launcher.running = false;
+}
+
+
+pid_t launcher_spawn(Nob_Cmd cmd, size_t job_id, int *stdin_fd, int *tap_fd) {
+    pid_t result = -1;
+    int in[2] = {-1, -1};
+    int tap[2] = {-1, -1};
+    int out[2] = {-1, -1};
+    int err[2] = {-1, -1};
+    Nob_Cmd argv = {0};
+    posix_spawn_file_actions_t actions;
+    bool actions_initialized = false;
+    posix_spawnattr_t attr;
+    bool attr_initialized = false;
+    Launcher_Proc *proc = NULL;
+    size_t slot = 0;
+
+    if (!launcher.running) {
+        nob_log(NOB_ERROR, "launcher is not running");
+        return -1;
+    }
+    if (cmd.count < 1) {
+        nob_log(NOB_ERROR, "could not run empty command");
+        return -1;
+    }
+
+    for (slot = 0; slot < LAUNCHER_MAX_PROCS; ++slot) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&launcher.procs[slot].used, &expected, true)) {
+            proc = &launcher.procs[slot];
+            break;
+        }
+    }
+    if (proc == NULL) {
+        nob_log(NOB_ERROR, "could not run more than %d processes at once", LAUNCHER_MAX_PROCS);
+        return -1;
+    }
+
+    if (pipe2(out, O_CLOEXEC) < 0 || pipe2(err, O_CLOEXEC) < 0 || (stdin_fd && pipe2(in, O_CLOEXEC) < 0) || (tap_fd && pipe2(tap, O_CLOEXEC) < 0)) {
+        nob_log(NOB_ERROR, "could not create pipes: %s", strerror(errno));
+        nob_return_defer(-1);
+    }
+    // Only our ends are non-blocking, the child gets ordinary blocking stdout/stderr.
+    fcntl(out[0], F_SETFL, O_NONBLOCK);
+    fcntl(err[0], F_SETFL, O_NONBLOCK);
+    if (tap_fd) {
+        fcntl(tap[0], F_SETFL, O_NONBLOCK);
+        // Room for a few chunks, so the writer doesn't stall whenever the reader is a frame late.
+        fcntl(tap[1], F_SETPIPE_SZ, LAUNCHER_TAP_PIPE_SIZE);
+    }
+
+    posix_spawn_file_actions_init(&actions);
+    actions_initialized = true;
+    if (stdin_fd) {
+        posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+    } else {
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    }
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err[1], STDERR_FILENO);
+    if (tap_fd) posix_spawn_file_actions_adddup2(&actions, tap[1], LAUNCHER_TAP_FD);
+
+    // A process group of its own, so pause/cancel reach everything the command starts.
+    posix_spawnattr_init(&attr);
+    attr_initialized = true;
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    Nob_String_Builder sb = {0};
+    nob_cmd_render(cmd, &sb);
+    nob_sb_append_null(&sb);
+    nob_log(NOB_INFO, "CMD: %s", sb.items);
+    nob_sb_free(sb);
+
+    nob_da_append_many(&argv, cmd.items, cmd.count);
+    nob_cmd_append(&argv, NULL);
+
+    pid_t pid;
+    int ret = posix_spawnp(&pid, argv.items[0], &actions, &attr, (char * const*) argv.items, environ);
+    if (ret != 0) {
+        nob_log(NOB_ERROR, "could not spawn %s: %s", argv.items[0], strerror(ret));
+        nob_return_defer(-1);
+    }
+    close(out[1]); out[1] = -1;
+    close(err[1]); err[1] = -1;
+    if (stdin_fd) {
+        close(in[0]); in[0] = -1;
+        *stdin_fd = in[1];
+        in[1] = -1;
+    }
+    if (tap_fd) {
+        close(tap[1]); tap[1] = -1;
+        *tap_fd = tap[0];
+        tap[0] = -1;
+    }
+
+    int pidfd = syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd < 0) {
+        nob_log(NOB_WARNING, "pidfd_open is not available (%s), waiting for EOF instead", strerror(errno));
+    }
+    proc->job_id = job_id;
+    proc->pid = pid;
+    proc->pidfd = pidfd;
+    proc->pipes[SOURCE_STDOUT] = (Launcher_Pipe){.fd = out[0]};
+    proc->pipes[SOURCE_STDERR] = (Launcher_Pipe){.fd = err[0]};
+
+    // The monitor thread may start touching the slot as soon as the first fd is registered.
+    // The pidfd goes last so the process can't be reaped before its pipes are in the set.
+    struct epoll_event ev = {.events = EPOLLIN};
+    ev.data.u64 = EPOLL_DATA(slot, SOURCE_STDOUT);
+    epoll_ctl(launcher.epfd, EPOLL_CTL_ADD, out[0], &ev);
+    ev.data.u64 = EPOLL_DATA(slot, SOURCE_STDERR);
+    epoll_ctl(launcher.epfd, EPOLL_CTL_ADD, err[0], &ev);
+    if (pidfd >= 0) {
+        ev.data.u64 = EPOLL_DATA(slot, SOURCE_PIDFD);
+        epoll_ctl(launcher.epfd, EPOLL_CTL_ADD, pidfd, &ev);
+    }
+    out[0] = -1;
+    err[0] = -1;
+
+    result = pid;
+
+defer:
+    if (actions_initialized) posix_spawn_file_actions_destroy(&actions);
+    if (attr_initialized) posix_spawnattr_destroy(&attr);
+    for (size_t i = 0; i < 2; ++i) {
+        if (in[i] >= 0) close(in[i]);
+        if (out[i] >= 0) close(out[i]);
+        if (err[i] >= 0) close(err[i]);
+        if (tap[i] >= 0) close(tap[i]);
+    }
+    nob_cmd_free(argv);
+    if (result < 0) atomic_store(&proc->used, false);
+    return result;
+}
+
+
+bool launcher_signal(pid_t pid, int sig) {
+    if (pid <= 0) return false;
+    if (kill(-pid, sig) < 0) {
+        nob_log(NOB_ERROR, "could not send signal %d to process group %d: %s", sig, pid, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+
+bool launcher_run_sync(Nob_Cmd cmd, Nob_String_Builder *out) {
+    return launcher_run_sync_cancellable(cmd, out, NULL);
+}
+
+
+static bool launcher_sink_sb(const char *data, size_t size, void *arg) {
+    nob_sb_append_buf((Nob_String_Builder*) arg, data, size);
+    return true;
+}
+
+
+bool launcher_run_sync_cancellable(Nob_Cmd cmd, Nob_String_Builder *out, const atomic_bool *cancel) {
+    return launcher_run_sync_streaming(cmd, STDOUT_FILENO, launcher_sink_sb, out, cancel);
+}
+
+
+bool launcher_run_sync_streaming(Nob_Cmd cmd, int source, Launcher_Sink sink, void *arg, const atomic_bool *cancel) {
+    bool result = true;
+    int pipefd[2] = {-1, -1};
+    Nob_Cmd argv = {0};
+    posix_spawn_file_actions_t actions;
+    bool actions_initialized = false;
+
+    if (cmd.count < 1) {
+        nob_log(NOB_ERROR, "could not run empty command");
+        return false;
+    }
+    if (pipe2(pipefd, O_CLOEXEC) < 0) {
+        nob_log(NOB_ERROR, "could not create pipe: %s", strerror(errno));
+        nob_return_defer(false);
+    }
+
+    posix_spawn_file_actions_init(&actions);
+    actions_initialized = true;
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, pipefd[1], source);
+
+    nob_da_append_many(&argv, cmd.items, cmd.count);
+    nob_cmd_append(&argv, NULL);
+
+    pid_t pid;
+    int ret = posix_spawnp(&pid, argv.items[0], &actions, NULL, (char * const*) argv.items, environ);
+    if (ret != 0) {
+        nob_log(NOB_ERROR, "could not spawn %s: %s", argv.items[0], strerror(ret));
+        nob_return_defer(false);
+    }
+    close(pipefd[1]);
+    pipefd[1] = -1;
+
+    char chunk[4096];
+    for (;;) {
+        if (cancel != NULL) {
+            // The child isn't reaped before we get out of here, so its pid can't be reused under the kill.
+            if (atomic_load(cancel)) {
+                kill(pid, SIGKILL);
+                result = false;
+                break;
+            }
+            struct pollfd pfd = {.fd = pipefd[0], .events = POLLIN};
+            if (poll(&pfd, 1, LAUNCHER_CANCEL_POLL_MS) <= 0) continue;
+        }
+        ssize_t n = read(pipefd[0], chunk, sizeof(chunk));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            nob_log(NOB_ERROR, "could not read output of %s: %s", argv.items[0], strerror(errno));
+            result = false;
+            break;
+        }
+        if (n == 0) break;
+        if (!sink(chunk, n, arg)) {
+            kill(pid, SIGKILL);
+            result = false;
+            break;
+        }
+    }
+
+    int wstatus = 0;
+    while (waitpid(pid, &wstatus, 0) < 0) {
+        if (errno == EINTR) continue;
+        nob_log(NOB_ERROR, "could not wait on %s: %s", argv.items[0], strerror(errno));
+        nob_return_defer(false);
+    }
+    if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) nob_return_defer(false);
+
+defer:
+    if (actions_initialized) posix_spawn_file_actions_destroy(&actions);
+    if (pipefd[0] >= 0) close(pipefd[0]);
+    if (pipefd[1] >= 0) close(pipefd[1]);
+    nob_cmd_free(argv);
+    return result;
+}
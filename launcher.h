@@ -0,0 +1,72 @@
+#ifndef LAUNCHER_H_
+#define LAUNCHER_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "./thirdparty/nob.h"
+
+// Process launcher for the jobs.
+//
+// Children are started with posix_spawn (no fork of the GL process) with their stdout/stderr
+// connected to CLOEXEC pipes. A single monitor thread waits on all the pipes and pidfds in one
+// epoll set and turns whatever happens into Launcher_Events, which the UI thread drains once
+// per frame with launcher_poll(). The event queue is single-producer/single-consumer and lock-free.
+
+#define LAUNCHER_MAX_PROCS 64
+#define LAUNCHER_LINE_SIZE 512
+#define LAUNCHER_QUEUE_CAPACITY 1024 // must be a power of two
+#define LAUNCHER_CANCEL_POLL_MS 20
+#define LAUNCHER_TAP_FD 3 // where the child sees the tap pipe
+#define LAUNCHER_TAP_PIPE_SIZE (1024*1024) // asked for, the kernel may give less
+
+typedef enum {
+    LAUNCHER_EVENT_STDOUT,
+    LAUNCHER_EVENT_STDERR,
+    LAUNCHER_EVENT_EXIT,
+} Launcher_Event_Kind;
+
+typedef struct {
+    Launcher_Event_Kind kind;
+    size_t job_id;
+    pid_t pid;
+    // LAUNCHER_EVENT_EXIT only: exit status of the process, or 128+signal if it was killed.
+    int exit_code;
+    // LAUNCHER_EVENT_STDOUT/LAUNCHER_EVENT_STDERR only: one line of output without the line terminator.
+    char line[LAUNCHER_LINE_SIZE];
+} Launcher_Event;
+
+bool launcher_init(void);
+void launcher_shutdown(void);
+
+// Starts `cmd` in its own process group and returns its pid, or -1 on failure. All the events of
+// the process are tagged with `job_id`. When `stdin_fd` is not NULL it receives the write end of
+// a pipe connected to the stdin of the process, which the caller must close. Otherwise stdin is /dev/null.
+// When `tap_fd` is not NULL it receives the non-blocking read end of a pipe the process can write
+// to as LAUNCHER_TAP_FD, for data that doesn't go line by line. The monitor thread doesn't look at
+// it, the caller reads it and must close it, but not before the exit event or the writer gets EPIPE.
+pid_t launcher_spawn(Nob_Cmd cmd, size_t job_id, int *stdin_fd, int *tap_fd);
+
+// Sends `sig` to the whole process group started by launcher_spawn().
+bool launcher_signal(pid_t pid, int sig);
+
+// Runs `cmd` to completion on the calling thread and appends its stdout to `out`. Stderr is inherited.
+// Doesn't touch the monitor thread, so it's safe to call from any thread.
+bool launcher_run_sync(Nob_Cmd cmd, Nob_String_Builder *out);
+
+// Same, but kills the process and returns false as soon as `cancel` is set, which another thread
+// may do at any time. It's looked at every LAUNCHER_CANCEL_POLL_MS.
+bool launcher_run_sync_cancellable(Nob_Cmd cmd, Nob_String_Builder *out, const atomic_bool *cancel);
+
+// Hands the output of `cmd` on `source` (STDOUT_FILENO or STDERR_FILENO) to `sink` chunk by chunk
+// as it arrives instead of collecting it, the other one is inherited. When `sink` returns false the
+// process is killed and so is the result.
+typedef bool (*Launcher_Sink)(const char *data, size_t size, void *arg);
+bool launcher_run_sync_streaming(Nob_Cmd cmd, int source, Launcher_Sink sink, void *arg, const atomic_bool *cancel);
+
+// Pops the next event. Returns false when there is nothing to process. Must be called from a single thread.
+bool launcher_poll(Launcher_Event *event);
+
+#endif // LAUNCHER_H_
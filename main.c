@@ -1,7 +1,25 @@
 #include "./thirdparty/raylib/src/raylib.h"
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "./analysis.h"
+#include "./audio_preview.h"
+#include "./bench.h"
+#include "./compare.h"
+#include "./concat.h"
+#include "./controller.h"
+#include "./eq_shader.h"
+#include "./ffmpeg.h"
+#include "./formats.h"
+#include "./jobs.h"
+#include "./keyframes.h"
+#include "./launcher.h"
+#include "./pool.h"
+#include "./preview.h"
+#include "./thumbs.h"
+#include "./trim.h"
+
 #define NOB_IMPLEMENTATION
 #include "./thirdparty/nob.h"
 
@@ -14,6 +32,12 @@
 #define LABEL_Y_OFFSET 20
 #define DEFAULT_FONT_SIZE 10
 
+#define QUEUE_Y 430
+#define JOB_CONTROLS_WIDTH 146 // pause and cancel at the end of each job line
+#define GRID_CELL_WIDTH 100
+#define GRID_CELL_HEIGHT 72
+#define GRID_LABEL_HEIGHT 12
+
 #define DEBUG 1
 
 #define ARRAY_LEN(array) (sizeof(array)/sizeof(array[0]))
@@ -38,12 +62,6 @@ int max(int a, int b) {
     return a > b ? a : b;
 }
 
-const char *EXTENSIONS[] = {
-    ".mp4",
-    ".avi",
-};
-
-
 typedef struct {
     Rectangle bounds;
     int min;
@@ -130,13 +148,6 @@ void button_draw(Button *btn, int active) {
 
 }
 
-typedef enum {
-    NO_MODIFICATION = 1,
-    CLONE_LEFT,
-    CLONE_RIGHT,
-    AUDIO_CHANNELS_LAST,
-} AudioChannels;
-
 typedef struct {
     const char **items;
     size_t count;
@@ -151,128 +162,347 @@ typedef struct {
 
 Labels audio_channel_labels = {0};
 
-typedef struct {
-    char* input_path;
-    char* output_path;
-    int crf;
-    int crop_top;
-    int crop_bottom;
-    int crop_left;
-    int crop_right;
-    int volume;
-    AudioChannels audio_channels;
-} FfmpegParams;
-
-
-void ffmpeg_params_print(FfmpegParams *params) {
-    printf("[DEBUG] input_path: \"%s\"\n", (*params).input_path);
-    printf("[DEBUG] output_path: \"%s\"\n", (*params).output_path);
-    printf("[DEBUG] crf: %d\n", (*params).crf);
-    printf("[DEBUG] crop: [%d, %d, %d, %d]",
-           (*params).crop_top,
-           (*params).crop_bottom,
-           (*params).crop_left,
-           (*params).crop_right);
-    printf("\n");
-}
-
-
-int run_ffmpeg(FfmpegParams params) {
+int run_ffmpeg(Jobs *jobs, FfmpegParams params) {
     if (DEBUG) ffmpeg_params_print(&params);
 
-    char crf_str[3] = {
-        params.crf / 10 + '0',
-        (params.crf) % 10 + '0',
-    };
-
-    Nob_Cmd cmd = {0};
-    nob_cmd_append(&cmd, "ffmpeg", "-y");
-    nob_cmd_append(&cmd, "-i", params.input_path);
-    nob_cmd_append(&cmd, "-crf", crf_str);
-
-    char crop[255] = {0};
-    if (params.crop_top | params.crop_bottom | params.crop_left | params.crop_right) {
-        sprintf(
-                crop,
-                "crop=in_w-%d:in_h-%d:%d:%d",
-                params.crop_left + params.crop_right,
-                params.crop_top + params.crop_bottom,
-                params.crop_left,
-                params.crop_top
-                );
-        nob_cmd_append(&cmd, "-vf", crop);
+    if(!strlen(params.input_path)) {
+        printf("[INFO] no file is selected.\n");
+        return 1;
+    } else {
+        printf("[INFO] selected file: %s\n", params.input_path);
     }
 
-    char audio[255] = {0};
-    if (params.audio_channels == CLONE_LEFT) {
-        char* option = "pan=stereo|FL=FL|FR=FL";
-        snprintf(audio, strlen(option) + 1, "%s", option);
+    if(!strlen(params.output_path)) {
+        printf("[INFO] unsupported file extension: %s\n", params.input_path);
+        return 1;
     }
-    if (params.audio_channels == CLONE_RIGHT) {
-        char* option ="pan=stereo|FL=FR|FR=FR";
-        snprintf(audio, strlen(option) + 1, "%s", option);
+
+    fflush(stdout);
+    jobs_submit(jobs, params);
+    return 0;
+}
+
+
+// Sizes the trim sliders to the duration of the (first) input, in seconds.
+void trim_sliders_reset(Slider *trim_in, Slider *trim_out, Probe *probe) {
+    int duration = probe->ok ? (int)ceil(probe->duration) : 0;
+    trim_in->max = trim_out->max = duration > 0 ? duration : 1;
+    trim_in->value = 0;
+    trim_out->value = trim_out->max;
+}
+
+
+void trim_params_from_sliders(FfmpegParams *params, Slider *trim_in, Slider *trim_out) {
+    params->trim_in = trim_in->value;
+    params->trim_out = trim_out->value < trim_out->max ? trim_out->value : 0;
+}
+
+
+// Moves the trim points of `params` to where the cut is going to happen and picks the mode.
+bool trim_params_plan(FfmpegParams *params, const Keyframe_Index *keyframes, const Probe *probe, bool snap, Trim_Plan *plan) {
+    if (!trim_plan(*params, keyframes, probe, snap, plan)) return false;
+    trim_apply(plan, params);
+    // A rotation or an audio offset alone only rewrites the container.
+    if (plan->mode == TRIM_NONE && ffmpeg_params_metadata_edited(*params) && !ffmpeg_params_filtered(*params)) params->stream_copy = true;
+    return true;
+}
+
+
+void audio_offset_params_from_slider(FfmpegParams *params, Slider *audio_offset) {
+    params->audio_offset = (audio_offset->value - 1000) / 1000.0;
+}
+
+
+const char *rotation_label(int rotation) {
+    switch (rotation) {
+    case 90:  return "rotate 90";
+    case 180: return "rotate 180";
+    case 270: return "rotate 270";
+    default:  return "rotate 0";
     }
+}
 
-    if (strlen(audio) > 0) snprintf(audio + strlen(audio), 2, ",");
-    snprintf(audio + strlen(audio), strlen("volume=")+5, "volume=%.2f", (float)params.volume/100);
 
-    if (strlen(audio) > 0) nob_cmd_append(&cmd, "-af", audio);
+// Probe, keyframes and analysis of the first input for the trim sliders. All are loaded on the
+// pool, results that come back after the selection changed are dropped.
+typedef struct InputTask InputTask;
 
+typedef struct {
+    size_t generation;
+    Probe probe;
+    Keyframe_Index keyframes;
+    bool keyframes_requested;
+    Analysis analysis;
+    bool analyzed;
+    InputTask *analyzing; // the analysis in flight, so it can be cancelled
+    Slider *trim_in;
+    Slider *trim_out;
+} InputInfo;
+
+struct InputTask {
+    InputInfo *input;
+    size_t generation;
+    char path[MAX_FILEPATH_SIZE];
+    Probe probe;
+    Keyframe_Index keyframes;
+    Analysis analysis;
+    bool analysis_ok;
+    atomic_bool cancel;
+};
 
-    nob_cmd_append(&cmd, params.output_path);
-    nob_cmd_append(&cmd, "-progress pipe:1");
 
-    Nob_String_Builder sb = {0};
-    nob_cmd_render(cmd, &sb);
-    nob_sb_append_null(&sb);
-    nob_log(NOB_INFO, "CMD: %s", sb.items);
-    nob_sb_free(sb);
-    memset(&sb, 0, sizeof(sb));
+InputTask *input_task_new(InputInfo *input, char *input_path) {
+    InputTask *task = calloc(1, sizeof(*task));
+    task->input = input;
+    task->generation = input->generation;
+    strcpy(task->path, input_path);
+    return task;
+}
 
-    if(!strlen(params.input_path)) {
-        printf("[INFO] no file is selected.\n");
-        return 1;
+
+void input_probe_work(void *arg) {
+    InputTask *task = arg;
+    probe_file(task->path, &task->probe);
+}
+
+
+void input_probe_done(void *arg) {
+    InputTask *task = arg;
+    if (task->generation == task->input->generation) {
+        task->input->probe = task->probe;
+        trim_sliders_reset(task->input->trim_in, task->input->trim_out, &task->input->probe);
+    }
+    free(task);
+}
+
+
+void input_keyframes_work(void *arg) {
+    InputTask *task = arg;
+    keyframe_index_load(task->path, &task->keyframes);
+}
+
+
+void input_keyframes_done(void *arg) {
+    InputTask *task = arg;
+    if (task->generation == task->input->generation) {
+        keyframe_index_free(&task->input->keyframes);
+        task->input->keyframes = task->keyframes;
     } else {
-        printf("[INFO] selected file: %s\n", params.input_path);
+        keyframe_index_free(&task->keyframes);
     }
+    free(task);
+}
 
-    fflush(stdout);
-    if (!nob_cmd_run(&cmd)) return 1;
-    return 0;
+
+void input_analysis_work(void *arg) {
+    InputTask *task = arg;
+    task->analysis_ok = analysis_load(task->path, &task->analysis, &task->cancel);
+}
+
+
+void input_analysis_done(void *arg) {
+    InputTask *task = arg;
+    if (task->input->analyzing == task) task->input->analyzing = NULL;
+    if (task->analysis_ok && task->generation == task->input->generation) {
+        analysis_free(&task->input->analysis);
+        task->input->analysis = task->analysis;
+        task->input->analyzed = true;
+    } else {
+        analysis_free(&task->analysis);
+    }
+    free(task);
+}
+
+
+void input_info_cancel_analysis(InputInfo *input) {
+    if (input->analyzing != NULL) atomic_store(&input->analyzing->cancel, true);
+    input->analyzing = NULL;
+}
+
+
+void input_info_reset(InputInfo *input, char *input_path) {
+    input->generation += 1;
+    input_info_cancel_analysis(input);
+    analysis_free(&input->analysis);
+    input->analyzed = false;
+    memset(&input->probe, 0, sizeof(input->probe));
+    keyframe_index_free(&input->keyframes);
+    input->keyframes_requested = false;
+    trim_sliders_reset(input->trim_in, input->trim_out, &input->probe);
+    if (strlen(input_path) > 0) pool_submit(input_probe_work, input_probe_done, input_task_new(input, input_path));
+}
+
+
+// The keyframes are only needed once there is something to trim.
+void input_info_request_keyframes(InputInfo *input, char *input_path) {
+    if (input->keyframes_requested || strlen(input_path) == 0) return;
+    input->keyframes_requested = true;
+    pool_submit(input_keyframes_work, input_keyframes_done, input_task_new(input, input_path));
+}
+
+
+// The analysis decodes the whole input, so it only runs when asked for.
+void input_info_request_analysis(InputInfo *input, char *input_path) {
+    if (input->analyzed || input->analyzing != NULL || strlen(input_path) == 0) return;
+    // Set before the submit, the task may be done before it returns.
+    input->analyzing = input_task_new(input, input_path);
+    pool_submit(input_analysis_work, input_analysis_done, input->analyzing);
+}
+
+
+// Sets the crop sliders to what cropdetect found. False when there is nothing to crop.
+bool input_info_apply_crop(InputInfo *input, Slider *top, Slider *bottom, Slider *left, Slider *right) {
+    const Analysis *analysis = &input->analysis;
+    if (!input->analyzed || analysis->crop_width == 0 || input->probe.width == 0) return false;
+    int margins[4] = {
+        analysis->crop_y,
+        input->probe.height - analysis->crop_y - analysis->crop_height,
+        analysis->crop_x,
+        input->probe.width - analysis->crop_x - analysis->crop_width,
+    };
+    if ((margins[0] | margins[1] | margins[2] | margins[3]) == 0) return false;
+    Slider *sliders[4] = {top, bottom, left, right};
+    for (size_t i = 0; i < 4; ++i) sliders[i]->value = clamp(margins[i], sliders[i]->min, sliders[i]->max);
+    return true;
+}
+
+
+// One line of what the analysis found.
+const char *input_info_analysis_summary(const InputInfo *input) {
+    if (input->analyzing != NULL) return "analysis: decoding...";
+    if (!input->analyzed) return "";
+    const Analysis *analysis = &input->analysis;
+    return TextFormat("analysis: %s | %s | %zu black, %zu silent, %zu scene cuts",
+                      analysis->crop_width > 0
+                          ? TextFormat("crop %d:%d:%d:%d", analysis->crop_width, analysis->crop_height, analysis->crop_x, analysis->crop_y)
+                          : "no crop",
+                      analysis->audio
+                          ? TextFormat("%.1f LUFS, LRA %.1f LU, peak %.1f dBFS", analysis->loudness, analysis->loudness_range, analysis->true_peak)
+                          : "no audio",
+                      analysis->black.count,
+                      analysis->silence.count,
+                      analysis->scenes.count);
+}
+
+
+// A trimmed encode needs the keyframes and the probe of its input to plan the cut, which are
+// loaded on the pool before the job is queued. The auto-trim needs the analysis as well.
+typedef struct {
+    Jobs *jobs;
+    FfmpegParams params; // owns input_path and output_path
+    bool snap;
+    bool auto_trim;
+    Probe probe;
+    Keyframe_Index keyframes;
+    Analysis analysis;
+    bool analyzed;
+} SubmitTask;
+
+// Set when quitting, so the analyses of pending auto-trims don't hold up the exit.
+atomic_bool submit_cancel = false;
+
+
+// Moves the trim points past the dead air at both ends, within the trim the user already set.
+void auto_trim_dead_air(FfmpegParams *params, const Analysis *analysis, const Probe *probe) {
+    double in, out;
+    if (!analysis_dead_air(analysis, probe->duration, &in, &out)) return;
+    double user_out = params->trim_out > 0 ? params->trim_out : probe->duration;
+    double trim_in = params->trim_in > in ? params->trim_in : in;
+    double trim_out = out > 0 && out < user_out ? out : user_out;
+    if (trim_out - trim_in < ANALYSIS_DEAD_AIR_MIN_KEEP) return;
+    params->dead_air = (trim_in - params->trim_in) + (user_out - trim_out);
+    params->trim_in = trim_in;
+    params->trim_out = trim_out < probe->duration ? trim_out : 0;
+}
+
+
+void submit_planned(Jobs *jobs, FfmpegParams params, const Keyframe_Index *keyframes, const Probe *probe, bool snap) {
+    Trim_Plan plan;
+    if (!trim_params_plan(&params, keyframes, probe, snap, &plan)) {
+        printf("[INFO] trim out must be after trim in: %s\n", params.input_path);
+        return;
+    }
+    run_ffmpeg(jobs, params);
+}
+
+
+void submit_work(void *arg) {
+    SubmitTask *task = arg;
+    keyframe_index_load(task->params.input_path, &task->keyframes);
+    probe_file(task->params.input_path, &task->probe);
+    if (task->auto_trim) task->analyzed = analysis_load(task->params.input_path, &task->analysis, &submit_cancel);
 }
 
 
-void set_input_path(char* input_path) {
+void submit_done(void *arg) {
+    SubmitTask *task = arg;
+    if (task->analyzed) auto_trim_dead_air(&task->params, &task->analysis, &task->probe);
+    submit_planned(task->jobs, task->params, &task->keyframes, &task->probe, task->snap);
+    keyframe_index_free(&task->keyframes);
+    analysis_free(&task->analysis);
+    free(task->params.input_path);
+    free(task->params.output_path);
+    free(task);
+}
+
+
+void submit_trimmed(Jobs *jobs, FfmpegParams params, bool snap, bool auto_trim) {
+    if (params.trim_in == 0 && params.trim_out == 0 && !auto_trim) {
+        submit_planned(jobs, params, &(Keyframe_Index){0}, &(Probe){0}, snap);
+        return;
+    }
+    SubmitTask *task = calloc(1, sizeof(*task));
+    task->jobs = jobs;
+    task->params = params;
+    task->params.input_path = strdup(params.input_path);
+    task->params.output_path = strdup(params.output_path);
+    task->snap = snap;
+    task->auto_trim = auto_trim;
+    pool_submit(submit_work, submit_done, task);
+}
+
+
+// `dir/GOPR0042.MP4` -> `dir/GOPR0042_joined.mp4`, or the container picked for the output.
+void set_joined_output_path(char *output_path, char *first_input_path, int output_format) {
+    char *dot = strrchr(first_input_path, '.');
+    size_t n = dot != NULL ? (size_t)(dot - first_input_path) : strlen(first_input_path);
+    const char *ext = output_format >= 0 ? formats[output_format].ext : ".mp4";
+    snprintf(output_path, MAX_FILEPATH_SIZE, "%.*s_joined%s", (int)n, first_input_path, ext);
+}
+
+
+void set_input_paths(Nob_File_Paths *input_paths) {
     const char* nemo_paths = getenv("NEMO_SCRIPT_SELECTED_FILE_PATHS");
     if (nemo_paths == NULL) return;
 
     if (DEBUG) printf("[DEBUG] %s", nemo_paths);
-    int length = strchr(nemo_paths, '\n') - nemo_paths;
-    strncpy(input_path, nemo_paths, length);
-    return;
+    Nob_String_View paths = nob_sv_from_cstr(nemo_paths);
+    while (paths.count > 0) {
+        Nob_String_View path = nob_sv_chop_by_delim(&paths, '\n');
+        if (path.count == 0 || path.count >= MAX_FILEPATH_SIZE) continue;
+        nob_da_append(input_paths, strndup(path.data, path.count));
+    }
 }
 
 
-int str_endswith(const char* string, const char* ending) {
-    char* pos = strrchr(string, '.');
-    if (pos != NULL)
-        return strcmp(pos, ending);
-    return -1;
+void input_paths_free(Nob_File_Paths *input_paths) {
+    for (size_t i = 0; i < input_paths->count; ++i) free((char*)input_paths->items[i]);
+    input_paths->count = 0;
 }
 
 
-void set_output_path(char* output_path, char* input_path) {
+// `dir/in.MOV` -> `dir/in_v2.mov`, with the extension of formats[output_format] unless it's -1.
+// Empty when the input isn't in one of the formats.
+void set_output_path(char* output_path, char* input_path, int output_format) {
     if (strlen(input_path) < 1) return;
-    char name_suffix[] = "_v2";
-    for (size_t i = 0; i < sizeof(EXTENSIONS)/sizeof(EXTENSIONS[0]); ++i) {
-        if(str_endswith(input_path, EXTENSIONS[i]) != 0) continue;
-
-        char* pos = strrchr(input_path, '.');
-        strcpy(output_path, input_path);
-        strcpy(output_path + (pos - input_path), name_suffix);
-        strcpy(output_path + (pos - input_path) + strlen(name_suffix), EXTENSIONS[i]);
+    const Format *input_format = format_find(input_path);
+    if (input_format == NULL) {
+        output_path[0] = '\0';
         return;
     }
+    const char *ext = output_format >= 0 ? formats[output_format].ext : input_format->ext;
+    char *dot = strrchr(input_path, '.');
+    snprintf(output_path, MAX_FILEPATH_SIZE, "%.*s_v2%s", (int)(dot - input_path), input_path, ext);
 }
 
 typedef enum {
@@ -281,6 +511,7 @@ typedef enum {
     SLIDER,
     BUTTON,
     RADIO_GROUP,
+    JOB_CONTROL,
 } UIElement;
 
 typedef enum {
@@ -378,24 +609,177 @@ void radio_group_draw(RadioGroup *radio_group) {
 
 
 
+typedef enum {
+    JOB_CONTROL_PAUSE,
+    JOB_CONTROL_CANCEL,
+} JobControlKind;
+
+typedef struct {
+    size_t job;
+    JobControlKind kind;
+} JobControl;
+
+
+// Small buttons at the right edge of the window, the job line is cut off before them.
+Rectangle job_control_bounds(size_t job, JobControlKind kind) {
+    return (Rectangle){
+        GetScreenWidth() - JOB_CONTROLS_WIDTH + kind*70,
+        QUEUE_Y + job*16,
+        64,
+        14,
+    };
+}
+
+
+int job_control_available(Job *job, JobControlKind kind) {
+    switch (kind) {
+    case JOB_CONTROL_PAUSE:  return job->state == JOB_RUNNING || job->state == JOB_PAUSED;
+    case JOB_CONTROL_CANCEL: return job->state == JOB_QUEUED || job->state == JOB_RUNNING || job->state == JOB_PAUSED;
+    }
+    return false;
+}
+
+
+char *job_control_label(Job *job, JobControlKind kind) {
+    if (kind == JOB_CONTROL_CANCEL) return "cancel";
+    return job->state == JOB_PAUSED ? "resume" : "pause";
+}
+
+
+typedef struct {
+    Texture2D texture; // FFMPEG_MONITOR_WIDTH x FFMPEG_MONITOR_HEIGHT, id is 0 until the first frame
+    size_t job;
+    size_t frames; // monitor_frames of `job` the texture holds
+} Monitor;
+
+
+// The first job with a frame on its monitor tap, NULL when there is none. The frame is only
+// uploaded when it's new, about once a second.
+Job *monitor_update(Monitor *monitor, Jobs *jobs) {
+    for (size_t i = 0; i < jobs->count; ++i) {
+        Job *job = &jobs->items[i];
+        if (job->monitor_frame == NULL) continue;
+        if (monitor->texture.id == 0) {
+            Image image = {job->monitor_frame, FFMPEG_MONITOR_WIDTH, FFMPEG_MONITOR_HEIGHT, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+            monitor->texture = LoadTextureFromImage(image);
+        } else if (monitor->job != i || monitor->frames != job->monitor_frames) {
+            UpdateTexture(monitor->texture, job->monitor_frame);
+        }
+        monitor->job = i;
+        monitor->frames = job->monitor_frames;
+        return job;
+    }
+    return NULL;
+}
+
+
+void monitor_draw(Monitor *monitor, Job *job, Rectangle dest) {
+    float scale = fminf(dest.width/FFMPEG_MONITOR_WIDTH, dest.height/FFMPEG_MONITOR_HEIGHT);
+    Rectangle fitted = {
+        dest.x + (dest.width - FFMPEG_MONITOR_WIDTH*scale)/2,
+        dest.y + (dest.height - FFMPEG_MONITOR_HEIGHT*scale)/2,
+        FFMPEG_MONITOR_WIDTH*scale,
+        FFMPEG_MONITOR_HEIGHT*scale,
+    };
+    DrawRectangleRec(dest, BLACK);
+    DrawTexturePro(monitor->texture, (Rectangle){0, 0, FFMPEG_MONITOR_WIDTH, FFMPEG_MONITOR_HEIGHT}, fitted, (Vector2){0, 0}, 0, WHITE);
+    DrawText(TextFormat("live %.0fs", job->out_time), dest.x + 2, dest.y + 2, 10, RED);
+}
+
+
+// What the auto-trim took off the job, and the encode time that saves at the predicted speed.
+const char *job_dead_air_label(Job *job) {
+    if (job->params.dead_air <= 0) return "";
+    double end = job->params.trim_out > 0 ? job->params.trim_out : job->probe.duration;
+    double span = end - job->params.trim_in;
+    double saved = span > 0 ? job->params.dead_air * job->predicted / span : 0;
+    return TextFormat(" -%.0fs dead air (~%.0fs saved)", job->params.dead_air, saved);
+}
+
+
+// How many frames the screen recording profile dropped, and once it's done how much faster it was.
+const char *job_screen_label(Job *job) {
+    if (!job->params.screen_recording) return "";
+    double speedup = job_speedup(job);
+    if (speedup > 0) return TextFormat(" -%.0f%% frames, ~%.1fx faster", job_frame_reduction(job)*100, speedup);
+    return TextFormat(" -%.0f%% frames", job_frame_reduction(job)*100);
+}
+
+
+// The queue below the status lines, as a list or as a grid of thumbnails.
+Rectangle queue_bounds(void) {
+    return (Rectangle){0, QUEUE_Y, GetScreenWidth(), GetScreenHeight() - QUEUE_Y};
+}
+
+
+// Only the rows on screen are touched, so the cost doesn't depend on the size of the batch.
+void queue_grid_draw(Thumbs *thumbs, Jobs *jobs, float *scroll) {
+    Rectangle area = queue_bounds();
+    size_t columns = max(1, area.width / GRID_CELL_WIDTH);
+    size_t rows = (jobs->count + columns - 1) / columns;
+    float max_scroll = rows*GRID_CELL_HEIGHT > area.height ? rows*GRID_CELL_HEIGHT - area.height : 0;
+    *scroll = clampf(*scroll, 0, max_scroll);
+
+    Thumb_Cell cells[256];
+    size_t count = 0;
+    size_t first_row = *scroll / GRID_CELL_HEIGHT;
+    size_t last_row = (*scroll + area.height) / GRID_CELL_HEIGHT;
+    BeginScissorMode(area.x, area.y, area.width, area.height);
+    for (size_t row = first_row; row <= last_row; ++row) {
+        for (size_t column = 0; column < columns; ++column) {
+            size_t id = row*columns + column;
+            if (id >= jobs->count || count >= ARRAY_LEN(cells)) break;
+            Rectangle thumb = {
+                area.x + column*GRID_CELL_WIDTH + 2,
+                area.y + row*GRID_CELL_HEIGHT - *scroll + 2,
+                GRID_CELL_WIDTH - 4,
+                GRID_CELL_HEIGHT - GRID_LABEL_HEIGHT - 4,
+            };
+            DrawRectangleRec(thumb, LIGHTGRAY);
+            cells[count++] = (Thumb_Cell){id, jobs->items[id].params.input_path, thumb};
+        }
+    }
+    thumbs_draw(thumbs, cells, count);
+    for (size_t i = 0; i < count; ++i) {
+        Job *job = &jobs->items[cells[i].id];
+        Rectangle thumb = cells[i].dest;
+        DrawText(job_state_name(job->state), thumb.x + 2, thumb.y + 2, 10, job->state == JOB_FAILED ? RED : BLACK);
+        DrawText(TextFormat("%.16s", nob_path_name(job->params.input_path)), thumb.x, thumb.y + thumb.height + 2, 10, BLACK);
+    }
+    EndScissorMode();
+}
+
+
 typedef struct {
     UIElement type;
     union {
         Button *button;
         Slider *slider;
         RadioGroup *radio_group;
+        JobControl job_control;
     };
 } InteractingWith;
 
 
-int main(void)
+// The trim slider whose frame the preview and the A/B view show: the last one moved, trim in by default.
+Slider *scrubbed_slider(InteractingWith *last_interacted_with, Slider *trim_in, Slider *trim_out) {
+    if (last_interacted_with->type == SLIDER && last_interacted_with->slider == trim_out) return trim_out;
+    return trim_in;
+}
+
+
+int main(int argc, char **argv)
 {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) return bench_main(argc - 2, argv + 2);
 
     da_append(&audio_channel_labels, "NO MODIFICATION");
     da_append(&audio_channel_labels, "CLONE LEFT");
     da_append(&audio_channel_labels, "CLONE RIGHT");
 
-    InitWindow(800, 450, "video-processor");
+    if (!launcher_init()) return 1;
+    if (!pool_init(0)) return 1;
+
+    InitWindow(800, 600, "video-processor");
     Image icon = LoadImage("assets/icons/video-processor.png");
     SetWindowIcon(icon);
     SetWindowMonitor(0);
@@ -404,8 +788,16 @@ int main(void)
     bool exit_window = false;
     char input_path[MAX_FILEPATH_SIZE] = "";
     char output_path[MAX_FILEPATH_SIZE] = "";
-    set_input_path(input_path);
-    set_output_path(output_path, input_path);
+    Nob_File_Paths input_paths = {0};
+    Jobs jobs = {0};
+    Controller controller = {0};
+    bool snap_to_keyframes = false;
+    bool auto_trim = false;
+    int output_format = -1; // index in formats, -1 keeps the container of the input
+    bool faststart = false;
+    set_input_paths(&input_paths);
+    if (input_paths.count > 0) strcpy(input_path, input_paths.items[0]);
+    set_output_path(output_path, input_path, output_format);
     InteractingWith interacting_with = {NOTHING, {0}};
     InteractingWith last_interacted_with = {NOTHING, {0}};
     Vector2 center = {
@@ -489,6 +881,127 @@ int main(void)
         .value = 100,
         .step = 5,
     };
+    Slider trim_in = {
+        .bounds = {
+            slider_start.x + slider_x_offset - 50,
+            slider_start.y + slider_y_offset * 5,
+            100,
+            slider_height,
+        },
+        .min = 0,
+        .max = 1,
+        .value = 0,
+        .step = 1,
+    };
+    Slider trim_out = {
+        .bounds = {
+            slider_start.x + slider_x_offset + 130,
+            slider_start.y + slider_y_offset * 5,
+            100,
+            slider_height,
+        },
+        .min = 0,
+        .max = 1,
+        .value = 1,
+        .step = 1,
+    };
+    // Milliseconds offset by 1000, the slider has no negative values.
+    Slider audio_offset = {
+        .bounds = {
+            slider_start.x,
+            slider_start.y + slider_y_offset,
+            slider_width,
+            slider_height,
+        },
+        .min = 0,
+        .max = 2000,
+        .value = 1000,
+        .step = 10,
+    };
+    int rotation = 0;
+    Button rotate_btn = {
+        .bounds = {
+            .x = slider_start.x,
+            .y = slider_start.y,
+            .width = 80,
+            .height = 16,
+        },
+        .label = (char*) rotation_label(rotation),
+        .font_size = 12,
+    };
+    Slider eq_brightness = {
+        .bounds = {
+            slider_start.x + slider_x_offset * 2,
+            slider_start.y,
+            slider_width,
+            slider_height,
+        },
+        .min = 0,
+        .max = 200,
+        .value = 100,
+        .step = 5,
+    };
+    Slider eq_contrast = {
+        .bounds = {
+            slider_start.x + slider_x_offset * 2,
+            slider_start.y + slider_y_offset,
+            slider_width,
+            slider_height,
+        },
+        .min = 0,
+        .max = 200,
+        .value = 100,
+        .step = 5,
+    };
+    Slider eq_saturation = {
+        .bounds = {
+            slider_start.x + slider_x_offset * 2,
+            slider_start.y + slider_y_offset * 3,
+            slider_width,
+            slider_height,
+        },
+        .min = 0,
+        .max = 300,
+        .value = 100,
+        .step = 5,
+    };
+    Slider eq_gamma = {
+        .bounds = {
+            slider_start.x + slider_x_offset * 2,
+            slider_start.y + slider_y_offset * 4,
+            slider_width,
+            slider_height,
+        },
+        .min = 10,
+        .max = 300,
+        .value = 100,
+        .step = 5,
+    };
+    InputInfo input = {
+        .trim_in = &trim_in,
+        .trim_out = &trim_out,
+    };
+    input_info_reset(&input, input_path);
+    Button snap_btn = {
+        .bounds = {
+            .x = slider_start.x + slider_x_offset + 280,
+            .y = slider_start.y + slider_y_offset * 5,
+            .width = 50,
+            .height = slider_height,
+        },
+        .label = "snap",
+        .font_size = 12,
+    };
+    Button auto_trim_btn = {
+        .bounds = {
+            .x = slider_start.x + slider_x_offset + 280,
+            .y = slider_start.y + slider_y_offset * 5 + slider_height + 4,
+            .width = 60,
+            .height = 16,
+        },
+        .label = "dead air",
+        .font_size = 12,
+    };
     Button submit_btn = {
         .bounds = {
             .x = center.x + slider_x_offset,
@@ -499,6 +1012,130 @@ int main(void)
         .label = "run",
         .font_size = 28,
     };
+    Button grid_btn = {
+        .bounds = {
+            .x = 700,
+            .y = QUEUE_Y - 40,
+            .width = 80,
+            .height = 16,
+        },
+        .label = "grid",
+        .font_size = 12,
+    };
+    Rectangle preview_bounds = {655, 230, 135, 76};
+    Eq_Shader eq = {0};
+    eq_shader_load(&eq);
+    Preview preview = {0};
+    Button compare_btn = {
+        .bounds = {
+            .x = 655,
+            .y = 312,
+            .width = 50,
+            .height = 16,
+        },
+        .label = "A/B",
+        .font_size = 12,
+    };
+    Button compare_mode_btn = {
+        .bounds = {
+            .x = 711,
+            .y = 312,
+            .width = 60,
+            .height = 16,
+        },
+        .label = (char*) compare_mode_name(COMPARE_SIDE_BY_SIDE),
+        .font_size = 12,
+    };
+    Button listen_btn = {
+        .bounds = {
+            .x = 655,
+            .y = 210,
+            .width = 50,
+            .height = 16,
+        },
+        .label = "listen",
+        .font_size = 12,
+    };
+    Button monitor_btn = {
+        .bounds = {
+            .x = 711,
+            .y = 210,
+            .width = 80,
+            .height = 16,
+        },
+        .label = "monitor off",
+        .font_size = 12,
+    };
+    Button analyze_btn = {
+        .bounds = {
+            .x = 711,
+            .y = 24,
+            .width = 80,
+            .height = 16,
+        },
+        .label = "analyze",
+        .font_size = 12,
+    };
+    Button format_btn = {
+        .bounds = {
+            .x = 655,
+            .y = 130,
+            .width = 80,
+            .height = 16,
+        },
+        .label = "same format",
+        .font_size = 12,
+    };
+    Button faststart_btn = {
+        .bounds = {
+            .x = 655,
+            .y = 150,
+            .width = 80,
+            .height = 16,
+        },
+        .label = "faststart",
+        .font_size = 12,
+    };
+    Button remux_btn = {
+        .bounds = {
+            .x = 655,
+            .y = 170,
+            .width = 80,
+            .height = 16,
+        },
+        .label = "remux",
+        .font_size = 12,
+    };
+    Button screen_btn = {
+        .bounds = {
+            .x = 655,
+            .y = 190,
+            .width = 80,
+            .height = 16,
+        },
+        .label = "screen rec",
+        .font_size = 12,
+    };
+    bool screen_recording = false;
+    bool monitor_jobs = false;
+    Monitor monitor = {0};
+    Rectangle compare_bounds = {10, 70, 600, 270};
+    bool compare_shown = false;
+    Compare_Mode compare_mode = COMPARE_SIDE_BY_SIDE;
+    Compare compare = {0};
+    bool queue_grid = false;
+    float queue_scroll = 0;
+    Thumbs thumbs = {0};
+    Button join_btn = {
+        .bounds = {
+            .x = center.x + slider_x_offset + 110,
+            .y = center.y + slider_y_offset,
+            .width = 80,
+            .height = 50,
+        },
+        .label = "join",
+        .font_size = 28,
+    };
 
     Slider *sliders[] = {
         &crf,
@@ -507,6 +1144,13 @@ int main(void)
         &crop_left,
         &crop_right,
         &volume,
+        &trim_in,
+        &trim_out,
+        &eq_brightness,
+        &eq_contrast,
+        &eq_saturation,
+        &eq_gamma,
+        &audio_offset,
     };
     RadioGroup audio_channnels_radio_group = {
         .bounds = {
@@ -533,8 +1177,14 @@ int main(void)
         if (IsFileDropped()) {
             FilePathList dropped_files = LoadDroppedFiles();
             if (dropped_files.count > 0) {
-                strcpy(input_path, dropped_files.paths[0]);
-                set_output_path(output_path, input_path);
+                input_paths_free(&input_paths);
+                for (size_t i = 0; i < dropped_files.count; ++i) {
+                    if (strlen(dropped_files.paths[i]) >= MAX_FILEPATH_SIZE) continue;
+                    nob_da_append(&input_paths, strdup(dropped_files.paths[i]));
+                }
+                strcpy(input_path, input_paths.count > 0 ? input_paths.items[0] : "");
+                set_output_path(output_path, input_path, output_format);
+                input_info_reset(&input, input_path);
             }
             UnloadDroppedFiles(dropped_files);
         }
@@ -543,6 +1193,12 @@ int main(void)
         if (IsMouseButtonDown(MOUSE_BUTTON_LEFT)) {
             /* if (DEBUG) slider_debug(&crf); */
             if (interacting_with.type == NOTHING) {
+                // The A/B view covers the sliders.
+                if (compare_shown && CheckCollisionPointRec(mouse, compare_bounds)) {
+                    interacting_with.type = BACKGROUND;
+                    goto interacted;
+                }
+
                 for (size_t i = 0; i < ARRAY_LEN(sliders); ++i) {
                     if(slider_check_collision_point(sliders[i], mouse)) {
                         interacting_with.type = SLIDER;
@@ -557,12 +1213,106 @@ int main(void)
                     goto interacted;
                 }
 
+                if(CheckCollisionPointRec(mouse, join_btn.bounds)) {
+                    interacting_with.type = BUTTON;
+                    interacting_with.button = &join_btn;
+                    goto interacted;
+                }
+
+                if(CheckCollisionPointRec(mouse, format_btn.bounds)) {
+                    interacting_with.type = BUTTON;
+                    interacting_with.button = &format_btn;
+                    goto interacted;
+                }
+
+                if(CheckCollisionPointRec(mouse, faststart_btn.bounds)) {
+                    interacting_with.type = BUTTON;
+                    interacting_with.button = &faststart_btn;
+                    goto interacted;
+                }
+
+                if(CheckCollisionPointRec(mouse, remux_btn.bounds)) {
+                    interacting_with.type = BUTTON;
+                    interacting_with.button = &remux_btn;
+                    goto interacted;
+                }
+
+                if(CheckCollisionPointRec(mouse, rotate_btn.bounds)) {
+                    interacting_with.type = BUTTON;
+                    interacting_with.button = &rotate_btn;
+                    goto interacted;
+                }
+
+                if(CheckCollisionPointRec(mouse, screen_btn.bounds)) {
+                    interacting_with.type = BUTTON;
+                    interacting_with.button = &screen_btn;
+                    goto interacted;
+                }
+
+                if(CheckCollisionPointRec(mouse, auto_trim_btn.bounds)) {
+                    interacting_with.type = BUTTON;
+                    interacting_with.button = &auto_trim_btn;
+                    goto interacted;
+                }
+
+                if(CheckCollisionPointRec(mouse, snap_btn.bounds)) {
+                    interacting_with.type = BUTTON;
+                    interacting_with.button = &snap_btn;
+                    goto interacted;
+                }
+
+                if(CheckCollisionPointRec(mouse, grid_btn.bounds)) {
+                    interacting_with.type = BUTTON;
+                    interacting_with.button = &grid_btn;
+                    goto interacted;
+                }
+
+                if(CheckCollisionPointRec(mouse, compare_btn.bounds)) {
+                    interacting_with.type = BUTTON;
+                    interacting_with.button = &compare_btn;
+                    goto interacted;
+                }
+
+                if(CheckCollisionPointRec(mouse, listen_btn.bounds)) {
+                    interacting_with.type = BUTTON;
+                    interacting_with.button = &listen_btn;
+                    goto interacted;
+                }
+
+                if(CheckCollisionPointRec(mouse, analyze_btn.bounds)) {
+                    interacting_with.type = BUTTON;
+                    interacting_with.button = &analyze_btn;
+                    goto interacted;
+                }
+
+                if(CheckCollisionPointRec(mouse, monitor_btn.bounds)) {
+                    interacting_with.type = BUTTON;
+                    interacting_with.button = &monitor_btn;
+                    goto interacted;
+                }
+
+                if(compare_shown && CheckCollisionPointRec(mouse, compare_mode_btn.bounds)) {
+                    interacting_with.type = BUTTON;
+                    interacting_with.button = &compare_mode_btn;
+                    goto interacted;
+                }
+
                 int r_option = radio_group_check_collision_point(&audio_channnels_radio_group, mouse);
                 if(r_option) {
                     interacting_with.type = RADIO_GROUP;
                     interacting_with.radio_group = &audio_channnels_radio_group;
                     goto interacted;
                 }
+
+                for (size_t i = 0; i < jobs.count && !queue_grid; ++i) {
+                    for (JobControlKind kind = JOB_CONTROL_PAUSE; kind <= JOB_CONTROL_CANCEL; ++kind) {
+                        if (job_control_available(&jobs.items[i], kind) && CheckCollisionPointRec(mouse, job_control_bounds(i, kind))) {
+                            interacting_with.type = JOB_CONTROL;
+                            interacting_with.job_control = (JobControl){i, kind};
+                            goto interacted;
+                        }
+                    }
+                }
                 interacting_with.type = BACKGROUND;
                 goto interacted;
             }
@@ -581,7 +1331,7 @@ int main(void)
         }
 
         float mwheel_move = GetMouseWheelMove();
-        if (mwheel_move != 0) {
+        if (mwheel_move != 0 && !(compare_shown && CheckCollisionPointRec(mouse, compare_bounds))) {
             for (size_t i = 0; i < ARRAY_LEN(sliders); ++i) {
                 if(slider_check_collision_point(sliders[i], mouse)) {
                     sliders[i]->value = clamp(
@@ -590,33 +1340,192 @@ int main(void)
                                               sliders[i]->max);
                 }
             }
-
+            if (queue_grid && CheckCollisionPointRec(mouse, queue_bounds())) {
+                queue_scroll -= mwheel_move*GRID_CELL_HEIGHT;
+            }
         }
 
         if (IsMouseButtonUp(MOUSE_BUTTON_LEFT)) {
             if(interacting_with.type == RADIO_GROUP) {
                 radio_group_set_value(interacting_with.radio_group, mouse);
             }
+            if(interacting_with.type == BUTTON && interacting_with.button == &snap_btn && CheckCollisionPointRec(mouse, snap_btn.bounds)) {
+                snap_to_keyframes = !snap_to_keyframes;
+            }
+            if(interacting_with.type == BUTTON && interacting_with.button == &auto_trim_btn && CheckCollisionPointRec(mouse, auto_trim_btn.bounds)) {
+                auto_trim = !auto_trim;
+            }
+            if(interacting_with.type == BUTTON && interacting_with.button == &format_btn && CheckCollisionPointRec(mouse, format_btn.bounds)) {
+                output_format = output_format + 1 < (int) formats_count ? output_format + 1 : -1;
+                format_btn.label = output_format >= 0 ? (char*) formats[output_format].ext : "same format";
+                set_output_path(output_path, input_path, output_format);
+            }
+            if(interacting_with.type == BUTTON && interacting_with.button == &faststart_btn && CheckCollisionPointRec(mouse, faststart_btn.bounds)) {
+                faststart = !faststart;
+            }
+            if(interacting_with.type == BUTTON && interacting_with.button == &remux_btn && CheckCollisionPointRec(mouse, remux_btn.bounds)) {
+                if (input_paths.count == 0) printf("[INFO] no file is selected.\n");
+                for (size_t i = 0; i < input_paths.count; ++i) {
+                    char job_output_path[MAX_FILEPATH_SIZE] = "";
+                    set_output_path(job_output_path, (char*)input_paths.items[i], output_format);
+                    // Only what a stream copy can do: the container, the rotation and the audio offset.
+                    FfmpegParams params = {
+                        .input_path = (char*)input_paths.items[i],
+                        .output_path = job_output_path,
+                        .crf = crf.value,
+                        .volume = 100,
+                        .audio_channels = NO_MODIFICATION,
+                        .rotation = rotation,
+                        .remux = true,
+                        .faststart = faststart,
+                    };
+                    audio_offset_params_from_slider(&params, &audio_offset);
+                    run_ffmpeg(&jobs, params);
+                }
+            }
+            if(interacting_with.type == BUTTON && interacting_with.button == &rotate_btn && CheckCollisionPointRec(mouse, rotate_btn.bounds)) {
+                rotation = (rotation + 90) % 360;
+                rotate_btn.label = (char*) rotation_label(rotation);
+            }
+            if(interacting_with.type == BUTTON && interacting_with.button == &screen_btn && CheckCollisionPointRec(mouse, screen_btn.bounds)) {
+                screen_recording = !screen_recording;
+            }
+            if(interacting_with.type == BUTTON && interacting_with.button == &grid_btn && CheckCollisionPointRec(mouse, grid_btn.bounds)) {
+                queue_grid = !queue_grid;
+                grid_btn.label = queue_grid ? "list" : "grid";
+            }
+            if(interacting_with.type == BUTTON && interacting_with.button == &compare_btn && CheckCollisionPointRec(mouse, compare_btn.bounds)) {
+                compare_shown = !compare_shown;
+                compare_btn.label = compare_shown ? "close" : "A/B";
+                if (compare_shown) {
+                    FfmpegParams params = {
+                        .input_path = input_path,
+                        .output_path = output_path,
+                        .crf = crf.value,
+                        .crop_top = crop_top.value,
+                        .crop_bottom = crop_bottom.value,
+                        .crop_left = crop_left.value,
+                        .crop_right = crop_right.value,
+                        .volume = volume.value,
+                        .audio_channels = audio_channnels_radio_group.selected_value,
+                        .brightness = eq_brightness.value - 100,
+                        .contrast = eq_contrast.value - 100,
+                        .saturation = eq_saturation.value - 100,
+                        .gamma = eq_gamma.value - 100,
+                        .rotation = rotation,
+                        .input_rotation = input.probe.rotation,
+                        .screen_recording = screen_recording,
+                    };
+                    compare_start(&compare, params, &input.probe, scrubbed_slider(&last_interacted_with, &trim_in, &trim_out)->value);
+                }
+            }
+            if(interacting_with.type == BUTTON && interacting_with.button == &listen_btn && CheckCollisionPointRec(mouse, listen_btn.bounds)) {
+                if (audio_preview_playing()) {
+                    audio_preview_stop();
+                } else {
+                    audio_preview_start(input_path, scrubbed_slider(&last_interacted_with, &trim_in, &trim_out)->value, input.probe.channels);
+                }
+            }
+            if(interacting_with.type == BUTTON && interacting_with.button == &analyze_btn && CheckCollisionPointRec(mouse, analyze_btn.bounds)) {
+                if (input.analyzed) {
+                    input_info_apply_crop(&input, &crop_top, &crop_bottom, &crop_left, &crop_right);
+                } else {
+                    input_info_request_analysis(&input, input_path);
+                }
+            }
+            if(interacting_with.type == BUTTON && interacting_with.button == &monitor_btn && CheckCollisionPointRec(mouse, monitor_btn.bounds)) {
+                monitor_jobs = !monitor_jobs;
+                monitor_btn.label = monitor_jobs ? "monitor on" : "monitor off";
+            }
+            if(interacting_with.type == BUTTON && interacting_with.button == &compare_mode_btn && CheckCollisionPointRec(mouse, compare_mode_btn.bounds)) {
+                compare_mode = (compare_mode + 1) % COMPARE_MODE_COUNT;
+                compare_mode_btn.label = (char*) compare_mode_name(compare_mode);
+            }
+            if(interacting_with.type == BUTTON && interacting_with.button == &join_btn && CheckCollisionPointRec(mouse, join_btn.bounds)) {
+                if (input_paths.count < 2) {
+                    printf("[INFO] select at least two files to join.\n");
+                } else {
+                    char **paths = malloc(input_paths.count * sizeof(*paths));
+                    for (size_t i = 0; i < input_paths.count; ++i) paths[i] = (char*)input_paths.items[i];
+                    concat_sort_chapters(paths, input_paths.count);
+                    char joined_output_path[MAX_FILEPATH_SIZE] = "";
+                    set_joined_output_path(joined_output_path, paths[0], output_format);
+                    FfmpegParams params = {
+                        .input_path = paths[0],
+                        .output_path = joined_output_path,
+                        .crf = crf.value,
+                        .crop_top = crop_top.value,
+                        .crop_bottom = crop_bottom.value,
+                        .crop_left = crop_left.value,
+                        .crop_right = crop_right.value,
+                        .volume = volume.value,
+                        .audio_channels = audio_channnels_radio_group.selected_value,
+                        .brightness = eq_brightness.value - 100,
+                        .contrast = eq_contrast.value - 100,
+                        .saturation = eq_saturation.value - 100,
+                        .gamma = eq_gamma.value - 100,
+                        .screen_recording = screen_recording,
+                        .faststart = faststart,
+                        .concat_paths = paths,
+                        .concat_count = input_paths.count,
+                    };
+                    run_ffmpeg(&jobs, params);
+                    free(paths);
+                }
+            }
             if(interacting_with.type == BUTTON && interacting_with.button == &submit_btn && CheckCollisionPointRec(mouse, submit_btn.bounds)) {
-                FfmpegParams params = {
-                    .input_path = input_path,
-                    .output_path = output_path,
-                    .crf = crf.value,
-                    .crop_top = crop_top.value,
-                    .crop_bottom = crop_bottom.value,
-                    .crop_left = crop_left.value,
-                    .crop_right = crop_right.value,
-                    .volume = volume.value,
-                    .audio_channels = audio_channnels_radio_group.selected_value,
-                };
-                run_ffmpeg(params);
+                if (input_paths.count == 0) printf("[INFO] no file is selected.\n");
+                for (size_t i = 0; i < input_paths.count; ++i) {
+                    char job_output_path[MAX_FILEPATH_SIZE] = "";
+                    set_output_path(job_output_path, (char*)input_paths.items[i], output_format);
+                    FfmpegParams params = {
+                        .input_path = (char*)input_paths.items[i],
+                        .output_path = job_output_path,
+                        .crf = crf.value,
+                        .crop_top = crop_top.value,
+                        .crop_bottom = crop_bottom.value,
+                        .crop_left = crop_left.value,
+                        .crop_right = crop_right.value,
+                        .volume = volume.value,
+                        .audio_channels = audio_channnels_radio_group.selected_value,
+                        .brightness = eq_brightness.value - 100,
+                        .contrast = eq_contrast.value - 100,
+                        .saturation = eq_saturation.value - 100,
+                        .gamma = eq_gamma.value - 100,
+                        .rotation = rotation,
+                        .monitor = monitor_jobs,
+                        .screen_recording = screen_recording,
+                        .faststart = faststart,
+                    };
+                    trim_params_from_sliders(&params, &trim_in, &trim_out);
+                    audio_offset_params_from_slider(&params, &audio_offset);
+                    submit_trimmed(&jobs, params, snap_to_keyframes, auto_trim);
+                }
+            }
+            if (interacting_with.type == JOB_CONTROL) {
+                JobControl control = interacting_with.job_control;
+                if (CheckCollisionPointRec(mouse, job_control_bounds(control.job, control.kind))) {
+                    if (control.kind == JOB_CONTROL_CANCEL) {
+                        jobs_cancel(&jobs, control.job);
+                    } else if (jobs.items[control.job].state == JOB_PAUSED) {
+                        jobs_resume(&jobs, control.job);
+                    } else {
+                        jobs_pause(&jobs, control.job);
+                    }
+                }
             }
             interacting_with.type = NOTHING;
         }
 
+        pool_drain();
+        controller_update(&controller, &jobs);
+        jobs_update(&jobs);
+
         BeginDrawing();
             ClearBackground(GetColor(0xffffffff));
-            DrawText(TextFormat("input path: %s", input_path),
+            DrawText(input_paths.count > 1
+                         ? TextFormat("input path: %s (+%zu more)", input_path, input_paths.count - 1)
+                         : TextFormat("input path: %s", input_path),
                      0,
                      0,
                      18,
@@ -626,6 +1535,9 @@ int main(void)
                      50,
                      18,
                      BLACK);
+            DrawText(input_info_analysis_summary(&input), 0, 26, 14, DARKGRAY);
+            analyze_btn.label = input.analyzed ? "use crop" : "analyze";
+            button_draw(&analyze_btn, interacting_with.type == BUTTON && interacting_with.button == &analyze_btn);
 
             slider_draw(&crf, "crf");
             slider_draw(&crop_top, "crop top");
@@ -633,12 +1545,157 @@ int main(void)
             slider_draw(&crop_left, "crop left");
             slider_draw(&crop_right, "crop right");
             slider_draw(&volume, "volume");
+            slider_draw(&trim_in, "trim in");
+            slider_draw(&trim_out, "trim out");
+            slider_draw(&eq_brightness, "brightness");
+            slider_draw(&eq_contrast, "contrast");
+            slider_draw(&eq_saturation, "saturation");
+            slider_draw(&eq_gamma, "gamma");
+            slider_draw(&audio_offset, "audio offset");
+            button_draw(&rotate_btn, interacting_with.type == BUTTON && interacting_with.button == &rotate_btn);
+            button_draw(&snap_btn, snap_to_keyframes || (interacting_with.type == BUTTON && interacting_with.button == &snap_btn));
+            button_draw(&auto_trim_btn, auto_trim || (interacting_with.type == BUTTON && interacting_with.button == &auto_trim_btn));
+            button_draw(&format_btn, interacting_with.type == BUTTON && interacting_with.button == &format_btn);
+            button_draw(&faststart_btn, faststart || (interacting_with.type == BUTTON && interacting_with.button == &faststart_btn));
+            button_draw(&remux_btn, interacting_with.type == BUTTON && interacting_with.button == &remux_btn);
+            button_draw(&screen_btn, screen_recording || (interacting_with.type == BUTTON && interacting_with.button == &screen_btn));
             button_draw(&submit_btn, interacting_with.type == BUTTON && interacting_with.button == &submit_btn);
+            button_draw(&join_btn, interacting_with.type == BUTTON && interacting_with.button == &join_btn);
             radio_group_draw(&audio_channnels_radio_group);
+
+            {
+                FfmpegParams params = {
+                    .input_path = input_path,
+                    .output_path = output_path,
+                    .crf = crf.value,
+                    .crop_top = crop_top.value,
+                    .crop_bottom = crop_bottom.value,
+                    .crop_left = crop_left.value,
+                    .crop_right = crop_right.value,
+                    .volume = volume.value,
+                    .audio_channels = audio_channnels_radio_group.selected_value,
+                    .brightness = eq_brightness.value - 100,
+                    .contrast = eq_contrast.value - 100,
+                    .saturation = eq_saturation.value - 100,
+                    .gamma = eq_gamma.value - 100,
+                    .rotation = rotation,
+                    .screen_recording = screen_recording,
+                };
+                audio_offset_params_from_slider(&params, &audio_offset);
+                preview_request(&preview, params, &input.probe, scrubbed_slider(&last_interacted_with, &trim_in, &trim_out)->value);
+                audio_preview_set(params);
+                listen_btn.label = audio_preview_playing() ? "stop" : "listen";
+                button_draw(&listen_btn, interacting_with.type == BUTTON && interacting_with.button == &listen_btn);
+                button_draw(&monitor_btn, interacting_with.type == BUTTON && interacting_with.button == &monitor_btn);
+                // While a monitored encode runs its output takes the place of the still preview.
+                Job *monitored = monitor_jobs ? monitor_update(&monitor, &jobs) : NULL;
+                if (monitored != NULL) {
+                    monitor_draw(&monitor, monitored, preview_bounds);
+                } else {
+                    eq_shader_begin(&eq, params);
+                    preview_draw(&preview, preview_bounds);
+                    eq_shader_end(&eq);
+                }
+
+                trim_params_from_sliders(&params, &trim_in, &trim_out);
+                if (params.trim_in > 0 || params.trim_out > 0) input_info_request_keyframes(&input, input_path);
+                Trim_Plan plan;
+                Vector2 plan_position = {trim_in.bounds.x, trim_in.bounds.y + slider_height + 6};
+                if (!trim_params_plan(&params, &input.keyframes, &input.probe, snap_to_keyframes, &plan)) {
+                    DrawText("trim: out must be after in", plan_position.x, plan_position.y, 12, RED);
+                } else if (plan.mode != TRIM_NONE) {
+                    DrawText(TextFormat("trim: %s %.2fs-%.2fs%s, ~%.0fs",
+                                        plan.mode == TRIM_COPY ? "stream copy" : plan.mode == TRIM_SMART ? "smart render" : "re-encode",
+                                        plan.in,
+                                        plan.out > 0 ? plan.out : input.probe.duration,
+                                        plan.snapped ? " (snapped to keyframes)" : "",
+                                        jobs_estimate(&jobs, params, &input.probe)),
+                             plan_position.x, plan_position.y, 12, DARKGRAY);
+                } else if (params.stream_copy) {
+                    DrawText(TextFormat("rotation/audio offset: stream copy, ~%.0fs", jobs_estimate(&jobs, params, &input.probe)),
+                             plan_position.x, plan_position.y, 12, DARKGRAY);
+                }
+            }
+            if (compare_shown) {
+                compare_draw(&compare, compare_bounds, compare_mode);
+                button_draw(&compare_mode_btn, interacting_with.type == BUTTON && interacting_with.button == &compare_mode_btn);
+            }
+            button_draw(&compare_btn, interacting_with.type == BUTTON && interacting_with.button == &compare_btn);
+            if (jobs.batch_started_at > 0) {
+                DrawText(TextFormat("batch: predicted %.0fs, elapsed %.0fs",
+                                    jobs.batch_predicted,
+                                    (double)(nob_nanos_since_unspecified_epoch() - jobs.batch_started_at) / NOB_NANOS_PER_SEC),
+                         20, 392, 14, DARKGRAY);
+            } else if (jobs.last_batch_actual > 0) {
+                DrawText(TextFormat("last batch: predicted %.0fs, actual %.0fs",
+                                    jobs.last_batch_predicted,
+                                    jobs.last_batch_actual),
+                         20, 392, 14, DARKGRAY);
+            }
+            DrawText(TextFormat("jobs at once: %zu | cpu %d%% iowait %d%% | %.1fG free | %s",
+                                controller.target,
+                                (int)(controller.cpu_usage*100),
+                                (int)(controller.iowait*100),
+                                controller.mem_available / 1e9,
+                                controller.decision),
+                     20,
+                     410,
+                     14,
+                     DARKGRAY);
+            button_draw(&grid_btn, interacting_with.type == BUTTON && interacting_with.button == &grid_btn);
+            if (queue_grid) queue_grid_draw(&thumbs, &jobs, &queue_scroll);
+            for (size_t i = 0; i < jobs.count && !queue_grid; ++i) {
+                Job *job = &jobs.items[i];
+                BeginScissorMode(0, QUEUE_Y + i*16, GetScreenWidth() - JOB_CONTROLS_WIDTH - 6, 16);
+                DrawText(TextFormat("[%s%s] %s %zut %.1f/%.1fs (~%.0fs) %.2fx %.1f cores %dM%s%s",
+                                    job_state_name(job->state),
+                                    job->params.smart_render ? TextFormat(" %zu/%d", job->step + 1, TRIM_STEP_COUNT) : "",
+                                    nob_path_name(job->params.input_path),
+                                    job->threads,
+                                    job->out_time,
+                                    job->probe.duration,
+                                    job->predicted,
+                                    job->speed,
+                                    job->cpu_usage,
+                                    (int)(job->rss / (1024*1024)),
+                                    job_dead_air_label(job),
+                                    job_screen_label(job)),
+                         20,
+                         QUEUE_Y + i*16,
+                         14,
+                         job->state == JOB_FAILED ? RED : BLACK);
+                EndScissorMode();
+                for (JobControlKind kind = JOB_CONTROL_PAUSE; kind <= JOB_CONTROL_CANCEL; ++kind) {
+                    if (!job_control_available(job, kind)) continue;
+                    Button btn = {
+                        .bounds = job_control_bounds(i, kind),
+                        .label = job_control_label(job, kind),
+                        .font_size = 12,
+                    };
+                    button_draw(&btn, interacting_with.type == JOB_CONTROL
+                                      && interacting_with.job_control.job == i
+                                      && interacting_with.job_control.kind == kind);
+                }
+            }
         EndDrawing();
     }
 
+    preview_cancel(&preview);
+    input_info_cancel_analysis(&input);
+    atomic_store(&submit_cancel, true);
+    pool_shutdown();
+    thumbs_free(&thumbs);
+    preview_free(&preview);
+    compare_free(&compare);
+    eq_shader_unload(&eq);
+    if (monitor.texture.id != 0) UnloadTexture(monitor.texture);
+    audio_preview_shutdown();
     CloseWindow();
+    keyframe_index_free(&input.keyframes);
+    analysis_free(&input.analysis);
+    jobs_shutdown(&jobs);
+    launcher_shutdown();
+    jobs_free(&jobs);
 
     return 0;
 }
@@ -90,7 +90,7 @@ int main(int argc, char **argv)
     nob_cc(&cmd);
     nob_cc_flags(&cmd);
     nob_cc_output(&cmd, "vp");
-    nob_cc_inputs(&cmd, "main.c");
+    nob_cc_inputs(&cmd, "main.c", "ffmpeg.c", "jobs.c", "launcher.c", "scheduler.c", "bench.c", "controller.c", "cache.c", "probe.c", "keyframes.c", "trim.c", "concat.c", "container.c", "pool.c", "thumbs.c", "freedesktop.c", "frame_cache.c", "preview.c", "compare.c", "eq_shader.c", "audio_preview.c", "analysis.c", "formats.c", "result_cache.c");
     /* nob_cmd_append(&cmd, "-fsanitize=address"); */
     nob_cmd_append(&cmd, "-I.");
     nob_cmd_append(&cmd, "-I"RAYLIB_SRC_FOLDER);
@@ -0,0 +1,236 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./pool.h"
+#include "./thirdparty/nob.h"
+
+typedef struct {
+    Pool_Fn work;
+    Pool_Fn done;
+    void *arg;
+} Pool_Task;
+
+typedef struct {
+    Pool_Task *items;
+    size_t count;
+    size_t capacity;
+} Pool_Tasks;
+
+// Ring buffer, `capacity` is 0 or a power of two.
+typedef struct {
+    Pool_Task *items;
+    size_t head;
+    size_t count;
+    size_t capacity;
+} Pool_Deque;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock; // of the deque, taken by the owner and by thieves
+    Pool_Deque deque;
+    size_t index;
+} Pool_Worker;
+
+static struct {
+    bool running;
+    Pool_Worker workers[POOL_MAX_WORKERS];
+    size_t worker_count;
+    size_t next; // worker that gets the next task from the UI thread
+
+    pthread_mutex_t lock; // of everything below
+    pthread_cond_t wake;
+    size_t queued; // tasks in all the deques together
+    atomic_bool stop;
+    Pool_Tasks completed;
+
+    atomic_size_t pending;
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+static _Thread_local Pool_Worker *pool_self = NULL;
+
+
+static void pool_deque_push(Pool_Deque *deque, Pool_Task task) {
+    if (deque->count == deque->capacity) {
+        size_t capacity = deque->capacity > 0 ? deque->capacity*2 : 64;
+        Pool_Task *items = malloc(capacity*sizeof(*items));
+        NOB_ASSERT(items != NULL && "Buy more RAM lol");
+        for (size_t i = 0; i < deque->count; ++i) items[i] = deque->items[(deque->head + i) & (deque->capacity - 1)];
+        free(deque->items);
+        deque->items = items;
+        deque->head = 0;
+        deque->capacity = capacity;
+    }
+    deque->items[(deque->head + deque->count) & (deque->capacity - 1)] = task;
+    deque->count += 1;
+}
+
+
+static bool pool_deque_pop_front(Pool_Deque *deque, Pool_Task *task) {
+    if (deque->count == 0) return false;
+    *task = deque->items[deque->head];
+    deque->head = (deque->head + 1) & (deque->capacity - 1);
+    deque->count -= 1;
+    return true;
+}
+
+
+static bool pool_deque_pop_back(Pool_Deque *deque, Pool_Task *task) {
+    if (deque->count == 0) return false;
+    deque->count -= 1;
+    *task = deque->items[(deque->head + deque->count) & (deque->capacity - 1)];
+    return true;
+}
+
+
+// Own deque first, in submission order, then the other workers starting with the next one.
+static bool pool_take(Pool_Worker *self, Pool_Task *task) {
+    pthread_mutex_lock(&self->lock);
+    bool found = pool_deque_pop_front(&self->deque, task);
+    pthread_mutex_unlock(&self->lock);
+
+    for (size_t i = 1; !found && i < pool.worker_count; ++i) {
+        Pool_Worker *victim = &pool.workers[(self->index + i) % pool.worker_count];
+        pthread_mutex_lock(&victim->lock);
+        found = pool_deque_pop_back(&victim->deque, task);
+        pthread_mutex_unlock(&victim->lock);
+    }
+    if (!found) return false;
+
+    pthread_mutex_lock(&pool.lock);
+    pool.queued -= 1;
+    pthread_mutex_unlock(&pool.lock);
+    return true;
+}
+
+
+static void *pool_worker(void *arg) {
+    Pool_Worker *self = arg;
+    pool_self = self;
+    while (!atomic_load(&pool.stop)) {
+        Pool_Task task;
+        if (!pool_take(self, &task)) {
+            pthread_mutex_lock(&pool.lock);
+            while (pool.queued == 0 && !atomic_load(&pool.stop)) pthread_cond_wait(&pool.wake, &pool.lock);
+            pthread_mutex_unlock(&pool.lock);
+            // Somebody else may get to the task first, then we just go back to sleep.
+            continue;
+        }
+
+        task.work(task.arg);
+
+        pthread_mutex_lock(&pool.lock);
+        nob_da_append(&pool.completed, task);
+        pthread_mutex_unlock(&pool.lock);
+    }
+    return NULL;
+}
+
+
+// Stops the first `started` workers and frees everything.
+static void pool_join(size_t started) {
+    pthread_mutex_lock(&pool.lock);
+    atomic_store(&pool.stop, true);
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (size_t i = 0; i < started; ++i) pthread_join(pool.workers[i].thread, NULL);
+    for (size_t i = 0; i < pool.worker_count; ++i) {
+        Pool_Worker *worker = &pool.workers[i];
+        pthread_mutex_destroy(&worker->lock);
+        free(worker->deque.items);
+        memset(&worker->deque, 0, sizeof(worker->deque));
+    }
+    pool.worker_count = 0;
+    pool.queued = 0;
+    nob_da_free(pool.completed);
+    memset(&pool.completed, 0, sizeof(pool.completed));
+    atomic_store(&pool.pending, 0);
+    pool.running = false;
+}
+
+
+bool pool_init(size_t workers) {
+    if (pool.running) return true;
+    if (workers == 0) workers = nob_nprocs();
+    if (workers < 1) workers = 1;
+    if (workers > POOL_MAX_WORKERS) workers = POOL_MAX_WORKERS;
+
+    // Every worker may steal from every other one, they all exist before the first thread starts.
+    atomic_store(&pool.stop, false);
+    pool.worker_count = workers;
+    for (size_t i = 0; i < workers; ++i) {
+        memset(&pool.workers[i], 0, sizeof(pool.workers[i]));
+        pool.workers[i].index = i;
+        pthread_mutex_init(&pool.workers[i].lock, NULL);
+    }
+    size_t started = 0;
+    for (; started < workers; ++started) {
+        int ret = pthread_create(&pool.workers[started].thread, NULL, pool_worker, &pool.workers[started]);
+        if (ret != 0) {
+            nob_log(NOB_ERROR, "could not start worker thread: %s", strerror(ret));
+            break;
+        }
+    }
+    pool.running = true;
+    if (started < workers) {
+        pool_join(started);
+        return false;
+    }
+    return true;
+}
+
+
+void pool_shutdown(void) {
+    if (!pool.running) return;
+    pool_join(pool.worker_count);
+}
+
+
+void pool_submit(Pool_Fn work, Pool_Fn done, void *arg) {
+    if (!pool.running) {
+        work(arg);
+        if (done != NULL) done(arg);
+        return;
+    }
+
+    atomic_fetch_add(&pool.pending, 1);
+    Pool_Worker *worker = pool_self != NULL ? pool_self : &pool.workers[pool.next++ % pool.worker_count];
+    // Holding the pool lock around the push keeps `queued` from going below zero when
+    // a thief takes the task before it's counted.
+    pthread_mutex_lock(&pool.lock);
+    pthread_mutex_lock(&worker->lock);
+    pool_deque_push(&worker->deque, (Pool_Task){work, done, arg});
+    pthread_mutex_unlock(&worker->lock);
+    pool.queued += 1;
+    pthread_cond_signal(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+
+size_t pool_drain(void) {
+    if (!pool.running) return 0;
+
+    // Swap the queue out so the callbacks run without the lock and can submit more tasks.
+    pthread_mutex_lock(&pool.lock);
+    Pool_Tasks completed = pool.completed;
+    memset(&pool.completed, 0, sizeof(pool.completed));
+    pthread_mutex_unlock(&pool.lock);
+
+    for (size_t i = 0; i < completed.count; ++i) {
+        if (completed.items[i].done != NULL) completed.items[i].done(completed.items[i].arg);
+    }
+    size_t count = completed.count;
+    atomic_fetch_sub(&pool.pending, count);
+    nob_da_free(completed);
+    return count;
+}
+
+
+size_t pool_pending(void) {
+    return atomic_load(&pool.pending);
+}
@@ -0,0 +1,38 @@
+#ifndef POOL_H_
+#define POOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Background workers for everything that isn't an ffmpeg job but is too slow for the UI thread:
+// probing, keyframe indexing, thumbnails, hashing...
+//
+// Every worker has its own deque. Tasks submitted from the UI thread are dealt round-robin,
+// tasks submitted from a worker go to the deque of that worker. A worker takes the oldest task
+// of its own deque and, when that is empty, steals the newest one of another worker, so a long
+// probe doesn't hold up the tasks queued behind it.
+//
+// `work` runs on a worker. When it returns, the task goes to a completion queue and its `done`
+// runs on the UI thread during the next pool_drain(), so it can touch the UI state without locks.
+
+#define POOL_MAX_WORKERS 64
+
+typedef void (*Pool_Fn)(void *arg);
+
+// Starts `workers` threads, 0 means nob_nprocs().
+bool pool_init(size_t workers);
+
+// Joins the workers. Tasks that haven't started yet are dropped and their `done` is never called.
+void pool_shutdown(void);
+
+// Queues `work(arg)`, followed by `done(arg)` on the UI thread. `done` may be NULL. When the pool
+// isn't running (benchmarks, tests) both run right away on the calling thread.
+void pool_submit(Pool_Fn work, Pool_Fn done, void *arg);
+
+// Runs the `done` of the finished tasks and returns how many there were. Call once per frame.
+size_t pool_drain(void);
+
+// Tasks submitted and not drained yet.
+size_t pool_pending(void);
+
+#endif // POOL_H_
@@ -0,0 +1,206 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./frame_cache.h"
+#include "./launcher.h"
+#include "./pool.h"
+#include "./preview.h"
+
+struct Preview_Task {
+    Preview *preview;
+    Preview_Frame frame; // owns the strings
+    atomic_bool cancel;
+    unsigned char *pixels; // RGBA, NULL when the render failed
+};
+
+
+// The longest side becomes PREVIEW_SIZE, both sides even for the chroma subsampling.
+static void preview_fit_size(int width, int height, int *w, int *h) {
+    if (width >= height) {
+        *w = PREVIEW_SIZE;
+        *h = (int)((double) PREVIEW_SIZE * height / width + 0.5);
+    } else {
+        *h = PREVIEW_SIZE;
+        *w = (int)((double) PREVIEW_SIZE * width / height + 0.5);
+    }
+    *w = *w / 2 * 2 > 0 ? *w / 2 * 2 : 2;
+    *h = *h / 2 * 2 > 0 ? *h / 2 * 2 : 2;
+}
+
+
+// Runs on the pool. The frame cache first, otherwise
+//   ffmpeg -ss 12.000 -i in.mp4 -frames:v 1 -vf crop=...,scale=256:144 -pix_fmt rgba -f rawvideo pipe:1
+// with -ss before -i, so ffmpeg seeks to the keyframe before and only decodes from there.
+static void preview_render_work(void *arg) {
+    Preview_Task *task = arg;
+    const Preview_Frame *frame = &task->frame;
+    Image cached;
+    if (frame_cache_load(frame->path, frame->time, frame->filter, &cached)) {
+        if (cached.width == frame->width && cached.height == frame->height) {
+            task->pixels = cached.data;
+            return;
+        }
+        UnloadImage(cached);
+    }
+    if (atomic_load(&task->cancel)) return;
+
+    char seek[32];
+    snprintf(seek, sizeof(seek), "%.3f", frame->time);
+    Nob_Cmd cmd = {0};
+    Nob_String_Builder out = {0};
+    nob_cmd_append(&cmd, "ffmpeg", "-v", "error", "-nostdin", "-ss", seek, "-i", frame->path);
+    nob_cmd_append(&cmd, "-frames:v", "1", "-an", "-vf", frame->filter, "-pix_fmt", "rgba", "-f", "rawvideo", "pipe:1");
+    if (launcher_run_sync_cancellable(cmd, &out, &task->cancel) && out.count == (size_t) frame->width*frame->height*4) {
+        task->pixels = (unsigned char*) out.items;
+        frame_cache_store(frame->path, frame->time, frame->filter, (Image){task->pixels, frame->width, frame->height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8});
+    } else {
+        nob_sb_free(out);
+    }
+    nob_cmd_free(cmd);
+}
+
+
+static bool preview_frame_equal(const Preview_Frame *a, const Preview_Frame *b) {
+    return a->path != NULL && b->path != NULL
+        && strcmp(a->path, b->path) == 0
+        && strcmp(a->filter, b->filter) == 0
+        && a->time == b->time;
+}
+
+
+static Preview_Frame preview_frame_copy(const Preview_Frame *frame) {
+    Preview_Frame copy = *frame;
+    copy.path = strdup(frame->path);
+    copy.filter = strdup(frame->filter);
+    return copy;
+}
+
+
+static void preview_frame_free(Preview_Frame *frame) {
+    free(frame->path);
+    free(frame->filter);
+    memset(frame, 0, sizeof(*frame));
+}
+
+
+static void preview_task_free(Preview_Task *task) {
+    preview_frame_free(&task->frame);
+    free(task->pixels);
+    free(task);
+}
+
+
+static void preview_render_done(void *arg) {
+    Preview_Task *task = arg;
+    Preview *preview = task->preview;
+    // Killed, or replaced by a newer render.
+    if (task != preview->rendering) {
+        preview_task_free(task);
+        return;
+    }
+    preview->rendering = NULL;
+
+    preview->ready = false;
+    if (task->pixels != NULL) {
+        Texture2D *texture = &preview->texture;
+        if (texture->id != 0 && texture->width == task->frame.width && texture->height == task->frame.height) {
+            UpdateTexture(*texture, task->pixels);
+        } else {
+            if (texture->id != 0) UnloadTexture(*texture);
+            *texture = LoadTextureFromImage((Image){task->pixels, task->frame.width, task->frame.height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8});
+            SetTextureFilter(*texture, TEXTURE_FILTER_BILINEAR);
+        }
+        preview->ready = texture->id != 0;
+    }
+    preview_frame_free(&preview->shown);
+    preview->shown = task->frame;
+    memset(&task->frame, 0, sizeof(task->frame));
+    preview_task_free(task);
+}
+
+
+void preview_cancel(Preview *preview) {
+    if (preview->rendering == NULL) return;
+    atomic_store(&preview->rendering->cancel, true);
+    preview->rendering = NULL;
+}
+
+
+void preview_request(Preview *preview, FfmpegParams params, const Probe *probe, double time) {
+    if (strlen(params.input_path) == 0 || !probe->ok || probe->width <= 0 || probe->height <= 0) return;
+    // ffmpeg turns the frames the way players show them before any filter.
+    bool turned = probe->rotation % 180 == 90;
+    int width = (turned ? probe->height : probe->width) - params.crop_left - params.crop_right;
+    int height = (turned ? probe->width : probe->height) - params.crop_top - params.crop_bottom;
+    if (width <= 0 || height <= 0) {
+        // Cropped away entirely, there is nothing to show.
+        preview_cancel(preview);
+        preview_frame_free(&preview->wanted);
+        preview_frame_free(&preview->shown);
+        preview->ready = false;
+        return;
+    }
+    // Seeking right to the end gives no frame at all.
+    if (probe->duration > 0.5 && time > probe->duration - 0.5) time = probe->duration - 0.5;
+
+    // The color settings are the eq shader's job, so moving them doesn't render anything.
+    params.brightness = params.contrast = params.saturation = params.gamma = 0;
+    // A single frame has no duplicates to drop.
+    params.screen_recording = false;
+
+    // The filter of the encode is in the temporary storage, which only the UI thread may use.
+    size_t checkpoint = nob_temp_save();
+    Preview_Frame frame = {.path = params.input_path, .time = time};
+    if (params.rotation % 180 == 90) {
+        int t = width;
+        width = height;
+        height = t;
+    }
+    preview_fit_size(width, height, &frame.width, &frame.height);
+    const char *video = ffmpeg_video_filter(params);
+    frame.filter = nob_temp_sprintf("%s%sscale=%d:%d", video != NULL ? video : "", video != NULL ? "," : "", frame.width, frame.height);
+    if (!preview_frame_equal(&frame, &preview->wanted)) {
+        preview_frame_free(&preview->wanted);
+        preview->wanted = preview_frame_copy(&frame);
+        preview->wanted_since = GetTime();
+    }
+    nob_temp_rewind(checkpoint);
+
+    if (preview_frame_equal(&preview->wanted, &preview->shown)) {
+        preview_cancel(preview);
+        return;
+    }
+    if (preview->rendering != NULL && preview_frame_equal(&preview->rendering->frame, &preview->wanted)) return;
+    if (GetTime() - preview->wanted_since < PREVIEW_DEBOUNCE) return;
+
+    preview_cancel(preview);
+    Preview_Task *task = calloc(1, sizeof(*task));
+    task->preview = preview;
+    task->frame = preview_frame_copy(&preview->wanted);
+    // Set before submitting: without a pool the render is done by the time pool_submit() returns.
+    preview->rendering = task;
+    pool_submit(preview_render_work, preview_render_done, task);
+}
+
+
+void preview_draw(const Preview *preview, Rectangle dest) {
+    DrawRectangleRec(dest, LIGHTGRAY);
+    if (!preview->ready) return;
+
+    Rectangle source = {0, 0, preview->texture.width, preview->texture.height};
+    float scale = dest.width / source.width;
+    if (source.height*scale > dest.height) scale = dest.height / source.height;
+    float width = source.width*scale, height = source.height*scale;
+    Rectangle fitted = {dest.x + (dest.width - width)/2, dest.y + (dest.height - height)/2, width, height};
+    DrawTexturePro(preview->texture, source, fitted, (Vector2){0}, 0, WHITE);
+}
+
+
+void preview_free(Preview *preview) {
+    if (preview->texture.id != 0) UnloadTexture(preview->texture);
+    preview_frame_free(&preview->shown);
+    preview_frame_free(&preview->wanted);
+    memset(preview, 0, sizeof(*preview));
+}
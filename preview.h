@@ -0,0 +1,55 @@
+#ifndef PREVIEW_H_
+#define PREVIEW_H_
+
+#include <stdbool.h>
+
+#include "./ffmpeg.h"
+#include "./probe.h"
+#include "./thirdparty/raylib/src/raylib.h"
+
+// Still frame of the input at the trim point being moved, rendered through the same -vf chain
+// the encode is going to use, so you see the crop before you hit "run".
+//
+// A render starts once the settings have stopped changing for PREVIEW_DEBOUNCE seconds, so
+// dragging a slider doesn't start one ffmpeg per frame. A new render kills the one in flight,
+// and results that come back after the settings changed are dropped, so the preview never works
+// through stale requests. The frames go through frame_cache, so scrubbing a file you've seen
+// before is instant.
+
+#define PREVIEW_SIZE 256 // longest side of the rendered frame in pixels
+#define PREVIEW_DEBOUNCE 0.15 // seconds
+
+typedef struct {
+    char *path;
+    double time;
+    char *filter; // the whole -vf chain, ending in the scale to the preview size
+    int width; // of the rendered frame
+    int height;
+} Preview_Frame;
+
+typedef struct Preview_Task Preview_Task;
+
+typedef struct {
+    Texture2D texture; // id is 0 until the first frame arrives
+    bool ready; // the texture holds `shown`
+    Preview_Frame shown;
+    Preview_Frame wanted;
+    double wanted_since; // GetTime() of the last change of `wanted`
+    Preview_Task *rendering; // the latest render in flight, NULL when there is none
+} Preview;
+
+// Asks for the frame of `params.input_path` at `time` seconds with the crop of `params`. The
+// color settings are left out, draw the preview inside eq_shader_begin()/eq_shader_end().
+// Cheap when nothing changed, call it every frame.
+void preview_request(Preview *preview, FfmpegParams params, const Probe *probe, double time);
+
+// Draws the frame fitted into `dest`, or an empty box while there is none.
+void preview_draw(const Preview *preview, Rectangle dest);
+
+// Kills the render in flight. Call before pool_shutdown(), so it doesn't wait for ffmpeg.
+void preview_cancel(Preview *preview);
+
+// Call after pool_shutdown() and before CloseWindow().
+void preview_free(Preview *preview);
+
+#endif // PREVIEW_H_
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./container.h"
+#include "./launcher.h"
+#include "./probe.h"
+
+#define PROBE_MAX_STREAMS 16
+
+typedef struct {
+    char codec_type[16];
+    char codec_name[32];
+    char profile[32];
+    int level;
+    char pix_fmt[32];
+    char frame_rate[32];
+    char color_primaries[16];
+    char color_transfer[16];
+    char color_space[16];
+    char color_range[8];
+    int rotation; // counter-clockwise, as ffprobe reports it
+    int width;
+    int height;
+    int sample_rate;
+    int channels;
+} Probe_Stream;
+
+
+static void probe_copy_value(char *dst, size_t size, Nob_String_View value) {
+    // flat values are quoted: "h264"
+    if (value.count >= 2 && value.data[0] == '"') {
+        value.data += 1;
+        value.count -= 2;
+    }
+    size_t n = value.count < size - 1 ? value.count : size - 1;
+    memcpy(dst, value.data, n);
+    dst[n] = '\0';
+}
+
+
+// Parses `ffprobe -of flat` output:
+//   streams.stream.0.codec_name="h264"
+//   format.duration="12.345000"
+static void probe_parse(Nob_String_View output, Probe *probe) {
+    Probe_Stream streams[PROBE_MAX_STREAMS] = {0};
+    char value[64];
+
+    while (output.count > 0) {
+        Nob_String_View line = nob_sv_trim(nob_sv_chop_by_delim(&output, '\n'));
+        Nob_String_View key = nob_sv_chop_by_delim(&line, '=');
+
+        Nob_String_View format_prefix = nob_sv_from_cstr("format.");
+        Nob_String_View stream_prefix = nob_sv_from_cstr("streams.stream.");
+        if (nob_sv_starts_with(key, format_prefix)) {
+            nob_sv_chop_left(&key, format_prefix.count);
+            probe_copy_value(value, sizeof(value), line);
+            if (nob_sv_eq(key, nob_sv_from_cstr("duration"))) {
+                probe->duration = strtod(value, NULL);
+            } else if (nob_sv_eq(key, nob_sv_from_cstr("size"))) {
+                probe->size = strtod(value, NULL);
+            }
+        } else if (nob_sv_starts_with(key, stream_prefix)) {
+            nob_sv_chop_left(&key, stream_prefix.count);
+            Nob_String_View index = nob_sv_chop_by_delim(&key, '.');
+            char digits[16];
+            probe_copy_value(digits, sizeof(digits), index);
+            size_t i = strtoul(digits, NULL, 10);
+            if (i >= PROBE_MAX_STREAMS) continue;
+
+            Probe_Stream *stream = &streams[i];
+            probe_copy_value(value, sizeof(value), line);
+            if (nob_sv_eq(key, nob_sv_from_cstr("codec_type"))) {
+                probe_copy_value(stream->codec_type, sizeof(stream->codec_type), line);
+            } else if (nob_sv_eq(key, nob_sv_from_cstr("codec_name"))) {
+                probe_copy_value(stream->codec_name, sizeof(stream->codec_name), line);
+            } else if (nob_sv_eq(key, nob_sv_from_cstr("profile"))) {
+                probe_copy_value(stream->profile, sizeof(stream->profile), line);
+            } else if (nob_sv_eq(key, nob_sv_from_cstr("level"))) {
+                stream->level = atoi(value);
+            } else if (nob_sv_eq(key, nob_sv_from_cstr("color_primaries"))) {
+                probe_copy_value(stream->color_primaries, sizeof(stream->color_primaries), line);
+            } else if (nob_sv_eq(key, nob_sv_from_cstr("color_transfer"))) {
+                probe_copy_value(stream->color_transfer, sizeof(stream->color_transfer), line);
+            } else if (nob_sv_eq(key, nob_sv_from_cstr("color_space"))) {
+                probe_copy_value(stream->color_space, sizeof(stream->color_space), line);
+            } else if (nob_sv_eq(key, nob_sv_from_cstr("color_range"))) {
+                probe_copy_value(stream->color_range, sizeof(stream->color_range), line);
+            } else if (nob_sv_eq(key, nob_sv_from_cstr("pix_fmt"))) {
+                probe_copy_value(stream->pix_fmt, sizeof(stream->pix_fmt), line);
+            } else if (nob_sv_eq(key, nob_sv_from_cstr("r_frame_rate"))) {
+                probe_copy_value(stream->frame_rate, sizeof(stream->frame_rate), line);
+            } else if (nob_sv_eq(key, nob_sv_from_cstr("sample_rate"))) {
+                stream->sample_rate = atoi(value);
+            } else if (nob_sv_eq(key, nob_sv_from_cstr("channels"))) {
+                stream->channels = atoi(value);
+            } else if (nob_sv_eq(key, nob_sv_from_cstr("width"))) {
+                stream->width = atoi(value);
+            } else if (nob_sv_eq(key, nob_sv_from_cstr("height"))) {
+                stream->height = atoi(value);
+            } else if (nob_sv_starts_with(key, nob_sv_from_cstr("side_data_list.")) && nob_sv_end_with(key, ".rotation")) {
+                // streams.stream.0.side_data_list.side_data.0.rotation=-90
+                stream->rotation = atoi(value);
+            }
+        }
+    }
+
+    for (size_t i = PROBE_MAX_STREAMS; i-- > 0;) {
+        Probe_Stream *stream = &streams[i];
+        if (strcmp(stream->codec_type, "video") == 0) {
+            probe->width = stream->width;
+            probe->height = stream->height;
+            snprintf(probe->video_codec, sizeof(probe->video_codec), "%s", stream->codec_name);
+            snprintf(probe->video_profile, sizeof(probe->video_profile), "%s", stream->profile);
+            snprintf(probe->pix_fmt, sizeof(probe->pix_fmt), "%s", stream->pix_fmt);
+            snprintf(probe->frame_rate, sizeof(probe->frame_rate), "%s", stream->frame_rate);
+            probe->level = stream->level > 0 ? stream->level : 0; // -99 when unknown
+            // "unknown" when the stream doesn't say.
+            if (strcmp(stream->color_primaries, "unknown") != 0) snprintf(probe->color_primaries, sizeof(probe->color_primaries), "%s", stream->color_primaries);
+            if (strcmp(stream->color_transfer, "unknown") != 0) snprintf(probe->color_transfer, sizeof(probe->color_transfer), "%s", stream->color_transfer);
+            if (strcmp(stream->color_space, "unknown") != 0) snprintf(probe->color_space, sizeof(probe->color_space), "%s", stream->color_space);
+            if (strcmp(stream->color_range, "unknown") != 0) snprintf(probe->color_range, sizeof(probe->color_range), "%s", stream->color_range);
+            probe->rotation = ((-stream->rotation % 360) + 360) % 360;
+        } else if (strcmp(stream->codec_type, "audio") == 0) {
+            snprintf(probe->audio_codec, sizeof(probe->audio_codec), "%s", stream->codec_name);
+            probe->sample_rate = stream->sample_rate;
+            probe->channels = stream->channels;
+        }
+    }
+}
+
+
+bool probe_file_ffprobe(const char *path, Probe *probe) {
+    memset(probe, 0, sizeof(*probe));
+
+    Nob_Cmd cmd = {0};
+    Nob_String_Builder out = {0};
+    nob_cmd_append(&cmd, "ffprobe", "-v", "error");
+    nob_cmd_append(&cmd, "-show_entries", "stream=codec_type,codec_name,profile,level,pix_fmt,color_primaries,color_transfer,color_space,color_range,width,height,r_frame_rate,sample_rate,channels:stream_side_data=rotation:format=duration,size");
+    nob_cmd_append(&cmd, "-of", "flat", path);
+    bool ok = launcher_run_sync(cmd, &out);
+    if (ok) {
+        probe_parse(nob_sb_to_sv(out), probe);
+        probe->ok = probe->duration > 0;
+    } else {
+        nob_log(NOB_ERROR, "could not probe %s", path);
+    }
+    nob_cmd_free(cmd);
+    nob_sb_free(out);
+    return probe->ok;
+}
+
+
+bool probe_file(const char *path, Probe *probe) {
+    Container_Info info;
+    if (container_parse(path, &info, false)) {
+        *probe = info.probe;
+        container_info_free(&info);
+        return true;
+    }
+    return probe_file_ffprobe(path, probe);
+}
@@ -0,0 +1,35 @@
+#ifndef PROBE_H_
+#define PROBE_H_
+
+#include <stdbool.h>
+
+typedef struct {
+    bool ok;
+    double duration; // seconds
+    double size; // bytes
+    int width;
+    int height;
+    char video_codec[32];
+    char video_profile[32];
+    int level; // as coded: 40 is H.264 level 4, 120 is HEVC level 4, 0 when not known
+    char pix_fmt[32];
+    char frame_rate[32]; // as a fraction, e.g. "30000/1001"
+    // ffmpeg's names, e.g. "bt709" and "tv", empty when the stream doesn't say.
+    char color_primaries[16];
+    char color_transfer[16];
+    char color_space[16];
+    char color_range[8];
+    int rotation; // degrees clockwise players turn the video by, 0, 90, 180 or 270
+    char audio_codec[32];
+    int sample_rate;
+    int channels;
+} Probe;
+
+// Reads the container and first video/audio stream parameters. MP4/MOV and AVI are parsed
+// natively (see container.h), anything else or anything the parser rejects goes to ffprobe.
+bool probe_file(const char *path, Probe *probe);
+
+// Always asks ffprobe.
+bool probe_file_ffprobe(const char *path, Probe *probe);
+
+#endif // PROBE_H_
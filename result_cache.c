@@ -0,0 +1,299 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <linux/fs.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./cache.h"
+#include "./launcher.h"
+#include "./result_cache.h"
+
+#define RESULT_CACHE_DIR "results"
+#define RESULT_CACHE_INDEX "results/index.txt"
+
+// Two FNV-1a runs with different offset bases, 128 bits so a collision doesn't hand out the
+// wrong video.
+typedef struct {
+    uint64_t hi;
+    uint64_t lo;
+} Result_Cache_Hasher;
+
+
+static void result_cache_hash(Result_Cache_Hasher *h, const void *data, size_t size) {
+    h->hi = cache_hash_bytes(h->hi, data, size);
+    h->lo = cache_hash_bytes(h->lo, data, size);
+}
+
+
+static void result_cache_hash_cstr(Result_Cache_Hasher *h, const char *s) {
+    // With the terminator, so "ab" "c" and "a" "bc" differ.
+    result_cache_hash(h, s, strlen(s) + 1);
+}
+
+
+static pthread_once_t result_cache_version_once = PTHREAD_ONCE_INIT;
+static char result_cache_version[256];
+
+
+// First line of `ffmpeg -version`, e.g. "ffmpeg version 6.1.1-3ubuntu5 Copyright (c) ...".
+static void result_cache_read_version(void) {
+    Nob_Cmd cmd = {0};
+    Nob_String_Builder out = {0};
+    nob_cmd_append(&cmd, "ffmpeg", "-version");
+    if (launcher_run_sync(cmd, &out)) {
+        size_t n = 0;
+        while (n < out.count && out.items[n] != '\n' && n + 1 < sizeof(result_cache_version)) n += 1;
+        memcpy(result_cache_version, out.items, n);
+        result_cache_version[n] = '\0';
+    } else {
+        nob_log(NOB_WARNING, "could not get the ffmpeg version, cached results may be from another one");
+    }
+    nob_cmd_free(cmd);
+    nob_sb_free(out);
+}
+
+
+// The size and RESULT_CACHE_SAMPLES blocks at even steps through the file, the first one at the
+// start and the last one at the end. Small files are read whole.
+static bool result_cache_hash_file(Result_Cache_Hasher *h, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        nob_log(NOB_ERROR, "could not open %s: %s", path, strerror(errno));
+        return false;
+    }
+    bool result = true;
+    char *block = malloc(RESULT_CACHE_SAMPLE_SIZE);
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        nob_log(NOB_ERROR, "could not stat %s: %s", path, strerror(errno));
+        nob_return_defer(false);
+    }
+    uint64_t size = st.st_size;
+    result_cache_hash(h, &size, sizeof(size));
+
+    bool whole = size <= (uint64_t) RESULT_CACHE_SAMPLES*RESULT_CACHE_SAMPLE_SIZE;
+    size_t samples = whole ? (size + RESULT_CACHE_SAMPLE_SIZE - 1)/RESULT_CACHE_SAMPLE_SIZE : RESULT_CACHE_SAMPLES;
+    uint64_t last = size - RESULT_CACHE_SAMPLE_SIZE;
+    for (size_t i = 0; i < samples; ++i) {
+        uint64_t offset = whole ? (uint64_t) i*RESULT_CACHE_SAMPLE_SIZE : last*i/(RESULT_CACHE_SAMPLES - 1);
+        ssize_t n = pread(fd, block, RESULT_CACHE_SAMPLE_SIZE, offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                i -= 1;
+                continue;
+            }
+            nob_log(NOB_ERROR, "could not read %s: %s", path, strerror(errno));
+            nob_return_defer(false);
+        }
+        result_cache_hash(h, block, n);
+    }
+
+defer:
+    free(block);
+    close(fd);
+    return result;
+}
+
+
+// Everything that changes the bytes of the output. Threads, the monitor and the dead air label
+// don't, and the paths are only there through the sampled content and the output extension.
+static void result_cache_hash_params(Result_Cache_Hasher *h, FfmpegParams params) {
+    char text[1024];
+    const char *ext = strrchr(params.output_path, '.');
+    snprintf(text, sizeof(text),
+             "ext=%s crf=%d crop=%d,%d,%d,%d volume=%d channels=%d eq=%d,%d,%d,%d "
+             "rotation=%d audio_offset=%.6f trim=%.6f,%.6f copy=%d remux=%d faststart=%d "
+             "smart=%d,%.6f,%.6f screen=%d concat=%zu,%d",
+             ext != NULL ? ext : "",
+             params.crf,
+             params.crop_top, params.crop_bottom, params.crop_left, params.crop_right,
+             params.volume, params.audio_channels,
+             params.brightness, params.contrast, params.saturation, params.gamma,
+             params.rotation, params.audio_offset,
+             params.trim_in, params.trim_out,
+             params.stream_copy, params.remux, params.faststart,
+             params.smart_render, params.smart_copy_from, params.smart_copy_to,
+             params.screen_recording,
+             params.concat_count, params.concat_demuxer);
+    result_cache_hash_cstr(h, text);
+}
+
+
+bool result_cache_key(FfmpegParams params, Result_Cache_Key *key) {
+    pthread_once(&result_cache_version_once, result_cache_read_version);
+    Result_Cache_Hasher h = {.hi = 0x6c62272e07bb0142ull, .lo = CACHE_HASH_INIT};
+    result_cache_hash_cstr(&h, result_cache_version);
+    result_cache_hash_params(&h, params);
+    if (params.concat_count > 0) {
+        for (size_t i = 0; i < params.concat_count; ++i) {
+            if (!result_cache_hash_file(&h, params.concat_paths[i])) return false;
+        }
+    } else if (!result_cache_hash_file(&h, params.input_path)) {
+        return false;
+    }
+    key->hi = h.hi;
+    key->lo = h.lo;
+    return true;
+}
+
+
+static bool result_cache_entry_path(char *path, size_t size, const Result_Cache_Entry *entry) {
+    char name[128];
+    snprintf(name, sizeof(name), RESULT_CACHE_DIR "/%016" PRIx64 "%016" PRIx64 "%s", entry->key.hi, entry->key.lo, entry->ext);
+    return cache_path(path, size, name);
+}
+
+
+// One entry per line: `<key> <size> <last used> <ext>`.
+static void result_cache_load(Result_Cache *cache) {
+    if (cache->loaded) return;
+    cache->loaded = true;
+    char path[1024];
+    if (!cache_path(path, sizeof(path), RESULT_CACHE_INDEX)) return;
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return; // nothing cached yet
+
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        Result_Cache_Entry entry = {0};
+        long long last_used;
+        if (sscanf(line, "%16" SCNx64 "%16" SCNx64 " %" SCNu64 " %lld %15s",
+                   &entry.key.hi, &entry.key.lo, &entry.size, &last_used, entry.ext) != 5) continue;
+        entry.last_used = last_used;
+        nob_da_append(cache, entry);
+    }
+    fclose(f);
+}
+
+
+static bool result_cache_save(const Result_Cache *cache) {
+    char path[1024];
+    if (!cache_path(path, sizeof(path), RESULT_CACHE_INDEX)) return false;
+    Nob_String_Builder sb = {0};
+    for (size_t i = 0; i < cache->count; ++i) {
+        const Result_Cache_Entry *e = &cache->items[i];
+        nob_sb_appendf(&sb, "%016" PRIx64 "%016" PRIx64 " %" PRIu64 " %lld %s\n", e->key.hi, e->key.lo, e->size, (long long) e->last_used, e->ext);
+    }
+    bool result = cache_write_atomic(path, sb.items, sb.count);
+    nob_sb_free(sb);
+    return result;
+}
+
+
+// A reflink where the filesystem supports it, a hard link otherwise. `dst` must not exist.
+static bool result_cache_link(const char *src, const char *dst) {
+    int in = open(src, O_RDONLY);
+    if (in < 0) return false;
+    int out = open(dst, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (out >= 0) {
+        bool cloned = ioctl(out, FICLONE, in) == 0;
+        close(out);
+        close(in);
+        if (cloned) return true;
+        unlink(dst);
+    } else {
+        close(in);
+    }
+    return link(src, dst) == 0;
+}
+
+
+static Result_Cache_Entry *result_cache_find(Result_Cache *cache, Result_Cache_Key key) {
+    for (size_t i = 0; i < cache->count; ++i) {
+        if (cache->items[i].key.hi == key.hi && cache->items[i].key.lo == key.lo) return &cache->items[i];
+    }
+    return NULL;
+}
+
+
+static void result_cache_remove(Result_Cache *cache, size_t index) {
+    char path[1024];
+    if (result_cache_entry_path(path, sizeof(path), &cache->items[index]) && unlink(path) < 0 && errno != ENOENT) {
+        nob_log(NOB_WARNING, "could not remove %s: %s", path, strerror(errno));
+    }
+    cache->items[index] = cache->items[--cache->count];
+}
+
+
+bool result_cache_fetch(Result_Cache *cache, Result_Cache_Key key, const char *path) {
+    result_cache_load(cache);
+    Result_Cache_Entry *entry = result_cache_find(cache, key);
+    if (entry == NULL) return false;
+    char entry_path[1024];
+    if (!result_cache_entry_path(entry_path, sizeof(entry_path), entry)) return false;
+    if (unlink(path) < 0 && errno != ENOENT) return false;
+    if (!result_cache_link(entry_path, path)) {
+        // Cleaned up behind our back, or on another filesystem than the output.
+        if (access(entry_path, F_OK) < 0) {
+            result_cache_remove(cache, entry - cache->items);
+            result_cache_save(cache);
+        }
+        return false;
+    }
+    entry->last_used = time(NULL);
+    result_cache_save(cache);
+    return true;
+}
+
+
+static void result_cache_evict(Result_Cache *cache) {
+    double total = 0;
+    for (size_t i = 0; i < cache->count; ++i) total += cache->items[i].size;
+    while (total > RESULT_CACHE_MAX_SIZE && cache->count > 0) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < cache->count; ++i) {
+            if (cache->items[i].last_used < cache->items[oldest].last_used) oldest = i;
+        }
+        total -= cache->items[oldest].size;
+        result_cache_remove(cache, oldest);
+    }
+}
+
+
+void result_cache_store(Result_Cache *cache, Result_Cache_Key key, const char *path) {
+    result_cache_load(cache);
+    struct stat st;
+    if (stat(path, &st) < 0) return;
+    // Something that big would push everything else out.
+    if (st.st_size > RESULT_CACHE_MAX_SIZE / 2) return;
+
+    Result_Cache_Entry entry = {
+        .key = key,
+        .size = st.st_size,
+        .last_used = time(NULL),
+    };
+    const char *ext = strrchr(path, '.');
+    if (ext != NULL && strchr(ext, '/') == NULL) snprintf(entry.ext, sizeof(entry.ext), "%s", ext);
+
+    char dir[1024], entry_path[1024];
+    if (!cache_path(dir, sizeof(dir), RESULT_CACHE_DIR)) return;
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        nob_log(NOB_ERROR, "could not create directory %s: %s", dir, strerror(errno));
+        return;
+    }
+    Result_Cache_Entry *existing = result_cache_find(cache, key);
+    if (existing != NULL) result_cache_remove(cache, existing - cache->items);
+    if (!result_cache_entry_path(entry_path, sizeof(entry_path), &entry)) return;
+    unlink(entry_path);
+    if (!result_cache_link(path, entry_path)) {
+        nob_log(NOB_WARNING, "could not link %s into the result cache: %s", path, strerror(errno));
+        result_cache_save(cache);
+        return;
+    }
+    nob_da_append(cache, entry);
+    result_cache_evict(cache);
+    result_cache_save(cache);
+}
+
+
+void result_cache_free(Result_Cache *cache) {
+    nob_da_free(*cache);
+    memset(cache, 0, sizeof(*cache));
+}
@@ -0,0 +1,60 @@
+#ifndef RESULT_CACHE_H_
+#define RESULT_CACHE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "./ffmpeg.h"
+
+// Outputs of finished jobs, kept in the cache directory by what went into them, so re-running the
+// same input with the same settings links the earlier output instead of encoding again.
+//
+// The key hashes the ffmpeg version, the settings that change the output (see
+// result_cache_key()) and a sample of each input: its size and RESULT_CACHE_SAMPLES blocks
+// spread over the file, which catches re-ingests without reading them whole.
+//
+// Entries are reflinks of the outputs where the filesystem can do that and hard links otherwise,
+// and the other way round when a result is reused, so neither costs a copy. A hard-linked output
+// that is later modified in place changes the cached result with it, which is why reflinks go first.
+// The index remembers when each entry was last used, the least recently used ones are removed
+// when the entries go over RESULT_CACHE_MAX_SIZE.
+
+#define RESULT_CACHE_SAMPLES 16
+#define RESULT_CACHE_SAMPLE_SIZE (64*1024)
+#define RESULT_CACHE_MAX_SIZE (20.0*1024*1024*1024) // bytes
+
+typedef struct {
+    uint64_t hi;
+    uint64_t lo;
+} Result_Cache_Key;
+
+typedef struct {
+    Result_Cache_Key key;
+    char ext[16]; // of the output, the entry is named after the key with it
+    uint64_t size; // bytes
+    time_t last_used;
+} Result_Cache_Entry;
+
+typedef struct {
+    Result_Cache_Entry *items;
+    size_t count;
+    size_t capacity;
+    bool loaded;
+} Result_Cache;
+
+// Reads the samples of the inputs of `params` and asks ffmpeg for its version the first time.
+// Doesn't use the temporary allocator, so it's safe to call from any thread. False when an input
+// can't be read.
+bool result_cache_key(FfmpegParams params, Result_Cache_Key *key);
+
+// Links the result for `key` to `path`, replacing what is there. False on a miss.
+bool result_cache_fetch(Result_Cache *cache, Result_Cache_Key key, const char *path);
+
+// Links the finished output at `path` into the cache, evicting the least recently used entries
+// to stay within RESULT_CACHE_MAX_SIZE.
+void result_cache_store(Result_Cache *cache, Result_Cache_Key key, const char *path);
+
+void result_cache_free(Result_Cache *cache);
+
+#endif // RESULT_CACHE_H_
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./cache.h"
+#include "./scheduler.h"
+#include "./thirdparty/nob.h"
+
+#define THROUGHPUT_HISTORY_FILE "throughput.txt"
+// libx264 medium does roughly 1080p30 in realtime on 4 threads.
+#define THROUGHPUT_DEFAULT (1920.0*1080.0*30.0/4.0)
+// Weight of a new measurement, the history follows ffmpeg/hardware upgrades within a few runs.
+#define THROUGHPUT_ALPHA 0.3
+
+size_t thread_budget_total(const Thread_Budget *tb) {
+    if (tb->budget > 0) return tb->budget;
+    int nprocs = nob_nprocs();
+    return nprocs > 0 ? (size_t) nprocs : 1;
+}
+
+
+size_t thread_budget_default_concurrency(const Thread_Budget *tb) {
+    return (thread_budget_total(tb) + 3) / 4;
+}
+
+
+size_t thread_budget_acquire(Thread_Budget *tb, size_t starting) {
+    if (tb->unlimited) return 0;
+    if (starting == 0) starting = 1;
+
+    size_t total = thread_budget_total(tb);
+    size_t free = tb->committed < total ? total - tb->committed : 0;
+    size_t share = free / starting;
+    if (share == 0) share = 1;
+
+    tb->committed += share;
+    return share;
+}
+
+
+void thread_budget_release(Thread_Budget *tb, size_t threads) {
+    tb->committed = tb->committed > threads ? tb->committed - threads : 0;
+}
+
+
+void thread_budget_take(Thread_Budget *tb, size_t threads) {
+    tb->committed += threads;
+}
+
+
+// One profile per line: `<throughput> <samples> <profile>`.
+bool throughput_history_load(Throughput_History *history) {
+    char path[1024];
+    if (!cache_path(path, sizeof(path), THROUGHPUT_HISTORY_FILE)) return false;
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return true; // nothing measured yet
+
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        Throughput t = {0};
+        int profile_start = 0;
+        if (sscanf(line, "%lf %zu %n", &t.throughput, &t.samples, &profile_start) < 2 || profile_start == 0) continue;
+        snprintf(t.profile, sizeof(t.profile), "%s", line + profile_start);
+        t.profile[strcspn(t.profile, "\n")] = '\0';
+        if (t.throughput <= 0 || t.profile[0] == '\0') continue;
+        nob_da_append(history, t);
+    }
+    fclose(f);
+    return true;
+}
+
+
+bool throughput_history_save(const Throughput_History *history) {
+    char path[1024], tmp_path[1100];
+    if (!cache_path(path, sizeof(path), THROUGHPUT_HISTORY_FILE)) return false;
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE *f = fopen(tmp_path, "w");
+    if (f == NULL) {
+        nob_log(NOB_ERROR, "could not write %s: %s", tmp_path, strerror(errno));
+        return false;
+    }
+    for (size_t i = 0; i < history->count; ++i) {
+        fprintf(f, "%f %zu %s\n", history->items[i].throughput, history->items[i].samples, history->items[i].profile);
+    }
+    fclose(f);
+    if (rename(tmp_path, path) < 0) {
+        nob_log(NOB_ERROR, "could not rename %s to %s: %s", tmp_path, path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+
+double throughput_history_get(const Throughput_History *history, const char *profile) {
+    for (size_t i = 0; i < history->count; ++i) {
+        if (strcmp(history->items[i].profile, profile) == 0) return history->items[i].throughput;
+    }
+    return THROUGHPUT_DEFAULT;
+}
+
+
+void throughput_history_record(Throughput_History *history, const char *profile, double throughput) {
+    if (throughput <= 0) return;
+    for (size_t i = 0; i < history->count; ++i) {
+        Throughput *t = &history->items[i];
+        if (strcmp(t->profile, profile) != 0) continue;
+        t->throughput = THROUGHPUT_ALPHA*throughput + (1 - THROUGHPUT_ALPHA)*t->throughput;
+        t->samples += 1;
+        return;
+    }
+    Throughput t = {.throughput = throughput, .samples = 1};
+    snprintf(t.profile, sizeof(t.profile), "%s", profile);
+    nob_da_append(history, t);
+}
+
+
+static int compare_costs_desc(const void *a, const void *b) {
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x < y) - (x > y);
+}
+
+
+double makespan_lpt(double *costs, size_t count, double *loads, size_t machines) {
+    if (machines == 0) return 0;
+    qsort(costs, count, sizeof(*costs), compare_costs_desc);
+    for (size_t i = 0; i < count; ++i) {
+        size_t least = 0;
+        for (size_t m = 1; m < machines; ++m) {
+            if (loads[m] < loads[least]) least = m;
+        }
+        loads[least] += costs[i];
+    }
+    double makespan = 0;
+    for (size_t m = 0; m < machines; ++m) {
+        if (loads[m] > makespan) makespan = loads[m];
+    }
+    return makespan;
+}
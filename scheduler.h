@@ -0,0 +1,60 @@
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Splits the cores between the encodes that run at the same time. Left alone every ffmpeg
+// sizes its own thread pools for the whole machine (libx264 alone takes ~1.5x cores), so a few
+// parallel jobs oversubscribe the CPU and thrash.
+//
+// The thread count of a running ffmpeg can't be changed, so the budget is rebalanced only when
+// jobs start: a job gets an equal share of whatever the running jobs don't hold yet. As jobs
+// finish their threads go back to the pool and the next jobs get a bigger share.
+typedef struct {
+    size_t budget; // threads for all the jobs together, 0 means nob_nprocs()
+    size_t committed; // threads held by the running jobs
+    bool unlimited; // hand out 0 (ffmpeg's own default) to every job, the pre-budget behaviour
+} Thread_Budget;
+
+size_t thread_budget_total(const Thread_Budget *tb);
+
+// How many jobs to run at once when nobody configured it: about 4 threads per job.
+size_t thread_budget_default_concurrency(const Thread_Budget *tb);
+
+// Reserves the share of a job that is starting together with `starting - 1` other jobs
+// which haven't got their share yet. Returns 0 when the budget is unlimited.
+size_t thread_budget_acquire(Thread_Budget *tb, size_t starting);
+
+void thread_budget_release(Thread_Budget *tb, size_t threads);
+
+// Takes `threads` back for a job that is resumed with the thread count it was started with.
+void thread_budget_take(Thread_Budget *tb, size_t threads);
+
+// Measured encode speed per parameter profile (see ffmpeg_params_profile()), kept in
+// the cache directory between sessions. The speed is in output pixels per second per thread
+// so it carries over between resolutions, durations and thread shares.
+typedef struct {
+    char profile[64];
+    double throughput;
+    size_t samples;
+} Throughput;
+
+typedef struct {
+    Throughput *items;
+    size_t count;
+    size_t capacity;
+} Throughput_History;
+
+bool throughput_history_load(Throughput_History *history);
+bool throughput_history_save(const Throughput_History *history);
+
+// Returns a conservative guess when the profile was never measured.
+double throughput_history_get(const Throughput_History *history, const char *profile);
+void throughput_history_record(Throughput_History *history, const char *profile, double throughput);
+
+// Longest-processing-time-first list scheduling of `costs` (seconds) onto `machines` slots whose
+// current loads are in `loads` (updated in place). Returns the predicted makespan. Sorts `costs`.
+double makespan_lpt(double *costs, size_t count, double *loads, size_t machines);
+
+#endif // SCHEDULER_H_
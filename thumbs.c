@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./freedesktop.h"
+#include "./launcher.h"
+#include "./pool.h"
+#include "./probe.h"
+#include "./thumbs.h"
+
+typedef struct {
+    Thumbs *thumbs;
+    size_t id;
+    char *path;
+    int width;
+    int height;
+    unsigned char *pixels; // RGBA, NULL when the decode failed
+} Thumb_Task;
+
+
+// The longest side becomes THUMBS_SIZE, both sides even for the chroma subsampling.
+static void thumbs_fit_size(int width, int height, int *w, int *h) {
+    if (width >= height) {
+        *w = THUMBS_SIZE;
+        *h = (int)((double) THUMBS_SIZE * height / width + 0.5);
+    } else {
+        *h = THUMBS_SIZE;
+        *w = (int)((double) THUMBS_SIZE * width / height + 0.5);
+    }
+    *w = *w / 2 * 2 > 0 ? *w / 2 * 2 : 2;
+    *h = *h / 2 * 2 > 0 ? *h / 2 * 2 : 2;
+}
+
+
+// Runs on the pool. The file managers' thumbnail cache first, otherwise
+//   ffmpeg -skip_frame nokey -ss 12.3 -i in.mp4 -frames:v 1 -vf scale=128:72 -pix_fmt rgba -f rawvideo pipe:1
+// and the result goes back into that cache.
+static void thumbs_decode_work(void *arg) {
+    Thumb_Task *task = arg;
+    Image cached;
+    if (freedesktop_thumbnail_load(task->path, &cached)) {
+        if (cached.width > THUMBS_SIZE || cached.height > THUMBS_SIZE) {
+            int width, height;
+            thumbs_fit_size(cached.width, cached.height, &width, &height);
+            ImageResize(&cached, width, height);
+        }
+        task->pixels = cached.data;
+        task->width = cached.width;
+        task->height = cached.height;
+        return;
+    }
+
+    Probe probe;
+    if (!probe_file(task->path, &probe) || probe.width <= 0 || probe.height <= 0) return;
+
+    int width, height;
+    // ffmpeg decodes the frames turned the way players show them.
+    if (probe.rotation % 180 == 90) {
+        thumbs_fit_size(probe.height, probe.width, &width, &height);
+    } else {
+        thumbs_fit_size(probe.width, probe.height, &width, &height);
+    }
+    char seek[32], scale[64];
+    snprintf(seek, sizeof(seek), "%.3f", probe.duration*0.1);
+    snprintf(scale, sizeof(scale), "scale=%d:%d", width, height);
+
+    Nob_Cmd cmd = {0};
+    Nob_String_Builder out = {0};
+    nob_cmd_append(&cmd, "ffmpeg", "-v", "error", "-nostdin");
+    nob_cmd_append(&cmd, "-skip_frame", "nokey", "-ss", seek, "-i", task->path);
+    nob_cmd_append(&cmd, "-frames:v", "1", "-an", "-vf", scale, "-pix_fmt", "rgba", "-f", "rawvideo", "pipe:1");
+    if (launcher_run_sync(cmd, &out) && out.count == (size_t) width*height*4) {
+        task->pixels = (unsigned char*) out.items;
+        task->width = width;
+        task->height = height;
+        freedesktop_thumbnail_save(task->path, (Image){task->pixels, width, height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8});
+    } else {
+        nob_sb_free(out);
+    }
+    nob_cmd_free(cmd);
+}
+
+
+static size_t thumbs_atlas_new(Thumbs *thumbs) {
+    Thumb_Atlas *atlas = &thumbs->atlases[thumbs->atlas_count];
+    Image image = GenImageColor(THUMBS_ATLAS_SIZE, THUMBS_ATLAS_SIZE, BLANK);
+    atlas->texture = LoadTextureFromImage(image);
+    UnloadImage(image);
+    SetTextureFilter(atlas->texture, TEXTURE_FILTER_BILINEAR);
+    stbrp_init_target(&atlas->packer, THUMBS_ATLAS_SIZE, THUMBS_ATLAS_SIZE, atlas->nodes, THUMBS_ATLAS_SIZE);
+    atlas->drawn_at = thumbs->frame;
+    return thumbs->atlas_count++;
+}
+
+
+// Empties the atlas drawn the longest time ago. Its thumbnails go back to missing.
+static size_t thumbs_atlas_evict(Thumbs *thumbs) {
+    size_t oldest = 0;
+    for (size_t i = 1; i < thumbs->atlas_count; ++i) {
+        if (thumbs->atlases[i].drawn_at < thumbs->atlases[oldest].drawn_at) oldest = i;
+    }
+    for (size_t i = 0; i < thumbs->count; ++i) {
+        Thumb *thumb = &thumbs->items[i];
+        if (thumb->state == THUMB_READY && thumb->atlas == oldest) thumb->state = THUMB_MISSING;
+    }
+    Thumb_Atlas *atlas = &thumbs->atlases[oldest];
+    stbrp_init_target(&atlas->packer, THUMBS_ATLAS_SIZE, THUMBS_ATLAS_SIZE, atlas->nodes, THUMBS_ATLAS_SIZE);
+    atlas->drawn_at = thumbs->frame;
+    return oldest;
+}
+
+
+static bool thumbs_pack(Thumbs *thumbs, Thumb *thumb, int width, int height, const void *pixels) {
+    // One pixel of gap, so the bilinear filter doesn't bleed the neighbours in.
+    stbrp_rect rect = {.w = width + 1, .h = height + 1};
+    size_t atlas = 0;
+    while (atlas < thumbs->atlas_count && !stbrp_pack_rects(&thumbs->atlases[atlas].packer, &rect, 1)) atlas += 1;
+    if (atlas == thumbs->atlas_count) {
+        atlas = thumbs->atlas_count < THUMBS_MAX_ATLASES ? thumbs_atlas_new(thumbs) : thumbs_atlas_evict(thumbs);
+        if (!stbrp_pack_rects(&thumbs->atlases[atlas].packer, &rect, 1)) return false;
+    }
+
+    thumb->atlas = atlas;
+    thumb->source = (Rectangle){rect.x, rect.y, width, height};
+    UpdateTextureRec(thumbs->atlases[atlas].texture, thumb->source, pixels);
+    thumb->state = THUMB_READY;
+    return true;
+}
+
+
+static void thumbs_decode_done(void *arg) {
+    Thumb_Task *task = arg;
+    Thumbs *thumbs = task->thumbs;
+    thumbs->loading -= 1;
+    Thumb *thumb = &thumbs->items[task->id];
+    if (task->pixels == NULL || !thumbs_pack(thumbs, thumb, task->width, task->height, task->pixels)) {
+        thumb->state = THUMB_FAILED;
+    }
+    free(task->pixels);
+    free(task->path);
+    free(task);
+}
+
+
+static void thumbs_request(Thumbs *thumbs, const Thumb_Cell *cell) {
+    if (cell->id >= thumbs->count) {
+        nob_da_reserve(thumbs, cell->id + 1);
+        memset(thumbs->items + thumbs->count, 0, (cell->id + 1 - thumbs->count)*sizeof(*thumbs->items));
+        thumbs->count = cell->id + 1;
+    }
+    Thumb *thumb = &thumbs->items[cell->id];
+    if (thumb->state != THUMB_MISSING || thumbs->loading >= THUMBS_MAX_LOADING) return;
+
+    Thumb_Task *task = calloc(1, sizeof(*task));
+    task->thumbs = thumbs;
+    task->id = cell->id;
+    task->path = strdup(cell->path);
+    thumb->state = THUMB_LOADING;
+    thumbs->loading += 1;
+    pool_submit(thumbs_decode_work, thumbs_decode_done, task);
+}
+
+
+// Largest rectangle with the aspect ratio of `source` centered in `dest`.
+static Rectangle thumbs_fit_rect(Rectangle source, Rectangle dest) {
+    float scale = dest.width / source.width;
+    if (source.height*scale > dest.height) scale = dest.height / source.height;
+    float width = source.width*scale, height = source.height*scale;
+    return (Rectangle){
+        dest.x + (dest.width - width)/2,
+        dest.y + (dest.height - height)/2,
+        width,
+        height,
+    };
+}
+
+
+void thumbs_draw(Thumbs *thumbs, const Thumb_Cell *cells, size_t count) {
+    thumbs->frame += 1;
+    for (size_t i = 0; i < count; ++i) thumbs_request(thumbs, &cells[i]);
+
+    // Going atlas by atlas keeps the quads of one texture together, rlgl batches them into one draw call.
+    for (size_t atlas = 0; atlas < thumbs->atlas_count; ++atlas) {
+        for (size_t i = 0; i < count; ++i) {
+            const Thumb *thumb = &thumbs->items[cells[i].id];
+            if (thumb->state != THUMB_READY || thumb->atlas != atlas) continue;
+            DrawTexturePro(thumbs->atlases[atlas].texture, thumb->source, thumbs_fit_rect(thumb->source, cells[i].dest), (Vector2){0}, 0, WHITE);
+            thumbs->atlases[atlas].drawn_at = thumbs->frame;
+        }
+    }
+}
+
+
+void thumbs_free(Thumbs *thumbs) {
+    for (size_t i = 0; i < thumbs->atlas_count; ++i) UnloadTexture(thumbs->atlases[i].texture);
+    nob_da_free(*thumbs);
+    memset(thumbs, 0, sizeof(*thumbs));
+}
@@ -0,0 +1,70 @@
+#ifndef THUMBS_H_
+#define THUMBS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./thirdparty/raylib/src/raylib.h"
+#include "./thirdparty/raylib/src/external/stb_rect_pack.h"
+
+// Thumbnails of the queued files for the grid view.
+//
+// Only the cells on screen ask for their thumbnail. It comes from the freedesktop thumbnail cache
+// the file managers share when they already made one. Otherwise it's decoded on the pool from the
+// first keyframe after 10% of the input (the decoder skips everything else) and written back to
+// that cache. Either way it's packed into one of a few big atlas textures with stb_rect_pack, so
+// the grid is drawn with about one draw call per atlas. When all the atlases are full, the one
+// drawn the longest time ago is emptied and its thumbnails are loaded again when they come back
+// into view.
+
+#define THUMBS_SIZE 128 // longest side in pixels, the freedesktop "normal" size
+#define THUMBS_ATLAS_SIZE 2048
+#define THUMBS_MAX_ATLASES 4
+#define THUMBS_MAX_LOADING 8 // decodes in flight, so scrolling fast doesn't queue up the whole batch
+
+typedef enum {
+    THUMB_MISSING,
+    THUMB_LOADING,
+    THUMB_READY,
+    THUMB_FAILED,
+} Thumb_State;
+
+typedef struct {
+    Thumb_State state;
+    size_t atlas;
+    Rectangle source; // in the atlas
+} Thumb;
+
+typedef struct {
+    Texture2D texture;
+    stbrp_context packer;
+    stbrp_node nodes[THUMBS_ATLAS_SIZE];
+    uint64_t drawn_at; // frame
+} Thumb_Atlas;
+
+typedef struct {
+    size_t id; // stable for the file, e.g. the job id
+    const char *path;
+    Rectangle dest;
+} Thumb_Cell;
+
+typedef struct {
+    Thumb *items; // indexed by id
+    size_t count;
+    size_t capacity;
+    Thumb_Atlas atlases[THUMBS_MAX_ATLASES];
+    size_t atlas_count;
+    size_t loading;
+    uint64_t frame;
+} Thumbs;
+
+// Draws the thumbnails of the cells that have one, fitted into `dest`, and requests the missing
+// ones. Call between BeginDrawing() and EndDrawing(). `thumbs` must stay where it is until
+// the pool is shut down.
+void thumbs_draw(Thumbs *thumbs, const Thumb_Cell *cells, size_t count);
+
+// Unloads the atlases. Call after pool_shutdown() and before CloseWindow().
+void thumbs_free(Thumbs *thumbs);
+
+#endif // THUMBS_H_
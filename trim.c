@@ -0,0 +1,342 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "./formats.h"
+#include "./trim.h"
+
+// Timestamps are in microseconds in the index, the slider positions aren't.
+#define TRIM_KEYFRAME_TOLERANCE 0.001
+// The re-encoded boundaries are a GOP each, spend the bits so they don't stand out next to the copy.
+#define TRIM_SMART_CRF 18
+
+static const char *trim_smart_pieces[] = {
+    [TRIM_STEP_HEAD] = "head.ts",
+    [TRIM_STEP_MIDDLE] = "middle.ts",
+    [TRIM_STEP_TAIL] = "tail.ts",
+    [TRIM_STEP_CONCAT] = "concat.txt",
+};
+
+const char *trim_mode_name(Trim_Mode mode) {
+    switch (mode) {
+    case TRIM_NONE:   return "none";
+    case TRIM_COPY:   return "copy";
+    case TRIM_SMART:  return "smart";
+    case TRIM_ENCODE: return "encode";
+    }
+    NOB_UNREACHABLE("trim_mode_name");
+}
+
+
+static bool trim_on_keyframe(const Keyframe_Index *keyframes, double seconds) {
+    const Keyframe *kf = keyframe_index_at_or_before(keyframes, seconds + TRIM_KEYFRAME_TOLERANCE);
+    return kf != NULL && fabs(kf->pts / 1e6 - seconds) <= TRIM_KEYFRAME_TOLERANCE;
+}
+
+
+// The encoder that produces a stream the copied middle can continue, NULL when we have none.
+static const char *trim_smart_encoder(const Probe *probe) {
+    if (strcmp(probe->video_codec, "h264") == 0) return "libx264";
+    if (strcmp(probe->video_codec, "hevc") == 0) return "libx265";
+    return NULL;
+}
+
+
+static void trim_plan_smart(const Keyframe_Index *keyframes, const Probe *probe, bool in_aligned, bool out_aligned, Trim_Plan *plan) {
+    if (trim_smart_encoder(probe) == NULL || probe->pix_fmt[0] == '\0') return;
+
+    if (in_aligned) {
+        plan->copy_from = plan->in;
+    } else {
+        const Keyframe *kf = keyframe_index_at_or_after(keyframes, plan->in);
+        if (kf == NULL) return;
+        plan->copy_from = kf->pts / 1e6;
+    }
+    if (plan->out == 0 || out_aligned) {
+        plan->copy_to = plan->out;
+    } else {
+        const Keyframe *kf = keyframe_index_at_or_before(keyframes, plan->out);
+        if (kf == NULL) return;
+        plan->copy_to = kf->pts / 1e6;
+    }
+    // Both points in the same GOP, nothing to copy.
+    if (plan->copy_to > 0 && plan->copy_to <= plan->copy_from) return;
+    plan->mode = TRIM_SMART;
+}
+
+
+bool trim_plan(FfmpegParams params, const Keyframe_Index *keyframes, const Probe *probe, bool snap, Trim_Plan *plan) {
+    *plan = (Trim_Plan) {
+        .mode = TRIM_NONE,
+        .in = params.trim_in > 0 ? params.trim_in : 0,
+        .out = params.trim_out > 0 ? params.trim_out : 0,
+    };
+    if (plan->out > 0 && plan->out <= plan->in) return false;
+    if (plan->in == 0 && plan->out == 0) return true;
+
+    plan->mode = TRIM_ENCODE;
+    if (ffmpeg_params_filtered(params) || keyframes->count == 0) return true;
+
+    bool in_aligned = plan->in == 0 || trim_on_keyframe(keyframes, plan->in);
+    bool out_aligned = plan->out == 0 || trim_on_keyframe(keyframes, plan->out);
+    if (in_aligned && out_aligned) {
+        plan->mode = TRIM_COPY;
+        return true;
+    }
+    if (!snap) {
+        // The pieces of a smart render are cut without the rotation and the audio offset.
+        if (!ffmpeg_params_metadata_edited(params)) trim_plan_smart(keyframes, probe, in_aligned, out_aligned, plan);
+        return true;
+    }
+
+    // Snap outwards, so nothing the user wanted is lost.
+    if (!in_aligned) {
+        const Keyframe *kf = keyframe_index_at_or_before(keyframes, plan->in);
+        plan->in = kf != NULL ? kf->pts / 1e6 : 0;
+    }
+    if (!out_aligned) {
+        const Keyframe *kf = keyframe_index_at_or_after(keyframes, plan->out);
+        plan->out = kf != NULL ? kf->pts / 1e6 : 0;
+    }
+    if (plan->in < 0) plan->in = 0;
+    plan->mode = TRIM_COPY;
+    plan->snapped = true;
+    return true;
+}
+
+
+void trim_apply(const Trim_Plan *plan, FfmpegParams *params) {
+    params->trim_in = plan->in;
+    params->trim_out = plan->out;
+    params->stream_copy = plan->mode == TRIM_COPY;
+    params->smart_render = plan->mode == TRIM_SMART;
+    params->smart_copy_from = plan->mode == TRIM_SMART ? plan->copy_from : 0;
+    params->smart_copy_to = plan->mode == TRIM_SMART ? plan->copy_to : 0;
+}
+
+
+static bool trim_piece_path(char *path, size_t size, const char *output_path, Trim_Step step) {
+    int n = snprintf(path, size, "%s.%s", output_path, trim_smart_pieces[step]);
+    return n > 0 && (size_t) n < size;
+}
+
+
+// -profile:v of the encoder for the profile ffprobe reports, NULL for the ones it can't make.
+static const char *trim_smart_profile(const Probe *probe) {
+    static const char *profiles[][2] = {
+        {"Constrained Baseline", "baseline"},
+        {"Baseline", "baseline"},
+        {"Main", "main"},
+        {"High", "high"},
+        {"High 10", "high10"},
+        {"High 4:2:2", "high422"},
+        {"High 4:4:4 Predictive", "high444"},
+    };
+    static const char *hevc_profiles[][2] = {
+        {"Main", "main"},
+        {"Main 10", "main10"},
+        {"Main Still Picture", "mainstillpicture"},
+    };
+    bool hevc = strcmp(probe->video_codec, "hevc") == 0;
+    size_t count = hevc ? NOB_ARRAY_LEN(hevc_profiles) : NOB_ARRAY_LEN(profiles);
+    for (size_t i = 0; i < count; ++i) {
+        const char **p = hevc ? hevc_profiles[i] : profiles[i];
+        if (strcmp(probe->video_profile, p[0]) == 0) return p[1];
+    }
+    return NULL;
+}
+
+
+// The head and the tail continue the copied middle, so the decoder must not notice where one ends:
+// same profile, level, frame rate and colour description as the input, and a single GOP each.
+// The parameter sets still come from another encoder, they go in-band (see TRIM_STEP_CONCAT).
+static void trim_smart_encode_cmd(Nob_Cmd *cmd, FfmpegParams params, const Probe *probe, double from, double to, const char *piece) {
+    const char *encoder = trim_smart_encoder(probe);
+    bool x264 = strcmp(encoder, "libx264") == 0;
+    nob_cmd_append(cmd, "ffmpeg", "-y", "-nostats");
+    if (params.threads > 0) nob_cmd_append(cmd, "-threads", nob_temp_sprintf("%d", params.threads));
+    if (from > 0) nob_cmd_append(cmd, "-ss", nob_temp_sprintf("%.6f", from));
+    nob_cmd_append(cmd, "-i", params.input_path);
+    nob_cmd_append(cmd, "-t", nob_temp_sprintf("%.6f", to - from));
+    nob_cmd_append(cmd, "-map", "0:v:0", "-map", "0:a:0?");
+    nob_cmd_append(cmd, "-c:v", encoder, "-crf", nob_temp_sprintf("%d", TRIM_SMART_CRF));
+    nob_cmd_append(cmd, "-pix_fmt", nob_temp_strdup(probe->pix_fmt));
+    const char *profile = trim_smart_profile(probe);
+    if (profile != NULL) nob_cmd_append(cmd, "-profile:v", profile);
+    Nob_String_Builder x265 = {0};
+    if (probe->level > 0 && x264) nob_cmd_append(cmd, "-level", nob_temp_sprintf("%d.%d", probe->level/10, probe->level%10));
+    // HEVC levels are coded times 30, x265 takes the plain number.
+    if (probe->level > 0 && !x264) nob_sb_appendf(&x265, "level-idc=%.1f:", probe->level/30.0);
+    if (probe->frame_rate[0] != '\0' && strcmp(probe->frame_rate, "0/0") != 0) {
+        nob_cmd_append(cmd, "-r", nob_temp_strdup(probe->frame_rate));
+        // The keyframe the piece starts with is the only one.
+        char *end;
+        double fps = strtod(probe->frame_rate, &end);
+        if (*end == '/') fps /= strtod(end + 1, NULL);
+        if (fps > 0) nob_cmd_append(cmd, "-g", nob_temp_sprintf("%d", (int) ceil((to - from)*fps) + 1));
+    }
+    if (probe->color_primaries[0] != '\0') nob_cmd_append(cmd, "-color_primaries", nob_temp_strdup(probe->color_primaries));
+    if (probe->color_transfer[0] != '\0') nob_cmd_append(cmd, "-color_trc", nob_temp_strdup(probe->color_transfer));
+    if (probe->color_space[0] != '\0') nob_cmd_append(cmd, "-colorspace", nob_temp_strdup(probe->color_space));
+    if (probe->color_range[0] != '\0') nob_cmd_append(cmd, "-color_range", nob_temp_strdup(probe->color_range));
+    if (params.threads > 0) {
+        nob_cmd_append(cmd, "-threads", nob_temp_sprintf("%d", params.threads));
+        if (x264) nob_cmd_append(cmd, "-x264-params", nob_temp_sprintf("threads=%d", params.threads));
+    }
+    if (x265.count > 0) {
+        x265.count -= 1; // the last ':'
+        nob_sb_append_null(&x265);
+        nob_cmd_append(cmd, "-x265-params", nob_temp_strdup(x265.items));
+    }
+    nob_sb_free(x265);
+    nob_cmd_append(cmd, "-c:a", "copy", "-f", "mpegts");
+    nob_cmd_append(cmd, "-progress", "pipe:1", nob_temp_strdup(piece));
+}
+
+
+static bool trim_smart_has_head(FfmpegParams params) {
+    return params.smart_copy_from > params.trim_in + TRIM_KEYFRAME_TOLERANCE;
+}
+
+
+static bool trim_smart_has_tail(FfmpegParams params) {
+    return params.trim_out > 0 && params.trim_out > params.smart_copy_to + TRIM_KEYFRAME_TOLERANCE;
+}
+
+
+// The concat demuxer resolves the entries relative to the list, which sits next to the pieces.
+static bool trim_smart_write_list(FfmpegParams params, const char *list_path) {
+    FILE *f = fopen(list_path, "w");
+    if (f == NULL) {
+        nob_log(NOB_ERROR, "could not write %s: %s", list_path, strerror(errno));
+        return false;
+    }
+    for (Trim_Step step = TRIM_STEP_HEAD; step <= TRIM_STEP_TAIL; ++step) {
+        if (step == TRIM_STEP_HEAD && !trim_smart_has_head(params)) continue;
+        if (step == TRIM_STEP_TAIL && !trim_smart_has_tail(params)) continue;
+        char piece[4096];
+        if (!trim_piece_path(piece, sizeof(piece), params.output_path, step)) continue;
+        fprintf(f, "file '");
+        for (const char *c = nob_path_name(piece); *c != '\0'; ++c) {
+            if (*c == '\'') fprintf(f, "'\\''");
+            else fputc(*c, f);
+        }
+        fprintf(f, "'\n");
+    }
+    bool ok = !ferror(f);
+    if (fclose(f) != 0) ok = false;
+    if (!ok) nob_log(NOB_ERROR, "could not write %s", list_path);
+    return ok;
+}
+
+
+bool trim_smart_step_cmd(Nob_Cmd *cmd, FfmpegParams params, const Probe *probe, Trim_Step step) {
+    char piece[4096];
+    if (step < TRIM_STEP_CHECK && !trim_piece_path(piece, sizeof(piece), params.output_path, step)) {
+        nob_log(NOB_ERROR, "path too long: %s", params.output_path);
+        return false;
+    }
+
+    switch (step) {
+    case TRIM_STEP_HEAD:
+        if (!trim_smart_has_head(params)) return true;
+        trim_smart_encode_cmd(cmd, params, probe, params.trim_in, params.smart_copy_from, piece);
+        return true;
+
+    case TRIM_STEP_MIDDLE:
+        nob_cmd_append(cmd, "ffmpeg", "-y", "-nostats");
+        if (params.smart_copy_from > 0) nob_cmd_append(cmd, "-ss", nob_temp_sprintf("%.6f", params.smart_copy_from));
+        nob_cmd_append(cmd, "-i", params.input_path);
+        if (params.smart_copy_to > 0) nob_cmd_append(cmd, "-t", nob_temp_sprintf("%.6f", params.smart_copy_to - params.smart_copy_from));
+        nob_cmd_append(cmd, "-map", "0:v:0", "-map", "0:a:0?");
+        nob_cmd_append(cmd, "-c", "copy", "-avoid_negative_ts", "make_zero", "-f", "mpegts");
+        nob_cmd_append(cmd, "-progress", "pipe:1", nob_temp_strdup(piece));
+        return true;
+
+    case TRIM_STEP_TAIL:
+        if (!trim_smart_has_tail(params)) return true;
+        trim_smart_encode_cmd(cmd, params, probe, params.smart_copy_to, params.trim_out, piece);
+        return true;
+
+    case TRIM_STEP_CONCAT:
+        if (!trim_smart_write_list(params, piece)) return false;
+        nob_cmd_append(cmd, "ffmpeg", "-y", "-nostats");
+        nob_cmd_append(cmd, "-f", "concat", "-safe", "0", "-i", nob_temp_strdup(piece));
+        nob_cmd_append(cmd, "-map", "0", "-c", "copy");
+        // The samples switch parameter sets where the pieces meet. avc1/hvc1 promise that the one
+        // in the sample entry is all there is, avc3/hev1 tell players to take them from the stream.
+        const Format *format = format_find(params.output_path);
+        if (format != NULL && format->faststart) {
+            if (strcmp(probe->video_codec, "h264") == 0) nob_cmd_append(cmd, "-tag:v", "avc3");
+            if (strcmp(probe->video_codec, "hevc") == 0) nob_cmd_append(cmd, "-tag:v", "hev1");
+        }
+        ffmpeg_append_output_options(cmd, params);
+        nob_cmd_append(cmd, "-progress", "pipe:1", params.output_path);
+        return true;
+
+    case TRIM_STEP_CHECK:
+        // Fails on the first decode error, e.g. a reference frame the joined stream doesn't have.
+        nob_cmd_append(cmd, "ffmpeg", "-nostats", "-v", "error", "-xerror");
+        nob_cmd_append(cmd, "-i", params.output_path, "-map", "0", "-f", "null");
+        nob_cmd_append(cmd, "-progress", "pipe:1", "-");
+        return true;
+
+    case TRIM_STEP_COUNT:
+        break;
+    }
+    NOB_UNREACHABLE("trim_smart_step_cmd");
+}
+
+
+bool trim_smart_pieces_match(FfmpegParams params, char *reason, size_t size) {
+    Probe pieces[TRIM_STEP_CONCAT];
+    bool has[TRIM_STEP_CONCAT] = {
+        [TRIM_STEP_HEAD] = trim_smart_has_head(params),
+        [TRIM_STEP_MIDDLE] = true,
+        [TRIM_STEP_TAIL] = trim_smart_has_tail(params),
+    };
+    for (Trim_Step step = TRIM_STEP_HEAD; step < TRIM_STEP_CONCAT; ++step) {
+        char piece[4096];
+        if (!has[step]) continue;
+        if (!trim_piece_path(piece, sizeof(piece), params.output_path, step) || !probe_file_ffprobe(piece, &pieces[step])) {
+            snprintf(reason, size, "could not probe the %s", trim_smart_pieces[step]);
+            return false;
+        }
+    }
+
+    const Probe *middle = &pieces[TRIM_STEP_MIDDLE];
+    for (Trim_Step step = TRIM_STEP_HEAD; step <= TRIM_STEP_TAIL; step += 2) {
+        if (!has[step]) continue;
+        const Probe *p = &pieces[step];
+        const char *what = NULL;
+        if (strcmp(p->video_codec, middle->video_codec))              what = "codec";
+        else if (strcmp(p->video_profile, middle->video_profile))     what = "profile";
+        else if (p->level != middle->level)                           what = "level";
+        else if (p->width != middle->width || p->height != middle->height) what = "resolution";
+        else if (strcmp(p->pix_fmt, middle->pix_fmt))                 what = "pixel format";
+        else if (strcmp(p->frame_rate, middle->frame_rate))           what = "frame rate";
+        else if (strcmp(p->color_primaries, middle->color_primaries)) what = "color primaries";
+        else if (strcmp(p->color_transfer, middle->color_transfer))   what = "color transfer";
+        else if (strcmp(p->color_space, middle->color_space))         what = "color space";
+        else if (strcmp(p->color_range, middle->color_range))         what = "color range";
+        if (what != NULL) {
+            snprintf(reason, size, "the %s differs from the copied middle: %s", trim_smart_pieces[step], what);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void trim_smart_cleanup(const char *output_path) {
+    for (Trim_Step step = TRIM_STEP_HEAD; step < TRIM_STEP_CHECK; ++step) {
+        char piece[4096];
+        if (!trim_piece_path(piece, sizeof(piece), output_path, step)) continue;
+        if (unlink(piece) < 0 && errno != ENOENT) {
+            nob_log(NOB_WARNING, "could not remove %s: %s", piece, strerror(errno));
+        }
+    }
+}
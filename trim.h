@@ -0,0 +1,70 @@
+#ifndef TRIM_H_
+#define TRIM_H_
+
+#include <stdbool.h>
+
+#include "./ffmpeg.h"
+#include "./keyframes.h"
+#include "./probe.h"
+
+// Cutting [trim_in, trim_out) out of an input.
+//
+// A stream copy can only start on a keyframe, everything before the next keyframe would be
+// undecodable. So the cut is copied without a re-encode only when both points already sit on
+// keyframes (or the end of the input), or when the user is fine with moving them to the
+// surrounding keyframes.
+//
+// Otherwise the cut is smart-rendered: only the partial GOPs at the head and the tail are
+// re-encoded, with the codec and pixel format of the input, and the keyframe-aligned middle is
+// copied. The pieces are written as MPEG-TS, which repeats the codec parameters in-band, so they
+// can be joined by the concat demuxer without a re-encode. The result is decoded once to check it.
+// Inputs whose codec we can't re-encode to are re-encoded as a whole, which is frame accurate too.
+
+typedef enum {
+    TRIM_NONE, // the whole input with the usual encode
+    TRIM_COPY,
+    TRIM_SMART,
+    TRIM_ENCODE,
+} Trim_Mode;
+
+typedef struct {
+    Trim_Mode mode;
+    double in; // seconds, moved to a keyframe when snapped
+    double out; // seconds, 0 means the end of the input
+    bool snapped;
+    double copy_from; // TRIM_SMART only, see FfmpegParams
+    double copy_to;
+} Trim_Plan;
+
+typedef enum {
+    TRIM_STEP_HEAD,
+    TRIM_STEP_MIDDLE,
+    TRIM_STEP_TAIL,
+    TRIM_STEP_CONCAT,
+    TRIM_STEP_CHECK,
+    TRIM_STEP_COUNT,
+} Trim_Step;
+
+const char *trim_mode_name(Trim_Mode mode);
+
+// Decides how to produce the cut requested by `params.trim_in` and `params.trim_out`. The crop
+// and audio settings need a re-encode either way. Returns false when the points make no sense.
+bool trim_plan(FfmpegParams params, const Keyframe_Index *keyframes, const Probe *probe, bool snap, Trim_Plan *plan);
+
+// Puts the plan into `params`.
+void trim_apply(const Trim_Plan *plan, FfmpegParams *params);
+
+// Appends the ffmpeg invocation of `step` of a smart render into `params.output_path` to `cmd`.
+// Leaves `cmd` empty when the step isn't needed, e.g. there is no head when trim_in is on a keyframe.
+// Returns false when the step can't be prepared.
+bool trim_smart_step_cmd(Nob_Cmd *cmd, FfmpegParams params, const Probe *probe, Trim_Step step);
+
+// Probes the pieces of a smart render into `params.output_path` and compares the stream parameters
+// of the re-encoded ones to the copied middle. A decoder takes a stream that switches them, but
+// strict players and hardware decoders don't. Runs ffprobe, so not for the UI thread.
+bool trim_smart_pieces_match(FfmpegParams params, char *reason, size_t size);
+
+// Removes the pieces a smart render into `output_path` leaves behind.
+void trim_smart_cleanup(const char *output_path);
+
+#endif // TRIM_H_